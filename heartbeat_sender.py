@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""
+ATX Watchdog Heartbeat Sender
+Envia latidos UDP firmados al watchdog (modo push, sonda "heartbeat")
+Sin dependencias externas. Pensado para correr como servicio en el host
+monitoreado (systemd, tarea programada, etc.)
+"""
+
+import argparse
+import hashlib
+import hmac
+import socket
+import sys
+import time
+
+def build_heartbeat(name, seq, key):
+    """hb1 <sender> <seq> <ts> <hmac-sha256 hex de todo lo anterior>"""
+    message = f"hb1 {name} {seq} {int(time.time())}"
+    mac = hmac.new(key.encode(), message.encode(), hashlib.sha256).hexdigest()
+    return f"{message} {mac}".encode()
+
+def main():
+    parser = argparse.ArgumentParser(description='Envia latidos UDP al ATX Watchdog')
+    parser.add_argument('host', help='IP o hostname del watchdog')
+    parser.add_argument('-p', '--port', type=int, default=4210, help='Puerto UDP de latidos (default: 4210)')
+    parser.add_argument('-k', '--key', required=True, help='Clave HMAC (la misma que en la config del watchdog)')
+    parser.add_argument('-n', '--name', default=socket.gethostname(),
+                        help='Nombre del emisor = Host del objetivo en el watchdog (default: hostname)')
+    parser.add_argument('-i', '--interval', type=float, default=1.0, help='Segundos entre latidos (default: 1)')
+    parser.add_argument('-c', '--count', type=int, default=0, help='Cantidad de latidos (default: 0 = infinito)')
+    args = parser.parse_args()
+
+    if ' ' in args.name or '"' in args.name or '\\' in args.name:
+        print("El nombre no puede tener espacios, comillas ni barras invertidas")
+        sys.exit(2)
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    # seq tiene que crecer siempre, incluso si el script se reinicia: se
+    # arranca desde el reloj en ms
+    seq = int(time.time() * 1000)
+    sent = 0
+
+    print(f"Enviando latidos de '{args.name}' a {args.host}:{args.port} cada {args.interval} s")
+    try:
+        while args.count == 0 or sent < args.count:
+            seq += 1
+            try:
+                sock.sendto(build_heartbeat(args.name, seq, args.key), (args.host, args.port))
+                sent += 1
+            except OSError as e:
+                # Red caida: se sigue intentando, el watchdog vera el hueco
+                print(f"Error enviando latido: {e}")
+            time.sleep(args.interval)
+    except KeyboardInterrupt:
+        print(f"\nSaliendo ({sent} latidos enviados)")
+
+if __name__ == '__main__':
+    main()
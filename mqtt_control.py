@@ -8,43 +8,126 @@ Requiere: pip install paho-mqtt
 import paho.mqtt.client as mqtt
 import json
 import argparse
+import hashlib
+import hmac
+import sys
+import threading
 import time
+import uuid
 
 def on_connect(client, userdata, flags, rc, properties=None):
     if rc == 0:
         print("Conectado al broker MQTT")
-        # Suscribirse al topic de status para ver respuestas
-        topic = f"/watchdog/{userdata['client_id']}/status"
-        client.subscribe(topic)
-        print(f"Suscrito a: {topic}")
+        # Suscribirse al topic de status, al de respuestas (acks) y al de
+        # metricas. Para comandos de grupo/difusion los acks llegan de
+        # cualquier equipo
+        device = '+' if userdata['fleet'] else userdata['client_id']
+        for suffix in ('status', 'response', 'journal', 'metrics'):
+            topic = f"/watchdog/{device}/{suffix}"
+            client.subscribe(topic)
+            print(f"Suscrito a: {topic}")
+        userdata['connected'].set()
     else:
         print(f"Error conectando: {rc}")
 
 def on_message(client, userdata, msg):
-    print(f"\nMensaje recibido de {msg.topic}:")
     try:
         payload = json.loads(msg.payload.decode())
+    except ValueError:
+        payload = None
+
+    # Ack del comando que enviamos: despertar a send_command
+    if (msg.topic.endswith('/response') and isinstance(payload, dict)
+            and payload.get('id') == userdata.get('pending_id')):
+        device = msg.topic.split('/')[2]
+        userdata['acks'][device] = payload
+        if not userdata['fleet']:
+            userdata['ack_event'].set()
+        return
+
+    # Mientras se juntan acks de un grupo no se imprime el resto
+    if userdata['fleet'] and userdata['pending_id']:
+        return
+
+    print(f"\nMensaje recibido de {msg.topic}:")
+    if payload is not None:
         print(json.dumps(payload, indent=2))
-    except:
+    else:
         print(msg.payload.decode())
 
-def send_command(client, client_id, cmd, duration=None):
-    topic = f"/watchdog/{client_id}/cmd"
+def command_topic(args):
+    if args.all:
+        return "/watchdog/broadcast/cmd"
+    if args.group:
+        return f"/watchdog/group/{args.group}/cmd"
+    return f"/watchdog/{args.client_id}/cmd"
+
+def print_ack(device, ack, elapsed_ms=None):
+    elapsed = f" en {elapsed_ms:.0f} ms" if elapsed_ms is not None else ""
+    if ack.get('status') == 'accepted' and 'count' in ack:
+        print(f"{device}: {ack['count']} registros del diario{elapsed}")
+    elif ack.get('status') == 'accepted' and 'deadline_ms' in ack:
+        print(f"{device}: actualizacion en curso, {ack['deadline_ms'] // 1000} s para confirmarse{elapsed}")
+    elif ack.get('status') == 'accepted':
+        delay = f", demora {ack['delay_ms']} ms" if ack.get('delay_ms') else ""
+        print(f"{device}: aceptado ({ack.get('duration')} ms{delay}){elapsed}")
+    else:
+        print(f"{device}: rechazado: {ack.get('reason')}{elapsed}")
 
-    payload = {"cmd": cmd}
-    if duration is not None:
-        payload["duration"] = duration
+def ota_fields(url, firmware, key):
+    """url, sha256 y firma de un comando ota (ver ota_update.py)"""
+    with open(firmware, 'rb') as f:
+        sha256_hex = hashlib.sha256(f.read()).hexdigest()
+    message = f"ota1 {url} {sha256_hex}"
+    sig = hmac.new(key.encode(), message.encode(), hashlib.sha256).hexdigest()
+    return {"url": url, "sha256": sha256_hex, "sig": sig}
+
+def send_command(client, userdata, topic, payload, timeout=2.0):
+    """Envia un comando a un equipo y espera su ack. Devuelve el ack o None si vence el timeout."""
+    cmd_id = payload["id"]
 
     message = json.dumps(payload)
     print(f"\nEnviando a {topic}:")
     print(message)
 
+    userdata['pending_id'] = cmd_id
+    userdata['acks'].clear()
+    userdata['ack_event'].clear()
+    start = time.monotonic()
     result = client.publish(topic, message)
 
-    if result.rc == mqtt.MQTT_ERR_SUCCESS:
-        print("Comando enviado exitosamente")
-    else:
+    if result.rc != mqtt.MQTT_ERR_SUCCESS:
+        print(f"Error enviando comando: {result.rc}")
+        return None
+
+    if not userdata['ack_event'].wait(timeout):
+        print(f"Sin respuesta del watchdog en {timeout} s")
+        return None
+
+    ack = userdata['acks'][userdata['client_id']]
+    print_ack(userdata['client_id'], ack, (time.monotonic() - start) * 1000)
+    return ack
+
+def send_fleet_command(client, userdata, topic, payload, timeout=2.0):
+    """Publica una sola vez en el topic compartido y junta los acks de todos
+    los equipos que respondan durante timeout. Devuelve {client_id: ack}."""
+    userdata['pending_id'] = payload["id"]
+    userdata['acks'].clear()
+
+    message = json.dumps(payload)
+    print(f"\nEnviando a {topic}:")
+    print(message)
+    result = client.publish(topic, message)
+    if result.rc != mqtt.MQTT_ERR_SUCCESS:
         print(f"Error enviando comando: {result.rc}")
+        return {}
+
+    time.sleep(timeout)
+    acks = dict(userdata['acks'])
+    for device in sorted(acks):
+        print_ack(device, acks[device])
+    print(f"{len(acks)} equipos respondieron en {timeout} s")
+    return acks
 
 def main():
     parser = argparse.ArgumentParser(description='Control del ATX Watchdog via MQTT')
@@ -53,14 +136,34 @@ def main():
     parser.add_argument('-u', '--user', help='Usuario MQTT')
     parser.add_argument('-P', '--password', help='Password MQTT')
     parser.add_argument('-c', '--client-id', default='watchdog-001', help='Client ID del watchdog (default: watchdog-001)')
-    parser.add_argument('command', choices=['power', 'reset', 'listen'], help='Comando a ejecutar')
+    parser.add_argument('command', choices=['power', 'reset', 'force_off', 'journal', 'ota', 'listen'], help='Comando a ejecutar')
     parser.add_argument('-d', '--duration', type=int, help='Duracion del click en milisegundos')
+    parser.add_argument('-n', '--count', type=int, help='Registros del diario a pedir con "journal" (1-20)')
+    parser.add_argument('-t', '--timeout', type=float, default=2.0, help='Segundos a esperar el ack (default: 2)')
+    target = parser.add_mutually_exclusive_group()
+    target.add_argument('-g', '--group', help='Enviar al grupo en lugar de a un solo equipo')
+    target.add_argument('-a', '--all', action='store_true', help='Enviar a todos los equipos (difusion)')
+    parser.add_argument('-f', '--filter', help='Patrones de client_id separados por coma (ej: rack1-*)')
+    parser.add_argument('-s', '--stagger', type=int, help='Ventana de arranque escalonado en ms')
+    parser.add_argument('--url', help='URL http:// de la imagen para "ota"')
+    parser.add_argument('--firmware', help='Copia local de la imagen para "ota" (para calcular su sha256)')
+    parser.add_argument('-k', '--key', help='Clave OTA para firmar "ota"')
 
     args = parser.parse_args()
+    if args.command == 'ota' and not (args.url and args.firmware and args.key):
+        parser.error('"ota" requiere --url, --firmware y --key')
 
     # Crear cliente MQTT
     client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, client_id="watchdog-control")
-    client.user_data_set({'client_id': args.client_id})
+    userdata = {
+        'client_id': args.client_id,
+        'fleet': bool(args.group or args.all),
+        'connected': threading.Event(),
+        'ack_event': threading.Event(),
+        'pending_id': None,
+        'acks': {},
+    }
+    client.user_data_set(userdata)
     client.on_connect = on_connect
     client.on_message = on_message
 
@@ -68,11 +171,13 @@ def main():
         client.username_pw_set(args.user, args.password)
 
     print(f"Conectando a {args.host}:{args.port}...")
+    exit_code = 0
     try:
         client.connect(args.host, args.port, 60)
         client.loop_start()
 
-        time.sleep(1)  # Esperar conexion
+        if not userdata['connected'].wait(5):
+            raise RuntimeError("timeout conectando al broker")
 
         if args.command == 'listen':
             print("\nEscuchando mensajes del watchdog...")
@@ -83,14 +188,40 @@ def main():
             except KeyboardInterrupt:
                 print("\nSaliendo...")
         else:
-            send_command(client, args.client_id, args.command, args.duration)
-            time.sleep(2)  # Esperar respuesta
+            payload = {"cmd": args.command, "id": uuid.uuid4().hex[:12]}
+            if args.duration is not None:
+                payload["duration"] = args.duration
+            if args.count is not None:
+                payload["count"] = args.count
+            if args.filter:
+                payload["filter"] = args.filter
+            if args.stagger is not None:
+                payload["stagger_ms"] = args.stagger
+            if args.command == 'ota':
+                payload.update(ota_fields(args.url, args.firmware, args.key))
+
+            topic = command_topic(args)
+            if userdata['fleet']:
+                acks = send_fleet_command(client, userdata, topic, payload, args.timeout)
+                if not acks:
+                    exit_code = 2
+                elif any(a.get('status') != 'accepted' for a in acks.values()):
+                    exit_code = 1
+            else:
+                ack = send_command(client, userdata, topic, payload, args.timeout)
+                if ack is None:
+                    exit_code = 2
+                elif ack.get('status') != 'accepted':
+                    exit_code = 1
 
         client.loop_stop()
         client.disconnect()
 
     except Exception as e:
         print(f"Error: {e}")
+        exit_code = 2
+
+    sys.exit(exit_code)
 
 if __name__ == '__main__':
     main()
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""
+ATX Watchdog OTA Update
+Sirve un firmware por HTTP, firma el pedido y se lo manda al watchdog
+(POST /api/ota). El watchdog baja la imagen solo y avisa el resultado por
+eventos MQTT; el script espera a que termine la descarga.
+Sin dependencias externas.
+"""
+
+import argparse
+import hashlib
+import hmac
+import http.server
+import json
+import os
+import socket
+import sys
+import threading
+import time
+import urllib.error
+import urllib.request
+
+def sign_request(url, sha256_hex, key):
+    """HMAC-SHA256 en hex de "ota1 <url> <sha256>" """
+    message = f"ota1 {url} {sha256_hex}"
+    return hmac.new(key.encode(), message.encode(), hashlib.sha256).hexdigest()
+
+def local_ip_for(host):
+    """IP de la interfaz por la que se llega al watchdog"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    try:
+        sock.connect((host, 80))
+        return sock.getsockname()[0]
+    finally:
+        sock.close()
+
+class FirmwareHandler(http.server.BaseHTTPRequestHandler):
+    image = b''
+    served = threading.Event()
+
+    def do_GET(self):
+        if self.path != '/firmware.bin':
+            self.send_error(404)
+            return
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/octet-stream')
+        self.send_header('Content-Length', str(len(self.image)))
+        self.send_header('Connection', 'close')
+        self.end_headers()
+        self.wfile.write(self.image)
+        FirmwareHandler.served.set()
+
+    def log_message(self, fmt, *args):
+        print(f"HTTP {self.address_string()}: {fmt % args}")
+
+def main():
+    parser = argparse.ArgumentParser(description='Actualiza el firmware del ATX Watchdog por WiFi')
+    parser.add_argument('host', help='IP o hostname del watchdog')
+    parser.add_argument('firmware', help='Imagen a instalar (.pio/build/nodemcuv2/firmware.bin)')
+    parser.add_argument('-k', '--key', required=True, help='Clave OTA (la misma que en la config del watchdog)')
+    parser.add_argument('-p', '--port', type=int, default=8000, help='Puerto HTTP local para servir la imagen (default: 8000)')
+    parser.add_argument('-a', '--address', help='IP local que ve el watchdog (default: autodetectada)')
+    parser.add_argument('-t', '--timeout', type=float, default=120, help='Segundos a esperar la descarga (default: 120)')
+    args = parser.parse_args()
+
+    with open(args.firmware, 'rb') as f:
+        image = f.read()
+    if not image or image[0] != 0xE9:
+        print("El archivo no parece un firmware de ESP8266 (falta el byte magico 0xE9)")
+        sys.exit(2)
+
+    sha256_hex = hashlib.sha256(image).hexdigest()
+    address = args.address or local_ip_for(args.host)
+    url = f"http://{address}:{args.port}/firmware.bin"
+
+    FirmwareHandler.image = image
+    server = http.server.ThreadingHTTPServer(('', args.port), FirmwareHandler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    print(f"Sirviendo {os.path.basename(args.firmware)} ({len(image)} bytes, sha256 {sha256_hex[:16]}...) en {url}")
+
+    payload = json.dumps({"url": url, "sha256": sha256_hex, "sig": sign_request(url, sha256_hex, args.key)})
+    request = urllib.request.Request(f"http://{args.host}/api/ota", data=payload.encode(),
+                                     headers={'Content-Type': 'application/json'})
+    try:
+        with urllib.request.urlopen(request, timeout=5) as response:
+            ack = json.loads(response.read().decode())
+    except urllib.error.HTTPError as e:
+        ack = json.loads(e.read().decode() or '{}')
+        print(f"Rechazado ({e.code}): {ack.get('reason')}")
+        sys.exit(1)
+    except (OSError, ValueError) as e:
+        print(f"Error enviando el pedido: {e}")
+        sys.exit(2)
+
+    print(f"Aceptado: la imagen nueva tiene {ack.get('deadline_ms', 0) // 1000} s para conectarse a MQTT")
+    start = time.monotonic()
+    if not FirmwareHandler.served.wait(args.timeout):
+        print(f"El watchdog no bajo la imagen en {args.timeout:.0f} s")
+        sys.exit(2)
+    # Dar tiempo a que el watchdog termine de leer antes de cerrar el servidor
+    time.sleep(2)
+    server.shutdown()
+    print(f"Imagen enviada en {time.monotonic() - start:.1f} s; el resultado llega por eventos MQTT (ota_installed/ota_failed)")
+
+if __name__ == '__main__':
+    main()
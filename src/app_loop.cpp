@@ -0,0 +1,186 @@
+#include "app_loop.h"
+#include "config.h"
+#include "metrics.h"
+#include "pulses.h"
+#include "buttons.h"
+#include "watchdog.h"
+#include "commands.h"
+#include "events.h"
+#include "heartbeat.h"
+#include "mqtt_link.h"
+#include "journal.h"
+#include "ota.h"
+#include "powersave.h"
+
+unsigned long pendingRestartAt = 0;
+unsigned long lastMqttHeartbeat = 0;
+unsigned long lastMetricsPublish = 0;
+bool liveMqttConnected = false;             // Ultimo estado MQTT enviado al panel en vivo
+
+void appLoop() {
+  powerSaveWake();
+  uint32_t loopStart = halMicros();
+  uint32_t t = loopStart;
+
+  // Completar pulsos GPIO pendientes
+  processPulses();
+  processScheduledCommand();
+  t = recordSection(SEC_PULSES, t);
+
+  // Reinicio diferido (solo para cambios que no se pueden aplicar en vivo)
+  if (pendingRestartAt != 0 && (long)(halMillis() - pendingRestartAt) >= 0) {
+    halLog("Reiniciando para aplicar configuracion...\n");
+    pendingRestartAt = 0;
+    journalFlush();
+    saveHeartbeatRecord();
+    halRestart();
+  }
+
+  // Chequear botones fisicos
+  t = halMicros();
+  checkPhysicalButtons();
+  t = recordSection(SEC_BUTTONS, t);
+
+  // Manejar servidor web
+  halHttpPoll();
+  halSsePoll();
+  t = recordSection(SEC_HTTP, t);
+
+  // Mantener conexion MQTT
+  if (!halMqttConnected()) {
+    reconnectMqtt();
+    t = recordSection(SEC_MQTT_RECONNECT, t);
+  }
+  halMqttLoop();
+  if (halMqttConnected() != liveMqttConnected) {
+    liveMqttConnected = halMqttConnected();
+    publishLiveUpdate("mqtt", "\"connected\":%s,\"failures\":%d,\"event_queue\":%d",
+                      liveMqttConnected ? "true" : "false", mqttLink.failures, eventQueueLength());
+  }
+  t = recordSection(SEC_MQTT_LOOP, t);
+
+  // Heartbeat MQTT de baja frecuencia (los cambios se publican como eventos)
+  unsigned long now = halMillis();
+  if (now - lastMqttHeartbeat > MQTT_HEARTBEAT_INTERVAL) {
+    publishOnlineStatus();
+    lastMqttHeartbeat = now;
+  }
+  if (now - lastMetricsPublish > METRICS_PUBLISH_INTERVAL) {
+    publishMetrics();
+    lastMetricsPublish = now;
+  }
+  journalLoop();
+  t = recordSection(SEC_KEEPALIVE, t);
+
+  // Latidos UDP recibidos y watchdog
+  checkHeartbeats();
+  checkTcpWatchdog();
+  t = recordSection(SEC_WATCHDOG, t);
+
+  // Actualizacion de firmware en curso (un bloque por iteracion)
+  otaLoop();
+  recordSection(SEC_OTA, t);
+
+  recordSection(SEC_LOOP, loopStart);
+
+  // Sin nada pendiente: esperar al proximo vencimiento (segun el modo)
+  powerSaveIdle();
+}
+
+void reconnectMqtt() {
+  if (!mqttLinkReady(config.mqtt_server, config.mqtt_port)) return;
+
+  unsigned long now = halMillis();
+  halLog("Conectando a MQTT...");
+
+  // Last Will: el broker publica "offline" (retenido) si se corta la sesion
+  static char statusTopic[64];
+  snprintf(statusTopic, sizeof(statusTopic), "/watchdog/%s/status", config.client_id);
+  const char* user = strlen(config.mqtt_user) > 0 ? config.mqtt_user : nullptr;
+  const char* pass = user != nullptr ? config.mqtt_pass : nullptr;
+  bool connected = halMqttConnect(mqttLinkAddress(), config.mqtt_port, config.client_id, user, pass,
+                                  statusTopic, MQTT_OFFLINE_PAYLOAD);
+
+  if (connected) {
+    halLog("MQTT conectado!\n");
+    if (bootTimeline.mqtt_connected == 0) bootTimeline.mqtt_connected = halMillis();
+    actionCounters.mqtt_connects++;
+    mqttLinkResult(true);
+
+    // Suscribirse al topic de comandos
+    static char cmdTopic[64];
+    snprintf(cmdTopic, sizeof(cmdTopic), "/watchdog/%s/cmd", config.client_id);
+    halMqttSubscribe(cmdTopic);
+    halLog("Suscrito a: %s\n", cmdTopic);
+
+    // Topics compartidos: difusion y grupos configurados
+    halMqttSubscribe(MQTT_BROADCAST_TOPIC);
+    const char* cursor = config.mqtt_groups;
+    char group[MQTT_GROUP_NAME_SIZE];
+    for (int i = 0; i < MQTT_MAX_GROUPS && nextMqttGroup(cursor, group, sizeof(group)); i++) {
+      snprintf(cmdTopic, sizeof(cmdTopic), MQTT_GROUP_TOPIC_FORMAT, group);
+      halMqttSubscribe(cmdTopic);
+      halLog("Suscrito a: %s\n", cmdTopic);
+    }
+
+    // Reemplazar el "offline" retenido, vaciar la cola de eventos offline
+    // (en orden) y avisar la reconexion
+    publishOnlineStatus();
+    lastMqttHeartbeat = now;
+    int flushed = flushEventQueue();
+    journalAppend(JOURNAL_MQTT_CONNECTED, JOURNAL_NO_TARGET, flushed, actionCounters.mqtt_connects,
+                  config.mqtt_server);
+    publishEvent("mqtt_connected", "\"connects\":%lu,\"flushed\":%d,\"dropped\":%lu",
+                 (unsigned long)actionCounters.mqtt_connects, flushed,
+                 (unsigned long)actionCounters.events_dropped);
+  } else {
+    halLog("fallo, rc=%d\n", halMqttState());
+    actionCounters.mqtt_connect_failures++;
+    mqttLinkResult(false);
+  }
+}
+
+void publishOnlineStatus() {
+  if (!halMqttConnected()) return;
+
+  static char topic[64];
+  static char payload[128];
+  uint32_t ip = halLocalIp();
+  snprintf(topic, sizeof(topic), "/watchdog/%s/status", config.client_id);
+  snprintf(payload, sizeof(payload),
+           "{\"status\":\"online\",\"uptime\":%lu,\"ip\":\"%u.%u.%u.%u\",\"rssi\":%d}",
+           halMillis() / 1000, (unsigned)(ip & 0xff), (unsigned)((ip >> 8) & 0xff),
+           (unsigned)((ip >> 16) & 0xff), (unsigned)(ip >> 24), halWifiRssi());
+
+  halMqttPublish(topic, payload, true);
+  halLog("Estado MQTT publicado\n");
+}
+
+void publishMetrics() {
+  if (!halMqttConnected()) return;
+
+  static char topic[64];
+  static char payload[320];
+  snprintf(topic, sizeof(topic), "/watchdog/%s/metrics", config.client_id);
+  snprintf(payload, sizeof(payload),
+           "{\"metrics\":{\"heap\":%lu,\"max_block\":%lu,\"frag\":%u,"
+           "\"loop_max_us\":%lu,\"stalls\":%lu,\"http_max_us\":%lu,\"watchdog_max_us\":%lu,"
+           "\"power\":%lu,\"reset\":%lu,\"timeouts\":%lu,\"probes_ok\":%lu,\"probes_failed\":%lu,"
+           "\"duty_pct\":%.1f,\"est_ma\":%.1f}}",
+           (unsigned long)halFreeHeap(), (unsigned long)halMaxFreeBlock(),
+           (unsigned)halHeapFragmentation(),
+           (unsigned long)loopStats[SEC_LOOP].max_us, (unsigned long)loopStats[SEC_LOOP].stalls,
+           (unsigned long)loopStats[SEC_HTTP].max_us, (unsigned long)loopStats[SEC_WATCHDOG].max_us,
+           (unsigned long)actionCounters.power_clicks, (unsigned long)actionCounters.reset_clicks,
+           (unsigned long)actionCounters.watchdog_timeouts,
+           (unsigned long)actionCounters.probes_ok, (unsigned long)actionCounters.probes_failed,
+           powerSaveDutyPct(), powerSaveEstimatedMa());
+
+  halMqttPublish(topic, payload, false);
+}
+
+void mqttCallback(char* topic, uint8_t* payload, unsigned int length) {
+  halLog("Mensaje MQTT recibido en %s (%u bytes)\n", topic, length);
+
+  handleMqttCommand(payload, length);
+}
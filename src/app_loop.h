@@ -0,0 +1,27 @@
+#pragma once
+
+// Cuerpo de loop() y sesion MQTT, compartidos por el ESP8266 (main.cpp) y el
+// simulador nativo: los dos builds corren exactamente la misma secuencia.
+// Lo que depende del hardware (servidor web, PubSubClient, WiFi) pasa por
+// la HAL.
+
+#include "hal.h"
+
+#define METRICS_PUBLISH_INTERVAL 60000UL      // Telemetria compacta por MQTT
+#define MQTT_HEARTBEAT_INTERVAL 300000UL      // 5 minutos (respaldo; el LWT avisa la caida)
+
+// Estado publicado por el broker (Last Will) cuando se corta la sesion MQTT
+#define MQTT_OFFLINE_PAYLOAD "{\"status\":\"offline\"}"
+
+extern unsigned long pendingRestartAt;      // 0 = sin reinicio pendiente
+
+// Una iteracion de loop(): pulsos, botones, web, MQTT, watchdog, OTA y la
+// espera de ahorro de energia al final
+void appLoop();
+// No bloquea: sondea el broker en segundo plano respetando el backoff
+void reconnectMqtt();
+// Estado retenido en el topic de status (buffer estatico, sin heap)
+void publishOnlineStatus();
+// Telemetria compacta en su propio topic (buffer estatico, sin heap)
+void publishMetrics();
+void mqttCallback(char* topic, uint8_t* payload, unsigned int length);
@@ -0,0 +1,170 @@
+#include "buttons.h"
+#include "config.h"
+#include "events.h"
+#include "journal.h"
+#include "powersave.h"
+#include "pulses.h"
+
+static_assert((BUTTON_QUEUE_SIZE & (BUTTON_QUEUE_SIZE - 1)) == 0, "BUTTON_QUEUE_SIZE debe ser potencia de 2");
+
+// Flanco capturado en la ISR
+struct ButtonEdge {
+  uint8_t button;
+  bool pressed;
+  unsigned long at_ms;
+};
+
+// Estado de debounce de un boton. raw es el ultimo nivel visto en la cola y
+// stable el nivel aceptado; el cambio se acepta cuando raw se mantiene
+// BUTTON_DEBOUNCE_MS. Los tiempos salen de la ISR, no de cuando corre el loop.
+struct PhysicalButton {
+  uint8_t pin;
+  const char* name;
+  bool long_press;              // false = actua al presionar, sin esperar
+  volatile bool isr_level;      // Ultimo nivel encolado por la ISR
+  bool raw;
+  unsigned long raw_since;
+  bool stable;
+  unsigned long pressed_at;
+  bool handled;                 // La pulsacion actual ya ejecuto su accion
+};
+
+PhysicalButton physicalButtons[] = {
+  { POWER_BUTTON_PIN, "power", true,  false, false, 0, false, 0, false },
+  { RESET_BUTTON_PIN, "reset", false, false, false, 0, false, 0, false },
+};
+const int PHYSICAL_BUTTON_COUNT = sizeof(physicalButtons) / sizeof(physicalButtons[0]);
+
+// Cola circular de un productor (ISR) y un consumidor (loop): la ISR solo
+// escribe buttonQueueHead y el loop solo buttonQueueTail.
+ButtonEdge buttonQueue[BUTTON_QUEUE_SIZE];
+volatile uint32_t buttonQueueHead = 0;
+volatile uint32_t buttonQueueTail = 0;
+volatile bool buttonQueueOverflow = false;
+
+void IRAM_ATTR recordButtonEdge(uint8_t index) {
+  PhysicalButton& b = physicalButtons[index];
+  bool pressed = !halDigitalRead(b.pin); // LOW = presionado (INPUT_PULLUP)
+  if (pressed == b.isr_level) return;    // Flanco repetido: no cambia nada
+
+  uint32_t head = buttonQueueHead;
+  if (head - buttonQueueTail >= BUTTON_QUEUE_SIZE) {
+    buttonQueueOverflow = true;
+    return;
+  }
+  ButtonEdge& e = buttonQueue[head & (BUTTON_QUEUE_SIZE - 1)];
+  e.button = index;
+  e.pressed = pressed;
+  e.at_ms = halMillis();
+  b.isr_level = pressed;
+  buttonQueueHead = head + 1;
+  // Cortar la espera de ahorro de energia: la pulsacion se atiende ya
+  halIdleWake();
+}
+
+void IRAM_ATTR powerButtonIsr() { recordButtonEdge(0); }
+void IRAM_ATTR resetButtonIsr() { recordButtonEdge(1); }
+
+void setupPhysicalButtons() {
+  unsigned long now = halMillis();
+  for (int i = 0; i < PHYSICAL_BUTTON_COUNT; i++) {
+    PhysicalButton& b = physicalButtons[i];
+    b.isr_level = !halDigitalRead(b.pin);
+    b.raw = b.isr_level;
+    b.raw_since = now;
+    // Un boton apretado al arrancar no cuenta hasta que se suelte
+    b.stable = b.raw;
+    b.handled = true;
+  }
+  halAttachChangeInterrupt(POWER_BUTTON_PIN, powerButtonIsr);
+  halAttachChangeInterrupt(RESET_BUTTON_PIN, resetButtonIsr);
+}
+
+void runButtonAction(PhysicalButton& b, bool longPress, unsigned long held_ms) {
+  b.handled = true;
+  halLog("Boton %s fisico: pulsacion %s (%lu ms)\n", b.name, longPress ? "larga" : "corta", held_ms);
+  publishQueuedEvent("button", "\"button\":\"%s\",\"press\":\"%s\",\"held_ms\":%lu",
+                    b.name, longPress ? "long" : "short", held_ms);
+  journalAppend(JOURNAL_BUTTON, JOURNAL_NO_TARGET, longPress ? 1 : 0, held_ms, b.name);
+
+  if (b.pin == POWER_BUTTON_PIN) {
+    clickButton(POWER_PIN, longPress ? FORCE_OFF_MS : config.power_click_ms);
+  } else {
+    clickButton(RESET_PIN, config.reset_click_ms);
+  }
+}
+
+// Acepta el nivel raw si se mantuvo estable hasta 'until'
+void settleButton(PhysicalButton& b, unsigned long until) {
+  if (b.raw == b.stable || until - b.raw_since < BUTTON_DEBOUNCE_MS) return;
+
+  b.stable = b.raw;
+  if (b.stable) {
+    b.pressed_at = b.raw_since;
+    b.handled = false;
+    if (!b.long_press) runButtonAction(b, false, 0);
+  } else if (!b.handled) {
+    // Soltado antes de llegar a pulsacion larga (o el loop no llego a verla)
+    unsigned long held = b.raw_since - b.pressed_at;
+    runButtonAction(b, held >= BUTTON_LONG_PRESS_MS, held);
+  } else {
+    b.handled = false;
+  }
+}
+
+void checkPhysicalButtons() {
+  // Consumir los flancos en orden; cada uno cierra el intervalo del anterior
+  while (buttonQueueTail != buttonQueueHead) {
+    const ButtonEdge& e = buttonQueue[buttonQueueTail & (BUTTON_QUEUE_SIZE - 1)];
+    PhysicalButton& b = physicalButtons[e.button];
+    settleButton(b, e.at_ms);
+    b.raw = e.pressed;
+    b.raw_since = e.at_ms;
+    buttonQueueTail = buttonQueueTail + 1;
+  }
+
+  unsigned long now = halMillis();
+  for (int i = 0; i < PHYSICAL_BUTTON_COUNT; i++) {
+    PhysicalButton& b = physicalButtons[i];
+
+    // Cola desbordada (rebotes con el loop bloqueado): resincronizar con el pin
+    if (buttonQueueOverflow) {
+      bool level = !halDigitalRead(b.pin);
+      if (level != b.raw) {
+        b.raw = level;
+        b.raw_since = now;
+      }
+      b.isr_level = level;
+    }
+
+    settleButton(b, now);
+
+    // Pulsacion larga: actuar mientras se mantiene, sin esperar a soltar. Si
+    // ya hay un flanco de soltar sin asentar, decide settleButton con el
+    // tiempo real de la pulsacion.
+    if (b.stable && b.raw && b.long_press && !b.handled &&
+        now - b.pressed_at >= BUTTON_LONG_PRESS_MS) {
+      runButtonAction(b, true, now - b.pressed_at);
+    }
+  }
+
+  if (buttonQueueOverflow) {
+    buttonQueueOverflow = false;
+    halLog("Botones: cola de flancos desbordada, estado resincronizado\n");
+  }
+}
+
+void buttonsIdleBudget(unsigned long now, unsigned long& budget) {
+  if (buttonQueueTail != buttonQueueHead || buttonQueueOverflow) {
+    budget = 0;
+    return;
+  }
+  for (int i = 0; i < PHYSICAL_BUTTON_COUNT; i++) {
+    const PhysicalButton& b = physicalButtons[i];
+    if (b.raw != b.stable) {
+      limitIdle(budget, now, b.raw_since + BUTTON_DEBOUNCE_MS);
+    } else if (b.stable && b.long_press && !b.handled) {
+      limitIdle(budget, now, b.pressed_at + BUTTON_LONG_PRESS_MS);
+    }
+  }
+}
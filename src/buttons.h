@@ -0,0 +1,22 @@
+#pragma once
+
+// Botones fisicos del watchdog (replican los pulsos POWER/RESET). Las
+// interrupciones de flanco cargan una cola circular que se procesa desde
+// loop() con una maquina de estados de debounce por boton; una pulsacion
+// nunca se pierde aunque el loop este ocupado.
+
+#include "hal.h"
+
+// Pines GPIO - Entradas (botones fisicos en el watchdog)
+#define POWER_BUTTON_PIN D5  // GPIO14 - Input para boton POWER fisico
+#define RESET_BUTTON_PIN D6  // GPIO12 - Input para boton RESET fisico
+#define POWER_LED_PIN D7     // GPIO13 - Input opcional del LED de power (config.power_led_mode)
+
+#define BUTTON_DEBOUNCE_MS 30          // Nivel estable minimo para aceptar un cambio
+#define BUTTON_LONG_PRESS_MS 3000      // Pulsacion larga en POWER = apagado forzado
+#define BUTTON_QUEUE_SIZE 32           // Flancos pendientes (potencia de 2)
+
+void setupPhysicalButtons();
+void checkPhysicalButtons();
+// Acota la espera de powersave.h al fin del debounce o de la pulsacion larga
+void buttonsIdleBudget(unsigned long now, unsigned long& budget);
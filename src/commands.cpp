@@ -0,0 +1,408 @@
+#include "commands.h"
+#include "config.h"
+#include "pulses.h"
+#include "journal.h"
+#include "powersave.h"
+
+// Parser JSON acotado para el esquema de comandos: un objeto plano con
+// valores string, numero entero o literal. No usa heap y recorre el payload
+// una sola vez; objetos/arreglos anidados y strings con escapes se rechazan.
+struct JsonCursor {
+  const uint8_t* p;
+  const uint8_t* end;
+};
+
+void skipJsonSpace(JsonCursor& c) {
+  while (c.p < c.end && (*c.p == ' ' || *c.p == '\t' || *c.p == '\r' || *c.p == '\n')) c.p++;
+}
+
+bool consumeJsonChar(JsonCursor& c, char ch) {
+  skipJsonSpace(c);
+  if (c.p >= c.end || *c.p != ch) return false;
+  c.p++;
+  return true;
+}
+
+// Copia el string en dest (si no es nullptr). Falla si no entra en size.
+bool parseJsonString(JsonCursor& c, char* dest, size_t size) {
+  if (!consumeJsonChar(c, '"')) return false;
+  size_t len = 0;
+  while (c.p < c.end && *c.p != '"') {
+    if (*c.p == '\\' || *c.p < 0x20) return false;
+    if (dest != nullptr) {
+      if (len + 1 >= size) return false;
+      dest[len] = (char)*c.p;
+    }
+    len++;
+    c.p++;
+  }
+  if (c.p >= c.end) return false;
+  c.p++;
+  if (dest != nullptr) dest[len] = '\0';
+  return true;
+}
+
+bool parseJsonInteger(JsonCursor& c, long& value) {
+  skipJsonSpace(c);
+  bool negative = c.p < c.end && *c.p == '-';
+  if (negative) c.p++;
+
+  int digits = 0;
+  long result = 0;
+  while (c.p < c.end && *c.p >= '0' && *c.p <= '9') {
+    if (++digits > 9) return false;
+    result = result * 10 + (*c.p - '0');
+    c.p++;
+  }
+  if (digits == 0) return false;
+  // Sin decimales ni exponente
+  if (c.p < c.end && (*c.p == '.' || *c.p == 'e' || *c.p == 'E')) return false;
+
+  value = negative ? -result : result;
+  return true;
+}
+
+bool consumeJsonLiteral(JsonCursor& c, const char* literal) {
+  size_t len = strlen(literal);
+  if ((size_t)(c.end - c.p) < len || memcmp(c.p, literal, len) != 0) return false;
+  c.p += len;
+  return true;
+}
+
+// Saltea el valor de una clave que no forma parte del esquema
+bool skipJsonValue(JsonCursor& c) {
+  skipJsonSpace(c);
+  if (c.p >= c.end) return false;
+  if (*c.p == '"') return parseJsonString(c, nullptr, 0);
+  if (*c.p == 't') return consumeJsonLiteral(c, "true");
+  if (*c.p == 'f') return consumeJsonLiteral(c, "false");
+  if (*c.p == 'n') return consumeJsonLiteral(c, "null");
+  long ignored;
+  return parseJsonInteger(c, ignored);
+}
+
+bool parseMqttCommand(const uint8_t* payload, unsigned int length, MqttCommand& out) {
+  memset(&out, 0, sizeof(out));
+  if (length > COMMAND_MAX_PAYLOAD) return false;
+
+  JsonCursor c = { payload, payload + length };
+  if (!consumeJsonChar(c, '{')) return false;
+
+  if (!consumeJsonChar(c, '}')) {
+    do {
+      char key[COMMAND_NAME_SIZE];
+      bool known = true;
+      JsonCursor keyStart = c;
+      if (!parseJsonString(c, key, sizeof(key))) {
+        // Clave larga: no es del esquema, solo hay que saltearla
+        c = keyStart;
+        if (!parseJsonString(c, nullptr, 0)) return false;
+        known = false;
+      }
+      if (!consumeJsonChar(c, ':')) return false;
+
+      bool ok;
+      if (known && strcmp(key, "cmd") == 0) {
+        ok = parseJsonString(c, out.cmd, sizeof(out.cmd));
+      } else if (known && strcmp(key, "id") == 0) {
+        ok = parseJsonString(c, out.id, sizeof(out.id));
+      } else if (known && strcmp(key, "duration") == 0) {
+        ok = parseJsonInteger(c, out.duration);
+        out.has_duration = ok;
+      } else if (known && strcmp(key, "filter") == 0) {
+        ok = parseJsonString(c, out.filter, sizeof(out.filter));
+      } else if (known && strcmp(key, "stagger_ms") == 0) {
+        ok = parseJsonInteger(c, out.stagger_ms);
+      } else if (known && strcmp(key, "count") == 0) {
+        ok = parseJsonInteger(c, out.count);
+        out.has_count = ok;
+      } else if (known && strcmp(key, "url") == 0) {
+        ok = parseJsonString(c, out.url, sizeof(out.url));
+      } else if (known && strcmp(key, "sha256") == 0) {
+        ok = parseJsonString(c, out.sha256, sizeof(out.sha256));
+      } else if (known && strcmp(key, "sig") == 0) {
+        ok = parseJsonString(c, out.sig, sizeof(out.sig));
+      } else {
+        ok = skipJsonValue(c);
+      }
+      if (!ok) return false;
+    } while (consumeJsonChar(c, ','));
+
+    if (!consumeJsonChar(c, '}')) return false;
+  }
+
+  skipJsonSpace(c);
+  return c.p == c.end && out.cmd[0] != '\0';
+}
+
+// Tabla de comandos: todos son pulsos sobre un pin con limites propios
+struct CommandEntry {
+  const char* name;
+  uint8_t pin;
+  int (*default_ms)();
+  long min_ms;
+  long max_ms;
+};
+
+int defaultPowerClickMs() { return config.power_click_ms; }
+int defaultResetClickMs() { return config.reset_click_ms; }
+int defaultForceOffMs() { return FORCE_OFF_MS; }
+
+const CommandEntry COMMAND_TABLE[] = {
+  { "power",     POWER_PIN, defaultPowerClickMs, COMMAND_MIN_PULSE_MS, PULSE_MAX_MS },
+  { "reset",     RESET_PIN, defaultResetClickMs, COMMAND_MIN_PULSE_MS, PULSE_MAX_MS },
+  { "force_off", POWER_PIN, defaultForceOffMs,   FORCE_OFF_MIN_MS,     PULSE_MAX_MS },
+};
+const int COMMAND_COUNT = sizeof(COMMAND_TABLE) / sizeof(COMMAND_TABLE[0]);
+
+const CommandEntry* findCommand(const char* name) {
+  for (int i = 0; i < COMMAND_COUNT; i++) {
+    if (strcmp(COMMAND_TABLE[i].name, name) == 0) return &COMMAND_TABLE[i];
+  }
+  return nullptr;
+}
+
+// Glob minimo: '*' equivale a cualquier secuencia (incluso vacia). Sin
+// recursion: ante un fallo se vuelve al ultimo '*' y este absorbe un
+// caracter mas, asi el costo es O(patron x texto) para cualquier patron.
+bool globMatch(const char* pattern, size_t pattern_len, const char* text) {
+  size_t p = 0;
+  size_t star = pattern_len;     // Posicion del ultimo '*' (ninguno)
+  const char* star_text = text;  // Texto que ese '*' ya absorbio
+  while (*text != '\0') {
+    if (p < pattern_len && pattern[p] == '*') {
+      star = p++;
+      star_text = text;
+    } else if (p < pattern_len && pattern[p] == *text) {
+      p++;
+      text++;
+    } else if (star != pattern_len) {
+      p = star + 1;
+      text = ++star_text;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern_len && pattern[p] == '*') p++;
+  return p == pattern_len;
+}
+
+bool validClientFilter(const char* filter) {
+  int stars = 0;
+  for (const char* p = filter; *p != '\0'; p++) {
+    if (*p == '*') stars++;
+  }
+  return stars <= COMMAND_FILTER_MAX_STARS;
+}
+
+bool matchesClientFilter(const char* filter, const char* client_id) {
+  if (filter[0] == '\0') return true;
+  const char* p = filter;
+  while (true) {
+    const char* comma = strchr(p, ',');
+    size_t len = comma != nullptr ? (size_t)(comma - p) : strlen(p);
+    if (len > 0 && globMatch(p, len, client_id)) return true;
+    if (comma == nullptr) return false;
+    p = comma + 1;
+  }
+}
+
+// FNV-1a del client_id: el mismo equipo cae siempre en el mismo offset y
+// equipos con nombres correlativos quedan repartidos en la ventana
+unsigned long staggerOffsetMs(const char* client_id, long window_ms) {
+  if (window_ms <= 0) return 0;
+  uint32_t hash = 2166136261UL;
+  for (const char* p = client_id; *p != '\0'; p++) {
+    hash ^= (uint8_t)*p;
+    hash *= 16777619UL;
+  }
+  return hash % ((uint32_t)window_ms + 1);
+}
+
+bool nextMqttGroup(const char*& cursor, char* name, size_t size) {
+  while (*cursor != '\0') {
+    while (*cursor == ',' || *cursor == ' ') cursor++;
+    const char* start = cursor;
+    while (*cursor != '\0' && *cursor != ',') cursor++;
+    size_t len = cursor - start;
+    while (len > 0 && start[len - 1] == ' ') len--;
+    if (len == 0 || len >= size) continue;
+
+    bool valid = true;
+    for (size_t i = 0; i < len; i++) {
+      char c = start[i];
+      if (c == '/' || c == '+' || c == '#' || c == '"' || c == '\\' || (uint8_t)c < 0x21) valid = false;
+    }
+    if (!valid) continue;
+    memcpy(name, start, len);
+    name[len] = '\0';
+    return true;
+  }
+  return false;
+}
+
+// Publica el ack en el topic de respuestas (buffer estatico, sin heap). Los
+// strings del comando no tienen escapes (el parser los rechaza), asi que se
+// pueden copiar tal cual al JSON. value va en la clave value_key del ack
+// aceptado ("duration" para los pulsos); delay_ms > 0 indica un pulso escalonado.
+void publishCommandAck(const MqttCommand& cmd, bool accepted, const char* reason, const char* value_key,
+                       long value, unsigned long delay_ms = 0) {
+  static char topic[64];
+  static char payload[192];
+  snprintf(topic, sizeof(topic), "/watchdog/%s/response", config.client_id);
+
+  int n;
+  if (cmd.id[0] != '\0') {
+    n = snprintf(payload, sizeof(payload), "{\"id\":\"%s\"", cmd.id);
+  } else {
+    n = snprintf(payload, sizeof(payload), "{\"id\":null");
+  }
+  n += snprintf(payload + n, sizeof(payload) - n, ",\"cmd\":\"%s\",\"status\":\"%s\"",
+                cmd.cmd, accepted ? "accepted" : "rejected");
+  if (accepted) {
+    n += snprintf(payload + n, sizeof(payload) - n, ",\"%s\":%ld", value_key, value);
+    if (delay_ms > 0) n += snprintf(payload + n, sizeof(payload) - n, ",\"delay_ms\":%lu", delay_ms);
+  } else {
+    n += snprintf(payload + n, sizeof(payload) - n, ",\"reason\":\"%s\"", reason);
+  }
+  snprintf(payload + n, sizeof(payload) - n, ",\"ts\":%lu}", halMillis());
+
+  halMqttPublish(topic, payload, false);
+}
+
+// Un solo comando escalonado en espera: alcanza para un pulso por equipo
+struct ScheduledCommand {
+  bool active;
+  MqttCommand cmd;
+  const CommandEntry* entry;
+  long duration;
+  unsigned long due;
+};
+
+ScheduledCommand scheduledCommand;
+
+// Ultimos registros del diario, del mas viejo al mas nuevo, y despues el ack
+void publishJournalTail(const MqttCommand& cmd) {
+  long count = cmd.has_count ? cmd.count : JOURNAL_TAIL_DEFAULT;
+  if (count < 1 || count > JOURNAL_TAIL_MAX) {
+    halLog("Comando journal rechazado: count %ld fuera de rango (1-%d)\n", count, JOURNAL_TAIL_MAX);
+    publishCommandAck(cmd, false, "count_out_of_range", "count", count);
+    return;
+  }
+
+  static char topic[64];
+  static char payload[JOURNAL_JSON_SIZE];
+  snprintf(topic, sizeof(topic), "/watchdog/%s/journal", config.client_id);
+
+  uint32_t last = journalLastSeq();
+  uint32_t from = last >= (uint32_t)count ? last - count + 1 : 1;
+  if (from < journalFirstSeq()) from = journalFirstSeq();
+  int sent = 0;
+  JournalRecord r;
+  for (uint32_t seq = from; seq <= last; seq++) {
+    if (!journalRead(seq, r)) continue;
+    formatJournalRecord(r, payload, sizeof(payload));
+    if (halMqttPublish(topic, payload, false)) sent++;
+  }
+  halLog("Comando journal: %d registros publicados (id: %s)\n", sent, cmd.id[0] != '\0' ? cmd.id : "-");
+  publishCommandAck(cmd, true, nullptr, "count", sent);
+}
+
+// Valida el pedido y arranca la descarga; el resultado llega como eventos
+void startOtaCommand(const MqttCommand& cmd) {
+  const char* reason;
+  if (!otaStart(cmd.url, cmd.sha256, cmd.sig, reason)) {
+    publishCommandAck(cmd, false, reason, "deadline_ms", 0);
+    return;
+  }
+  publishCommandAck(cmd, true, nullptr, "deadline_ms", OTA_HEALTH_DEADLINE_MS);
+}
+
+void handleMqttCommand(const uint8_t* payload, unsigned int length) {
+  MqttCommand cmd;
+  if (!parseMqttCommand(payload, length, cmd)) {
+    halLog("Comando rechazado: JSON invalido\n");
+    publishCommandAck(cmd, false, "invalid_json", "duration", 0);
+    return;
+  }
+
+  if (!validClientFilter(cmd.filter)) {
+    halLog("Comando rechazado: filtro con mas de %d '*'\n", COMMAND_FILTER_MAX_STARS);
+    publishCommandAck(cmd, false, "invalid_filter", "duration", 0);
+    return;
+  }
+
+  // Comando de grupo/difusion dirigido a otros equipos: ni siquiera se
+  // responde, el controlador solo espera acks de los que coinciden
+  if (!matchesClientFilter(cmd.filter, config.client_id)) return;
+
+  if (strcmp(cmd.cmd, "journal") == 0) {
+    publishJournalTail(cmd);
+    return;
+  }
+  if (strcmp(cmd.cmd, "ota") == 0) {
+    startOtaCommand(cmd);
+    return;
+  }
+
+  const CommandEntry* entry = findCommand(cmd.cmd);
+  if (entry == nullptr) {
+    halLog("Comando desconocido: %s\n", cmd.cmd);
+    publishCommandAck(cmd, false, "unknown_command", "duration", 0);
+    return;
+  }
+
+  long duration = cmd.has_duration ? cmd.duration : entry->default_ms();
+  if (duration < entry->min_ms || duration > entry->max_ms) {
+    halLog("Comando %s rechazado: duracion %ld ms fuera de rango (%ld-%ld)\n",
+           entry->name, duration, entry->min_ms, entry->max_ms);
+    publishCommandAck(cmd, false, "duration_out_of_range", "duration", duration);
+    return;
+  }
+
+  if (cmd.stagger_ms < 0 || cmd.stagger_ms > COMMAND_MAX_STAGGER_MS) {
+    halLog("Comando %s rechazado: stagger_ms %ld fuera de rango\n", entry->name, cmd.stagger_ms);
+    publishCommandAck(cmd, false, "stagger_out_of_range", "duration", duration);
+    return;
+  }
+
+  unsigned long delay_ms = staggerOffsetMs(config.client_id, cmd.stagger_ms);
+  halLog("Comando %s recibido (duracion: %ld ms, demora: %lu ms, id: %s)\n", entry->name, duration,
+         delay_ms, cmd.id[0] != '\0' ? cmd.id : "-");
+  if (delay_ms > 0) {
+    if (scheduledCommand.active) {
+      publishCommandAck(cmd, false, "busy", "duration", duration);
+      return;
+    }
+    scheduledCommand.active = true;
+    scheduledCommand.cmd = cmd;
+    scheduledCommand.entry = entry;
+    scheduledCommand.duration = duration;
+    scheduledCommand.due = halMillis() + delay_ms;
+    publishCommandAck(cmd, true, nullptr, "duration", duration, delay_ms);
+    return;
+  }
+
+  if (!clickButton(entry->pin, duration)) {
+    publishCommandAck(cmd, false, "busy", "duration", duration);
+    return;
+  }
+  publishCommandAck(cmd, true, nullptr, "duration", duration);
+}
+
+void scheduledCommandIdleBudget(unsigned long now, unsigned long& budget) {
+  if (scheduledCommand.active) limitIdle(budget, now, scheduledCommand.due);
+}
+
+void processScheduledCommand() {
+  if (!scheduledCommand.active || (long)(halMillis() - scheduledCommand.due) < 0) return;
+  scheduledCommand.active = false;
+
+  const MqttCommand& cmd = scheduledCommand.cmd;
+  halLog("Comando %s escalonado: ejecutando (id: %s)\n", scheduledCommand.entry->name,
+         cmd.id[0] != '\0' ? cmd.id : "-");
+  // Ya se respondio "accepted" al recibirlo: solo se avisa si al final no se pudo
+  if (!clickButton(scheduledCommand.entry->pin, scheduledCommand.duration)) {
+    publishCommandAck(cmd, false, "busy", "duration", scheduledCommand.duration);
+  }
+}
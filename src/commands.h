@@ -0,0 +1,71 @@
+#pragma once
+
+// Comandos recibidos por MQTT en /watchdog/{client_id}/cmd, en el topic de
+// cada grupo configurado (/watchdog/group/{grupo}/cmd) y en el de difusion
+// (/watchdog/broadcast/cmd). Cada equipo responde con su propio ack en
+// /watchdog/{client_id}/response que repite el "id" enviado por quien lo
+// pidio, asi un controlador junta todos los resultados con un solo publish.
+//
+// En los topics compartidos el comando puede traer:
+//   "filter": patrones de client_id separados por coma ("rack1-*,gpu-03");
+//             los equipos que no coinciden lo ignoran sin responder. Con
+//             mas de COMMAND_FILTER_MAX_STARS '*' se rechaza (invalid_filter)
+//   "stagger_ms": ventana de arranque escalonado. Cada equipo demora el pulso
+//             un offset fijo dentro de la ventana derivado de su client_id,
+//             para que un rack entero no encienda en el mismo instante
+//
+// Ademas de los pulsos, {"cmd":"journal","count":N} publica los ultimos N
+// registros del diario (journal.h) en /watchdog/{client_id}/journal, uno por
+// mensaje y del mas viejo al mas nuevo, antes del ack.
+//
+// {"cmd":"ota","url":...,"sha256":...,"sig":...} inicia una actualizacion
+// de firmware firmada (ota.h). El ack solo dice si se acepto el pedido; el
+// avance se publica como eventos ota_*.
+
+#include "hal.h"
+#include "ota.h"
+
+#define COMMAND_NAME_SIZE 16
+#define COMMAND_ID_SIZE 40
+#define COMMAND_MAX_PAYLOAD 384        // Mensajes mas largos se rechazan sin parsear
+#define COMMAND_MIN_PULSE_MS 50        // Pulso minimo aceptado por power/reset
+#define FORCE_OFF_MIN_MS 4000          // Menos de ~4 s la fuente ATX no se apaga
+#define COMMAND_FILTER_SIZE 64
+#define COMMAND_FILTER_MAX_STARS 4     // Comodines por filtro (todos los patrones)
+#define COMMAND_MAX_STAGGER_MS 300000  // Ventana maxima de escalonado (5 min)
+#define MQTT_MAX_GROUPS 4
+#define MQTT_GROUP_NAME_SIZE 24
+#define MQTT_BROADCAST_TOPIC "/watchdog/broadcast/cmd"
+#define MQTT_GROUP_TOPIC_FORMAT "/watchdog/group/%s/cmd"
+
+// Campos del esquema de comandos (el resto de las claves se ignora)
+struct MqttCommand {
+  char cmd[COMMAND_NAME_SIZE];
+  char id[COMMAND_ID_SIZE];
+  long duration;
+  bool has_duration;
+  char filter[COMMAND_FILTER_SIZE];
+  long stagger_ms;
+  long count;
+  bool has_count;
+  char url[OTA_URL_SIZE];
+  char sha256[SHA256_DIGEST_SIZE * 2 + 1];
+  char sig[SHA256_DIGEST_SIZE * 2 + 1];
+};
+
+bool parseMqttCommand(const uint8_t* payload, unsigned int length, MqttCommand& out);
+void handleMqttCommand(const uint8_t* payload, unsigned int length);
+// Ejecuta el comando escalonado pendiente cuando vence su offset
+void processScheduledCommand();
+// Acota la espera de powersave.h al vencimiento del comando escalonado
+void scheduledCommandIdleBudget(unsigned long now, unsigned long& budget);
+
+// false si el filtro tiene mas de COMMAND_FILTER_MAX_STARS comodines
+bool validClientFilter(const char* filter);
+// true si client_id coincide con algun patron de la lista (vacia = todos)
+bool matchesClientFilter(const char* filter, const char* client_id);
+// Offset determinista dentro de [0, window_ms] para este client_id
+unsigned long staggerOffsetMs(const char* client_id, long window_ms);
+// Recorre config.mqtt_groups: copia el proximo nombre valido en name y
+// avanza cursor. Nombres vacios, largos o con comodines MQTT se saltean.
+bool nextMqttGroup(const char*& cursor, char* name, size_t size);
@@ -0,0 +1,402 @@
+#include "config.h"
+#include "probes.h"
+#include "sha256.h"
+
+Config config;
+
+void setDefaultTarget(WatchdogTarget& t) {
+  t.host[0] = '\0';
+  t.port = 22;
+  t.check_interval_ms = 30000; // 30 segundos
+  t.timeout_ms = 120000;       // 2 minutos
+  t.action = ACTION_POWER;
+}
+
+void sanitizeTarget(WatchdogTarget& t) {
+  // El host se copia tal cual en los eventos JSON: sin comillas ni escapes
+  char* w = t.host;
+  for (const char* r = t.host; *r != '\0'; r++) {
+    if (*r != '"' && *r != '\\' && (uint8_t)*r >= 0x20) *w++ = *r;
+  }
+  *w = '\0';
+  if (t.port <= 0 || t.port > 65535) t.port = 22;
+  if (t.check_interval_ms < WATCHDOG_MIN_INTERVAL_MS) t.check_interval_ms = WATCHDOG_MIN_INTERVAL_MS;
+  if (t.timeout_ms < t.check_interval_ms) t.timeout_ms = t.check_interval_ms;
+  if (t.action > ACTION_ESCALATE) t.action = ACTION_POWER;
+}
+
+const char* watchdogActionName(uint8_t action) {
+  switch (action) {
+    case ACTION_POWER: return "power";
+    case ACTION_RESET: return "reset";
+    case ACTION_ESCALATE: return "escalar";
+    default: return "alerta";
+  }
+}
+
+void setDefaultProbeSettings(ProbeSettings& p) {
+  memset(&p, 0, sizeof(p));
+  p.type = PROBE_TCP;
+  p.http_status = 200;
+  p.degraded_pct = 200;
+}
+
+void sanitizeProbeSettings(ProbeSettings& p) {
+  if (p.type > PROBE_HEARTBEAT) p.type = PROBE_TCP;
+  p.match[sizeof(p.match) - 1] = '\0';
+  // El path y el banner van tal cual en el request o el JSON de estado
+  for (char* c = p.match; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\' || (uint8_t)*c < 0x20) *c = '_';
+  }
+  if (p.http_status > 599) p.http_status = 200;
+  if (p.degraded_pct != 0 && p.degraded_pct < DEGRADED_PCT_MIN) p.degraded_pct = DEGRADED_PCT_MIN;
+  if (p.degraded_pct > DEGRADED_PCT_MAX) p.degraded_pct = DEGRADED_PCT_MAX;
+}
+
+void setDefaultSchedule(ProbeSchedule& s) {
+  s.min_interval_ms = 2000;     // Confirmacion rapida tras un fallo
+  s.max_interval_ms = 120000;   // Objetivo sano: hasta 2 minutos
+}
+
+// El intervalo base del objetivo siempre queda dentro de [min, max]
+void sanitizeSchedule(ProbeSchedule& s, const WatchdogTarget& t) {
+  uint32_t base = t.check_interval_ms;
+  if (s.min_interval_ms < WATCHDOG_MIN_INTERVAL_MS) s.min_interval_ms = WATCHDOG_MIN_INTERVAL_MS;
+  if (s.min_interval_ms > base) s.min_interval_ms = base;
+  if (s.max_interval_ms > PROBE_MAX_INTERVAL_MS) s.max_interval_ms = PROBE_MAX_INTERVAL_MS;
+  if (s.max_interval_ms < base) s.max_interval_ms = base;
+}
+
+// Reset a los 2 min; si sigue caido, apagado forzado y encendido
+void setDefaultRecovery(RecoveryPolicy& p) {
+  memset(&p, 0, sizeof(p));
+  p.steps[0] = { STEP_RESET, 120000 };
+  p.steps[1] = { STEP_FORCE_OFF, 240000 };
+  p.steps[2] = { STEP_POWER_ON, 260000 };
+  p.cooldown_ms = 600000;  // 10 minutos
+  p.max_attempts = 3;
+}
+
+// Compacta la escalera (el primer STEP_NONE la termina) y fuerza tiempos
+// crecientes con separacion minima entre pasos
+void sanitizeRecovery(RecoveryPolicy& p) {
+  uint32_t min_after = WATCHDOG_MIN_INTERVAL_MS;
+  bool ended = false;
+  for (int i = 0; i < RECOVERY_MAX_STEPS; i++) {
+    RecoveryStep& s = p.steps[i];
+    if (ended || s.action == STEP_NONE || s.action > STEP_POWER_ON) {
+      ended = true;
+      s.action = STEP_NONE;
+      s.after_ms = 0;
+      continue;
+    }
+    if (s.after_ms < min_after) s.after_ms = min_after;
+    min_after = s.after_ms + RECOVERY_MIN_STEP_GAP_MS;
+  }
+  if (p.steps[0].action == STEP_NONE) setDefaultRecovery(p);
+  if (p.max_attempts < 1) p.max_attempts = 1;
+  if (p.max_attempts > RECOVERY_MAX_ATTEMPTS) p.max_attempts = RECOVERY_MAX_ATTEMPTS;
+}
+
+bool recoveryEquals(const RecoveryPolicy& a, const RecoveryPolicy& b) {
+  for (int i = 0; i < RECOVERY_MAX_STEPS; i++) {
+    if (a.steps[i].action != b.steps[i].action || a.steps[i].after_ms != b.steps[i].after_ms) return false;
+  }
+  return a.cooldown_ms == b.cooldown_ms && a.max_attempts == b.max_attempts;
+}
+
+const char* const RECOVERY_STEP_NAMES[] = { "none", "reset", "power", "force_off", "power_on" };
+
+const char* recoveryStepName(uint8_t action) {
+  return action <= STEP_POWER_ON ? RECOVERY_STEP_NAMES[action] : "none";
+}
+
+// Devuelve STEP_NONE si el nombre no es un paso valido
+uint8_t recoveryStepFromName(const char* name, size_t length) {
+  for (uint8_t i = STEP_RESET; i <= STEP_POWER_ON; i++) {
+    if (strlen(RECOVERY_STEP_NAMES[i]) == length && strncmp(RECOVERY_STEP_NAMES[i], name, length) == 0) return i;
+  }
+  return STEP_NONE;
+}
+
+// Formato del formulario web: "reset:120,force_off:240,power_on:260" (segundos
+// sin respuesta). Si el texto no es valido p queda sin cambios.
+bool parseRecoverySteps(const char* text, RecoveryPolicy& p) {
+  RecoveryStep steps[RECOVERY_MAX_STEPS] = {};
+  int count = 0;
+  const char* cur = text;
+
+  while (*cur != '\0') {
+    while (*cur == ' ' || *cur == ',') cur++;
+    if (*cur == '\0') break;
+    if (count >= RECOVERY_MAX_STEPS) return false;
+
+    const char* colon = strchr(cur, ':');
+    if (colon == nullptr) return false;
+    uint8_t action = recoveryStepFromName(cur, colon - cur);
+    if (action == STEP_NONE) return false;
+
+    char* end;
+    long seconds = strtol(colon + 1, &end, 10);
+    if (end == colon + 1 || seconds <= 0 || seconds > 86400) return false;
+    steps[count++] = { action, (uint32_t)seconds * 1000 };
+    cur = end;
+    while (*cur == ' ') cur++;
+    if (*cur != ',' && *cur != '\0') return false;
+  }
+  if (count == 0) return false;
+
+  memcpy(p.steps, steps, sizeof(steps));
+  return true;
+}
+
+void setDefaultConfig(Config& cfg) {
+  memset(&cfg, 0, sizeof(cfg));
+  strcpy(cfg.hostname, "atx-watchdog");
+  strcpy(cfg.mqtt_server, "");
+  cfg.mqtt_port = 1883;
+  strcpy(cfg.mqtt_user, "");
+  strcpy(cfg.mqtt_pass, "");
+  strcpy(cfg.client_id, "watchdog-001");
+  cfg.power_click_ms = 200;
+  cfg.reset_click_ms = 200;
+  cfg.watchdog_enabled = false;
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    setDefaultTarget(cfg.targets[i]);
+  }
+  strcpy(cfg.static_ip, "");
+  strcpy(cfg.static_gateway, "");
+  strcpy(cfg.static_mask, "");
+  strcpy(cfg.static_dns, "");
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    setDefaultRecovery(cfg.recovery[i]);
+    setDefaultProbeSettings(cfg.probes[i]);
+    setDefaultSchedule(cfg.schedules[i]);
+  }
+  cfg.power_led_mode = POWER_LED_NONE;
+  cfg.heartbeat_port = 4210;
+  strcpy(cfg.heartbeat_key, "");
+  strcpy(cfg.mqtt_groups, "");
+  strcpy(cfg.ota_key, "");
+  cfg.power_save_mode = POWER_SAVE_OFF;
+}
+
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t length) {
+  crc = ~crc;
+  while (length--) {
+    crc ^= *data++;
+    for (int k = 0; k < 8; k++) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+uint32_t configRecordCrc(const ConfigHeader& header, const Config& cfg) {
+  ConfigHeader h = header;
+  h.crc = 0;
+  uint32_t crc = crc32Update(0, (const uint8_t*)&h, sizeof(h));
+  return crc32Update(crc, (const uint8_t*)&cfg, header.size);
+}
+
+// Copia un string del JSON solo si esta presente
+void copyJsonString(JsonVariantConst value, char* dest, size_t size) {
+  const char* str = value.as<const char*>();
+  if (str != nullptr) strlcpy(dest, str, size);
+}
+
+// Escalera de un objetivo: {"steps":[{"action":"reset","after_ms":120000},...],
+// "cooldown_ms":600000,"max_attempts":3}. Si vienen steps, reemplazan a todos.
+void recoveryFromJson(JsonVariantConst doc, RecoveryPolicy& p) {
+  if (!doc.is<JsonObjectConst>()) return;
+
+  JsonArrayConst steps = doc["steps"];
+  if (!steps.isNull()) {
+    memset(p.steps, 0, sizeof(p.steps));
+    int n = 0;
+    for (JsonObjectConst step : steps) {
+      if (n >= RECOVERY_MAX_STEPS) break;
+      const char* name = step["action"] | "";
+      p.steps[n].action = recoveryStepFromName(name, strlen(name));
+      p.steps[n].after_ms = step["after_ms"] | 0UL;
+      n++;
+    }
+  }
+  p.cooldown_ms = doc["cooldown_ms"] | (unsigned long)p.cooldown_ms;
+  p.max_attempts = doc["max_attempts"] | (int)p.max_attempts;
+  sanitizeRecovery(p);
+}
+
+// Sonda de un objetivo: {"type":"http","match":"/health","http_status":200,"degraded_pct":200}
+void probeSettingsFromJson(JsonVariantConst doc, ProbeSettings& p) {
+  if (!doc.is<JsonObjectConst>()) return;
+  const char* type = doc["type"] | (const char*)nullptr;
+  if (type != nullptr) p.type = probeTypeFromName(type);
+  copyJsonString(doc["match"], p.match, sizeof(p.match));
+  p.http_status = doc["http_status"] | (int)p.http_status;
+  p.degraded_pct = doc["degraded_pct"] | (int)p.degraded_pct;
+  sanitizeProbeSettings(p);
+}
+
+// Compara los hashes: el tiempo no depende de cuantos caracteres coinciden
+bool secretMatches(const char* key, const char* candidate) {
+  uint8_t a[SHA256_DIGEST_SIZE];
+  uint8_t b[SHA256_DIGEST_SIZE];
+  Sha256 ctx;
+  sha256Init(ctx);
+  sha256Update(ctx, (const uint8_t*)key, strlen(key));
+  sha256Final(ctx, a);
+  sha256Init(ctx);
+  sha256Update(ctx, (const uint8_t*)candidate, strlen(candidate));
+  sha256Final(ctx, b);
+  return constantTimeEquals(a, b, sizeof(a));
+}
+
+SecretUpdate updateSecretKey(char* key, size_t size, const char* new_key, bool clear, const char* current) {
+  if (!clear && (new_key == nullptr || new_key[0] == '\0')) return SECRET_UNCHANGED;
+  if (key[0] != '\0' && (current == nullptr || !secretMatches(key, current))) return SECRET_DENIED;
+  strlcpy(key, clear ? "" : new_key, size);
+  return SECRET_UPDATED;
+}
+
+SecretUpdate secretKeyFromJson(JsonVariantConst doc, const char* name, char* key, size_t size) {
+  const char* value = doc[name].as<const char*>();
+  if (value == nullptr) return SECRET_UNCHANGED;
+  char currentName[32];
+  snprintf(currentName, sizeof(currentName), "%s_current", name);
+  return updateSecretKey(key, size, value, value[0] == '\0', doc[currentName].as<const char*>());
+}
+
+// Aplica un documento JSON sobre cfg. Los campos ausentes conservan el
+// valor que ya tenia cfg. Acepta tambien el formato anterior (un solo host).
+// Las claves HMAC van aparte, con secretKeyFromJson().
+bool configFromJson(JsonVariantConst doc, Config& cfg) {
+  if (!doc.is<JsonObjectConst>()) return false;
+
+  copyJsonString(doc["hostname"], cfg.hostname, sizeof(cfg.hostname));
+  copyJsonString(doc["mqtt_server"], cfg.mqtt_server, sizeof(cfg.mqtt_server));
+  cfg.mqtt_port = doc["mqtt_port"] | cfg.mqtt_port;
+  copyJsonString(doc["mqtt_user"], cfg.mqtt_user, sizeof(cfg.mqtt_user));
+  copyJsonString(doc["mqtt_pass"], cfg.mqtt_pass, sizeof(cfg.mqtt_pass));
+  copyJsonString(doc["client_id"], cfg.client_id, sizeof(cfg.client_id));
+  copyJsonString(doc["mqtt_groups"], cfg.mqtt_groups, sizeof(cfg.mqtt_groups));
+  cfg.power_click_ms = doc["power_click_ms"] | cfg.power_click_ms;
+  cfg.reset_click_ms = doc["reset_click_ms"] | cfg.reset_click_ms;
+  cfg.watchdog_enabled = doc["watchdog_enabled"] | cfg.watchdog_enabled;
+  copyJsonString(doc["static_ip"], cfg.static_ip, sizeof(cfg.static_ip));
+  copyJsonString(doc["static_gateway"], cfg.static_gateway, sizeof(cfg.static_gateway));
+  copyJsonString(doc["static_mask"], cfg.static_mask, sizeof(cfg.static_mask));
+  copyJsonString(doc["static_dns"], cfg.static_dns, sizeof(cfg.static_dns));
+  cfg.power_led_mode = doc["power_led_mode"] | (int)cfg.power_led_mode;
+  if (cfg.power_led_mode > POWER_LED_ACTIVE_HIGH) cfg.power_led_mode = POWER_LED_NONE;
+  cfg.heartbeat_port = doc["heartbeat_port"] | cfg.heartbeat_port;
+  cfg.power_save_mode = doc["power_save_mode"] | (int)cfg.power_save_mode;
+  if (cfg.power_save_mode > POWER_SAVE_LIGHT) cfg.power_save_mode = POWER_SAVE_OFF;
+
+  JsonArrayConst targets = doc["targets"];
+  if (targets.isNull()) {
+    // Formato anterior: un solo host en la raiz del JSON
+    if (!doc["watchdog_host"].isNull()) {
+      WatchdogTarget& t = cfg.targets[0];
+      copyJsonString(doc["watchdog_host"], t.host, sizeof(t.host));
+      t.port = doc["watchdog_port"] | 22;
+      t.check_interval_ms = doc["watchdog_check_interval_ms"] | 30000;
+      t.timeout_ms = doc["watchdog_timeout_ms"] | 120000;
+      t.action = ACTION_POWER;
+      sanitizeTarget(t);
+      sanitizeSchedule(cfg.schedules[0], t);
+    }
+  } else {
+    int i = 0;
+    for (JsonObjectConst obj : targets) {
+      if (i >= MAX_WATCHDOG_TARGETS) break;
+      WatchdogTarget& t = cfg.targets[i];
+      copyJsonString(obj["host"], t.host, sizeof(t.host));
+      t.port = obj["port"] | t.port;
+      t.check_interval_ms = obj["interval_ms"] | t.check_interval_ms;
+      t.timeout_ms = obj["timeout_ms"] | t.timeout_ms;
+      t.action = obj["action"] | (int)t.action;
+      sanitizeTarget(t);
+      recoveryFromJson(obj["recovery"], cfg.recovery[i]);
+      probeSettingsFromJson(obj["probe"], cfg.probes[i]);
+      ProbeSchedule& s = cfg.schedules[i];
+      s.min_interval_ms = obj["min_interval_ms"] | (unsigned long)s.min_interval_ms;
+      s.max_interval_ms = obj["max_interval_ms"] | (unsigned long)s.max_interval_ms;
+      sanitizeSchedule(s, t);
+      i++;
+    }
+  }
+
+  return true;
+}
+
+bool targetEquals(const WatchdogTarget& a, const WatchdogTarget& b) {
+  return strcmp(a.host, b.host) == 0 &&
+         a.port == b.port &&
+         a.check_interval_ms == b.check_interval_ms &&
+         a.timeout_ms == b.timeout_ms &&
+         a.action == b.action;
+}
+
+bool targetConfigEquals(const Config& a, const Config& b, int index) {
+  const ProbeSettings& pa = a.probes[index];
+  const ProbeSettings& pb = b.probes[index];
+  return targetEquals(a.targets[index], b.targets[index]) &&
+         recoveryEquals(a.recovery[index], b.recovery[index]) &&
+         pa.type == pb.type && strcmp(pa.match, pb.match) == 0 &&
+         pa.http_status == pb.http_status && pa.degraded_pct == pb.degraded_pct &&
+         a.schedules[index].min_interval_ms == b.schedules[index].min_interval_ms &&
+         a.schedules[index].max_interval_ms == b.schedules[index].max_interval_ms;
+}
+
+// Compara campo por campo y devuelve una mascara de ConfigChange
+uint8_t diffConfig(const Config& previous, const Config& current) {
+  uint8_t changes = CHANGE_NONE;
+
+  if (strcmp(previous.hostname, current.hostname) != 0) changes |= CHANGE_HOSTNAME;
+
+  // Cambiar la IP corta la conexion actual: se aplica reiniciando
+  if (strcmp(previous.static_ip, current.static_ip) != 0 ||
+      strcmp(previous.static_gateway, current.static_gateway) != 0 ||
+      strcmp(previous.static_mask, current.static_mask) != 0 ||
+      strcmp(previous.static_dns, current.static_dns) != 0) {
+    changes |= CHANGE_RESTART;
+  }
+
+  if (strcmp(previous.mqtt_server, current.mqtt_server) != 0 ||
+      previous.mqtt_port != current.mqtt_port ||
+      strcmp(previous.mqtt_user, current.mqtt_user) != 0 ||
+      strcmp(previous.mqtt_pass, current.mqtt_pass) != 0 ||
+      strcmp(previous.client_id, current.client_id) != 0 ||
+      strcmp(previous.mqtt_groups, current.mqtt_groups) != 0) {
+    changes |= CHANGE_MQTT;
+  }
+
+  if (previous.power_click_ms != current.power_click_ms ||
+      previous.reset_click_ms != current.reset_click_ms) {
+    changes |= CHANGE_BUTTONS;
+  }
+
+  if (previous.watchdog_enabled != current.watchdog_enabled ||
+      previous.power_led_mode != current.power_led_mode) {
+    changes |= CHANGE_WATCHDOG;
+  }
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    if (!targetConfigEquals(previous, current, i)) changes |= CHANGE_WATCHDOG;
+  }
+
+  if (previous.heartbeat_port != current.heartbeat_port ||
+      strcmp(previous.heartbeat_key, current.heartbeat_key) != 0) {
+    changes |= CHANGE_HEARTBEAT;
+  }
+
+  if (strcmp(previous.ota_key, current.ota_key) != 0) {
+    changes |= CHANGE_OTA;
+  }
+
+  if (previous.power_save_mode != current.power_save_mode) {
+    changes |= CHANGE_POWER_SAVE;
+  }
+
+  return changes;
+}
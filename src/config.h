@@ -0,0 +1,181 @@
+#pragma once
+
+// Estructura de configuracion y funciones puras sobre ella (valores por
+// defecto, validacion, CRC del registro binario, JSON y diff). La lectura y
+// escritura en LittleFS queda en main.cpp.
+
+#include <ArduinoJson.h>
+#include "hal.h"
+
+// Tabla de objetivos del watchdog
+#define MAX_WATCHDOG_TARGETS 8
+#define WATCHDOG_MIN_INTERVAL_MS 1000
+
+// Registro binario de configuracion
+#define CONFIG_MAGIC 0x57585441UL          // "ATXW"
+#define CONFIG_SCHEMA_VERSION 9
+
+// Escalado de recuperacion
+#define RECOVERY_MAX_STEPS 4
+#define RECOVERY_MIN_STEP_GAP_MS 10000  // Entre pasos (cubre el pulso de apagado forzado)
+#define RECOVERY_MAX_ATTEMPTS 10
+
+// Accion a ejecutar cuando un objetivo supera su timeout. ACTION_ESCALATE
+// ignora timeout_ms y recorre la escalera de recovery[] del objetivo.
+enum WatchdogAction { ACTION_POWER = 0, ACTION_RESET = 1, ACTION_ALERT = 2, ACTION_ESCALATE = 3 };
+
+// Paso de la escalera de recuperacion
+enum RecoveryStepAction {
+  STEP_NONE      = 0,  // Fin de la escalera
+  STEP_RESET     = 1,  // Pulso en RESET
+  STEP_POWER     = 2,  // Click corto en POWER
+  STEP_FORCE_OFF = 3,  // Pulsacion larga en POWER (se saltea si el LED dice apagado)
+  STEP_POWER_ON  = 4,  // Click corto en POWER (se saltea si el LED dice encendido)
+};
+
+// Sensado opcional del LED de power de la motherboard
+enum PowerLedMode { POWER_LED_NONE = 0, POWER_LED_ACTIVE_LOW = 1, POWER_LED_ACTIVE_HIGH = 2 };
+
+// Ahorro de energia entre sondas (ver powersave.h)
+enum PowerSaveMode { POWER_SAVE_OFF = 0, POWER_SAVE_MODEM = 1, POWER_SAVE_LIGHT = 2 };
+
+// Objetivo monitoreado por el watchdog (host vacio = entrada libre)
+struct WatchdogTarget {
+  char host[64];
+  int port;
+  int check_interval_ms;
+  int timeout_ms;
+  uint8_t action;
+};
+
+// Cada paso se ejecuta after_ms despues del inicio de su escalera. La primera
+// escalera arranca con la ultima sonda exitosa; las siguientes, al terminar
+// el cooldown (ladder_start).
+struct RecoveryStep {
+  uint8_t action;
+  uint32_t after_ms;
+};
+
+struct RecoveryPolicy {
+  RecoveryStep steps[RECOVERY_MAX_STEPS];
+  uint32_t cooldown_ms;    // Espera tras completar la escalera sin exito
+  uint8_t max_attempts;    // Escaleras completas antes de rendirse
+};
+
+// Sonda de aplicacion de un objetivo (ver ProbeType en hal.h). Con
+// degraded_pct = 200 el objetivo se marca degradado cuando su RTT promedio
+// supera el doble de su linea de base (0 = sin deteccion).
+#define DEGRADED_PCT_MIN 110
+#define DEGRADED_PCT_MAX 1000
+
+struct ProbeSettings {
+  uint8_t type;
+  char match[PROBE_MATCH_SIZE];  // Banner, path HTTP o payload UDP
+  uint16_t http_status;          // 0 = cualquier status menor a 400
+  uint16_t degraded_pct;
+};
+
+// Limites del intervalo adaptativo de un objetivo: tras una sonda fallida se
+// confirma cada min_interval_ms; con el objetivo sano el intervalo crece desde
+// check_interval_ms hasta max_interval_ms. min = max = check_interval_ms
+// equivale a un intervalo fijo.
+#define PROBE_MAX_INTERVAL_MS 3600000UL
+
+struct ProbeSchedule {
+  uint32_t min_interval_ms;
+  uint32_t max_interval_ms;
+};
+
+// Grupos de campos modificados al guardar configuracion (ver diffConfig)
+enum ConfigChange {
+  CHANGE_NONE     = 0,
+  CHANGE_BUTTONS  = 1 << 0,  // Duraciones de click: se leen en vivo
+  CHANGE_WATCHDOG = 1 << 1,  // Objetivos / habilitacion del watchdog
+  CHANGE_MQTT     = 1 << 2,  // Broker, credenciales, client_id o grupos
+  CHANGE_HOSTNAME = 1 << 3,  // Hostname WiFi
+  CHANGE_RESTART  = 1 << 4,  // Requiere reinicio completo
+  CHANGE_HEARTBEAT = 1 << 5, // Puerto o clave de los latidos UDP
+  CHANGE_OTA      = 1 << 6,  // Clave OTA: se lee en vivo
+  CHANGE_POWER_SAVE = 1 << 7, // Modo de ahorro de energia
+};
+
+// Estructura de configuracion. Se persiste tal cual en binario: los campos
+// nuevos se agregan SIEMPRE al final (incrementando CONFIG_SCHEMA_VERSION)
+// para que un registro mas corto de una version anterior se pueda leer
+// sobre los valores por defecto.
+struct Config {
+  char hostname[32];
+  char mqtt_server[64];
+  int mqtt_port;
+  char mqtt_user[32];
+  char mqtt_pass[32];
+  char client_id[32];
+  int power_click_ms;
+  int reset_click_ms;
+  bool watchdog_enabled;
+  WatchdogTarget targets[MAX_WATCHDOG_TARGETS];
+  // v2: IP fija opcional (static_ip vacio = DHCP)
+  char static_ip[16];
+  char static_gateway[16];
+  char static_mask[16];
+  char static_dns[16];
+  // v3: escalera de recuperacion por objetivo y LED de power
+  RecoveryPolicy recovery[MAX_WATCHDOG_TARGETS];
+  uint8_t power_led_mode;
+  // v4: sonda de aplicacion por objetivo
+  ProbeSettings probes[MAX_WATCHDOG_TARGETS];
+  // v5: limites del intervalo adaptativo por objetivo
+  ProbeSchedule schedules[MAX_WATCHDOG_TARGETS];
+  // v6: receptor de latidos UDP (sin clave queda deshabilitado)
+  uint16_t heartbeat_port;
+  char heartbeat_key[65];
+  // v7: grupos MQTT separados por coma ("rack1,gpu"), ver commands.h
+  char mqtt_groups[64];
+  // v8: clave de los pedidos de actualizacion OTA (vacia = deshabilitado)
+  char ota_key[65];
+  // v9: ahorro de energia entre sondas (PowerSaveMode)
+  uint8_t power_save_mode;
+};
+
+// Claves HMAC de solo escritura: /api/config solo informa si hay una
+// configurada. Para cambiar o borrar una clave ya configurada hay que
+// presentar la actual; la primera se fija sin ella.
+enum SecretUpdate { SECRET_UNCHANGED, SECRET_UPDATED, SECRET_DENIED };
+
+// Cabecera del registro binario de configuracion
+struct ConfigHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;      // Bytes de Config que siguen a la cabecera
+  uint32_t sequence;  // Mayor = mas reciente (elige entre A y B)
+  uint32_t crc;       // CRC32 de cabecera (con crc=0) + payload
+};
+
+extern Config config;
+
+void setDefaultTarget(WatchdogTarget& t);
+void sanitizeTarget(WatchdogTarget& t);
+const char* watchdogActionName(uint8_t action);
+void setDefaultRecovery(RecoveryPolicy& p);
+void sanitizeRecovery(RecoveryPolicy& p);
+bool recoveryEquals(const RecoveryPolicy& a, const RecoveryPolicy& b);
+const char* recoveryStepName(uint8_t action);
+uint8_t recoveryStepFromName(const char* name, size_t length);
+bool parseRecoverySteps(const char* text, RecoveryPolicy& p);
+void setDefaultProbeSettings(ProbeSettings& p);
+void sanitizeProbeSettings(ProbeSettings& p);
+void setDefaultSchedule(ProbeSchedule& s);
+void sanitizeSchedule(ProbeSchedule& s, const WatchdogTarget& t);
+void setDefaultConfig(Config& cfg);
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t length);
+uint32_t configRecordCrc(const ConfigHeader& header, const Config& cfg);
+bool configFromJson(JsonVariantConst doc, Config& cfg);
+// new_key vacio y sin clear: sin cambios. current se compara con la clave
+// vigente en tiempo constante.
+SecretUpdate updateSecretKey(char* key, size_t size, const char* new_key, bool clear, const char* current);
+// doc[name] (string; "" = borrar) con la clave vigente en doc["<name>_current"]
+SecretUpdate secretKeyFromJson(JsonVariantConst doc, const char* name, char* key, size_t size);
+bool targetEquals(const WatchdogTarget& a, const WatchdogTarget& b);
+// Objetivo, escalera y sonda del indice dado
+bool targetConfigEquals(const Config& a, const Config& b, int index);
+uint8_t diffConfig(const Config& previous, const Config& current);
@@ -0,0 +1,108 @@
+#include "events.h"
+#include <stdarg.h>
+#include <string.h>
+#include "config.h"
+#include "metrics.h"
+
+// Cola circular de payloads ya armados (sin heap)
+char eventQueue[EVENT_QUEUE_SIZE][EVENT_PAYLOAD_SIZE];
+int eventQueueHead = 0;
+int eventQueueCount = 0;
+
+const char* eventTopic() {
+  static char topic[64];
+  snprintf(topic, sizeof(topic), "/watchdog/%s/events", config.client_id);
+  return topic;
+}
+
+// Arma el payload en buffer. false si no entra.
+bool formatEvent(char* payload, size_t size, const char* name, const char* fields_format, va_list args) {
+  int n = snprintf(payload, size, "{\"event\":\"%s\"", name);
+  if (fields_format != nullptr && n < (int)size) {
+    payload[n++] = ',';
+    n += vsnprintf(payload + n, size - n, fields_format, args);
+  }
+  if (n >= (int)size - 24) {
+    halLog("Evento %s descartado: payload demasiado largo\n", name);
+    return false;
+  }
+  snprintf(payload + n, size - n, ",\"ts\":%lu}", halMillis());
+  return true;
+}
+
+void publishEvent(const char* name, const char* fields_format, ...) {
+  bool mqtt = halMqttConnected();
+  if (!mqtt && halSseClientCount() == 0) return;
+
+  static char payload[EVENT_PAYLOAD_SIZE];
+  va_list args;
+  va_start(args, fields_format);
+  bool ok = formatEvent(payload, sizeof(payload), name, fields_format, args);
+  va_end(args);
+  if (!ok) return;
+  if (mqtt) halMqttPublish(eventTopic(), payload, false);
+  halSseSend("event", payload);
+}
+
+void publishQueuedEvent(const char* name, const char* fields_format, ...) {
+  // Con sesion pero con cola pendiente tambien se encola: se respeta el orden
+  bool direct = halMqttConnected() && eventQueueCount == 0;
+
+  // Se arma primero: un payload invalido no debe desalojar a uno encolado
+  static char payload[EVENT_PAYLOAD_SIZE];
+  va_list args;
+  va_start(args, fields_format);
+  bool ok = formatEvent(payload, sizeof(payload), name, fields_format, args);
+  va_end(args);
+  if (!ok) return;
+
+  // El panel en vivo lo ve en el momento, aunque MQTT lo reciba despues
+  halSseSend("event", payload);
+  if (direct) {
+    halMqttPublish(eventTopic(), payload, false);
+    return;
+  }
+
+  if (eventQueueCount == EVENT_QUEUE_SIZE) {
+    eventQueueHead = (eventQueueHead + 1) % EVENT_QUEUE_SIZE;
+    eventQueueCount--;
+    actionCounters.events_dropped++;
+  }
+  memcpy(eventQueue[(eventQueueHead + eventQueueCount) % EVENT_QUEUE_SIZE], payload, strlen(payload) + 1);
+  eventQueueCount++;
+  if (halMqttConnected()) flushEventQueue();
+}
+
+int flushEventQueue() {
+  int sent = 0;
+  while (eventQueueCount > 0 && halMqttConnected()) {
+    // Si el publish falla (sesion cortada a mitad) el evento queda para la proxima
+    if (!halMqttPublish(eventTopic(), eventQueue[eventQueueHead], false)) break;
+    eventQueueHead = (eventQueueHead + 1) % EVENT_QUEUE_SIZE;
+    eventQueueCount--;
+    sent++;
+  }
+  return sent;
+}
+
+int eventQueueLength() {
+  return eventQueueCount;
+}
+
+void publishLiveUpdate(const char* name, const char* fields_format, ...) {
+  if (halSseClientCount() == 0) return;
+
+  static char payload[EVENT_PAYLOAD_SIZE];
+  va_list args;
+  va_start(args, fields_format);
+  payload[0] = '{';
+  int n = 1 + vsnprintf(payload + 1, sizeof(payload) - 2, fields_format, args);
+  va_end(args);
+  if (n >= (int)sizeof(payload) - 1) {
+    halLog("Actualizacion %s descartada: payload demasiado largo\n", name);
+    return;
+  }
+  payload[n++] = '}';
+  payload[n] = '\0';
+  halSseSend(name, payload);
+}
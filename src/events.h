@@ -0,0 +1,35 @@
+#pragma once
+
+// Eventos de cambio de estado publicados por MQTT en
+// /watchdog/{client_id}/events apenas ocurren (sin esperar al heartbeat).
+//
+// Los eventos importantes (acciones del watchdog, botones) que ocurren sin
+// sesion MQTT se guardan en una cola acotada y se publican en orden al
+// reconectar; si la cola se llena se descarta el mas viejo. "ts" conserva
+// el momento en que ocurrieron.
+//
+// Todos los eventos se reenvian ademas a los navegadores conectados al
+// stream SSE (evento "event"), junto con actualizaciones que solo sirven
+// para el panel en vivo (publishLiveUpdate).
+
+#include "hal.h"
+
+#define EVENT_PAYLOAD_SIZE 256
+#define EVENT_QUEUE_SIZE 8
+
+// Publica {"event":"<name>",<campos>,"ts":<ms>}. fields_format arma los
+// campos extra (fragmento JSON sin llaves) o es nullptr si no hay. Sin
+// sesion MQTT el evento se pierde (salvo para los clientes SSE).
+void publishEvent(const char* name, const char* fields_format, ...)
+  __attribute__((format(printf, 2, 3)));
+// Igual que publishEvent, pero sin sesion MQTT el evento queda en cola
+void publishQueuedEvent(const char* name, const char* fields_format, ...)
+  __attribute__((format(printf, 2, 3)));
+// Publica la cola en orden. Llamar apenas se establece la sesion MQTT.
+// Devuelve la cantidad de eventos publicados.
+int flushEventQueue();
+int eventQueueLength();
+// Manda {<campos>} solo por SSE como evento <name>. No hace nada si no hay
+// navegadores conectados.
+void publishLiveUpdate(const char* name, const char* fields_format, ...)
+  __attribute__((format(printf, 2, 3)));
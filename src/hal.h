@@ -0,0 +1,220 @@
+#pragma once
+
+// Capa de abstraccion de hardware. La logica del watchdog (pulsos, botones,
+// sondas, comandos) solo usa estas funciones, asi se puede compilar tanto
+// para el ESP8266 (hal_esp8266.cpp) como nativo en Linux con implementaciones
+// falsas y tiempo simulado (hal_native.cpp, [env:native]).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+// Numeracion de pines NodeMCU para el build nativo
+#define D1 5
+#define D2 4
+#define D5 14
+#define D6 12
+#define D7 13
+
+#define IRAM_ATTR
+
+#if defined(__GLIBC__)
+#if !__GLIBC_PREREQ(2, 38)
+#define HAL_NEEDS_STRLCPY
+size_t strlcpy(char* dest, const char* src, size_t size);
+#endif
+#endif
+
+// Salida de texto con la misma interfaz que Print de Arduino, para que las
+// respuestas de la API (render.h) se puedan armar y medir en el build nativo
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* data, size_t size);
+  size_t print(const char* str);
+  size_t print(char c);
+  size_t print(unsigned char value);
+  size_t print(int value);
+  size_t print(unsigned int value);
+  size_t print(long value);
+  size_t print(unsigned long value);
+  size_t print(long long value);
+  size_t print(unsigned long long value);
+  size_t print(double value, int digits = 2);
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+#endif
+
+// Reloj. halMillis() y halDigitalRead() se pueden llamar desde una ISR.
+unsigned long halMillis();
+unsigned long halMicros();
+long halRandom(long max);  // [0, max)
+
+// GPIO
+void halDigitalWrite(uint8_t pin, bool high);
+bool halDigitalRead(uint8_t pin);
+// Llama a isr en cada flanco (subida y bajada) del pin
+void halAttachChangeInterrupt(uint8_t pin, void (*isr)());
+
+// Ahorro de energia (powersave.h). halIdle espera hasta ms sin ocupar el
+// CPU, o hasta que una ISR llame a halIdleWake() o termine una sonda (DNS,
+// connect, respuesta o error). Con light = true el CPU se suspende y las
+// entradas con interrupcion de flanco lo despiertan por nivel.
+void halSetLightSleep(bool enabled);
+void halIdle(unsigned long ms, bool light);
+void halIdleWake();
+
+// Log por consola (formato printf)
+void halLog(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+// Sondas no bloqueantes. Cada slot mantiene su propia conexion en curso
+// y su cache DNS. Un slot por objetivo mas los del servidor OTA (ota.h) y
+// del broker MQTT (mqtt_link.h).
+#define HAL_PROBE_SLOTS 10
+#define PROBE_MATCH_SIZE 40
+
+// PROBE_MISMATCH: el host respondio pero no lo esperado (banner, status HTTP)
+enum ProbeResult { PROBE_PENDING = 0, PROBE_OK = 1, PROBE_FAILED = -1, PROBE_MISMATCH = -2 };
+
+// Tipo de sonda. Ademas del connect TCP, las sondas de aplicacion verifican
+// que el servicio conteste: banner (ej. "SSH-2.0"), status de un GET HTTP o
+// eco de un datagrama UDP. match es el prefijo del banner, el path HTTP o el
+// payload UDP segun el tipo. PROBE_HEARTBEAT no sale a la red: el objetivo
+// manda latidos UDP firmados al watchdog (heartbeat.h).
+enum ProbeType { PROBE_TCP = 0, PROBE_BANNER = 1, PROBE_HTTP = 2, PROBE_UDP_ECHO = 3, PROBE_HEARTBEAT = 4 };
+
+struct ProbeRequest {
+  uint8_t type;
+  const char* host;
+  uint16_t port;
+  const char* match;
+  uint16_t http_status;        // Status esperado (0 = cualquiera menor a 400)
+  unsigned long timeout_ms;
+};
+
+void halProbeStart(int slot, const ProbeRequest& request);
+// Devuelve PROBE_PENDING mientras la sonda siga en curso (o no haya ninguna)
+ProbeResult halProbePoll(int slot);
+bool halProbeIdle(int slot);
+void halProbeAbort(int slot);
+unsigned long halProbeRtt(int slot);          // RTT del ultimo connect exitoso
+unsigned long halProbeResponseRtt(int slot);  // Hasta la respuesta de aplicacion
+// La proxima sonda del slot vuelve a resolver el host (sigue usando el IP
+// anterior mientras tanto)
+void halProbeFlushDns(int slot);
+// IP en cache del slot, en el orden de IPAddress/lwIP (0 = sin resolver)
+uint32_t halProbeAddress(int slot);
+
+// Receptor UDP de latidos. port = 0 cierra el socket.
+bool halHeartbeatBegin(uint16_t port);
+// Copia el proximo datagrama pendiente (truncado a size - 1, con '\0').
+// Devuelve su largo o -1 si no hay ninguno.
+int halHeartbeatReceive(char* buffer, size_t size);
+// Ultimo seq aceptado de cada emisor (tamano fijo)
+bool halHeartbeatRecordLoad(void* data, size_t len);
+bool halHeartbeatRecordSave(const void* data, size_t len);
+
+// Almacenamiento del diario de eventos (journal.h): un archivo de tamano
+// fijo con acceso por offset. halJournalOpen lo crea en ceros si no existe o
+// si cambio de tamano.
+bool halJournalOpen(size_t size);
+bool halJournalRead(size_t offset, void* data, size_t len);
+bool halJournalWrite(size_t offset, const void* data, size_t len);
+
+// Estado en vivo por Server-Sent Events (GET /events en un puerto propio).
+// Servidor no bloqueante con hasta HAL_SSE_MAX_CLIENTS conexiones; a un
+// cliente lento se le descartan mensajes en vez de frenar loop().
+#define HAL_SSE_MAX_CLIENTS 4
+bool halSseBegin(uint16_t port);
+void halSsePoll();   // Acepta clientes, lee pedidos y manda keep-alive
+int halSseClientCount();
+// Manda "event: <event>\ndata: <data>\n\n" a todos los clientes
+void halSseSend(const char* event, const char* data);
+
+// Actualizacion de firmware (ota.h). La descarga es una conexion TCP al IP
+// ya resuelto. halFetchOpen lanza el connect sin esperarlo (false si ni
+// siquiera pudo empezar) y el request completo sale al conectar;
+// halFetchPoll devuelve PROBE_PENDING mientras conecta, PROBE_OK una vez
+// enviado el request y PROBE_FAILED si no se pudo. halFetchRead lee la
+// respuesta cruda (status y headers incluidos) sin bloquear: devuelve los
+// bytes leidos, 0 si todavia no llego nada o -1 si la conexion se cerro.
+bool halFetchOpen(uint32_t address, uint16_t port, const char* request);
+ProbeResult halFetchPoll();
+int halFetchRead(uint8_t* buffer, size_t size);
+void halFetchClose();
+// Area de actualizacion: halUpdateEnd(true) deja la imagen lista para que el
+// bootloader la copie en el proximo arranque; false la descarta.
+bool halUpdateBegin(size_t size);
+bool halUpdateWrite(const uint8_t* data, size_t len);
+bool halUpdateEnd(bool commit);
+// Imagen en ejecucion y su copia en el sistema de archivos (rollback).
+// halBackupBegin descarta la copia anterior y falla si no hay lugar.
+size_t halFirmwareSize();
+bool halFirmwareRead(size_t offset, uint8_t* data, size_t len);
+bool halBackupBegin(size_t size);
+bool halBackupWrite(const uint8_t* data, size_t len);
+bool halBackupRead(size_t offset, uint8_t* data, size_t len);
+void halBackupClose();
+// Registro de estado del OTA (tamano fijo)
+bool halOtaRecordLoad(void* data, size_t len);
+bool halOtaRecordSave(const void* data, size_t len);
+
+// Reinicio por software (en el simulador lo aplica simTakeRestart())
+void halRestart();
+
+// Red y memoria, para el estado y las metricas
+uint32_t halLocalIp();          // En el orden de IPAddress/lwIP
+int halWifiRssi();
+uint32_t halFreeHeap();
+uint32_t halMaxFreeBlock();
+uint8_t halHeapFragmentation();
+
+// Servidor web de la pagina y la API (solo ESP8266: en el build nativo las
+// respuestas se arman directo con render.h)
+void halHttpPoll();
+
+// MQTT. halMqttConnect abre la sesion contra el IP ya resuelto por la sonda
+// del broker, con Last Will retenido. Los mensajes de los topics suscriptos
+// llegan a mqttCallback() (app_loop.h) desde halMqttLoop().
+bool halMqttConnect(uint32_t address, uint16_t port, const char* client_id, const char* user,
+                    const char* pass, const char* will_topic, const char* will_payload);
+int halMqttState();             // Codigo de PubSubClient del ultimo intento
+bool halMqttSubscribe(const char* topic);
+void halMqttLoop();
+bool halMqttConnected();
+bool halMqttPublish(const char* topic, const char* payload, bool retained);
+
+#ifndef ARDUINO
+// Controles de la simulacion (solo build nativo)
+void simAdvance(unsigned long ms);
+void simSetPin(uint8_t pin, bool high);
+// true mientras loop() esta en halIdle(): el simulador no lo vuelve a llamar
+bool simIdling();
+void simSetTcpTarget(const char* host, uint16_t port, bool up, unsigned long rtt_ms);
+// Respuesta de aplicacion del objetivo (banner, linea de status HTTP o eco UDP)
+void simSetProbeResponse(const char* host, uint16_t port, const char* response, unsigned long response_ms);
+// Corta la sesion MQTT (como una caida del broker) o la marca conectada
+void simSetMqttConnected(bool connected);
+// Publica en el broker simulado: si el topic esta suscripto lo entrega a
+// mqttCallback() y devuelve true
+bool simMqttDeliver(const char* topic, const char* payload);
+// Ultimo payload publicado por el watchdog en topic ("" = ninguno)
+const char* simLastPublish(const char* topic);
+void simSendHeartbeat(const char* datagram);
+void simSetSseClients(int count);  // Navegadores conectados a /events
+unsigned long simJournalWriteCount();  // Escrituras a la "flash" del diario
+unsigned long simHeartbeatRecordWriteCount();
+// Archivo que sirve el servidor HTTP simulado a halFetch (nullptr = 404)
+void simSetHttpFile(const uint8_t* data, size_t len, unsigned long bytes_per_ms);
+// true (una sola vez) si se pidio un reinicio. Aplica la imagen pendiente
+// como haria el bootloader.
+bool simTakeRestart();
+// Imagen "en ejecucion" de la simulacion
+void simFirmwareDigest(uint8_t digest[32]);
+#endif
@@ -0,0 +1,867 @@
+// Implementacion de la HAL sobre el core Arduino del ESP8266
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <ESP8266WebServer.h>
+#include <LittleFS.h>
+#include <PubSubClient.h>
+#include <Updater.h>
+#include <WiFiUdp.h>
+#include <lwip/tcp.h>
+#include <lwip/dns.h>
+#include <lwip/udp.h>
+#include <coredecls.h>
+#include "hal.h"
+#include "probes.h"
+
+#define DNS_CACHE_TTL_MS 300000UL      // 5 minutos antes de re-resolver
+#define JOURNAL_FILE "/journal.bin"
+#define SSE_REQUEST_TIMEOUT_MS 3000    // Para mandar el pedido HTTP completo
+#define SSE_PING_INTERVAL_MS 15000     // Comentario keep-alive (proxies, NAT)
+#define SSE_MAX_DROPS 20               // Mensajes perdidos seguidos antes de cortar
+#define SSE_MESSAGE_SIZE 384
+#define OTA_BACKUP_FILE "/fw_prev.bin"
+#define OTA_RECORD_FILE "/ota.bin"
+#define HEARTBEAT_RECORD_FILE "/heartbeat.bin"
+#define FETCH_REQUEST_SIZE 320         // Request HTTP de la descarga OTA
+#define OTA_FS_MARGIN 16384            // Lugar libre que se deja en LittleFS
+#define HAL_WAKE_PINS 4                // Entradas con interrupcion de flanco
+
+extern PubSubClient mqttClient;
+extern ESP8266WebServer server;
+
+WiFiUDP heartbeatUdp;
+bool heartbeatListening = false;
+File journalFile;
+File otaBackupFile;
+bool otaBackupWriting = false;
+
+// Clientes SSE. El pedido se lee de a poco en cada halSsePoll(); solo se
+// guarda el comienzo de la linea de pedido y los ultimos 4 bytes para
+// detectar el fin de los headers.
+enum SseState { SSE_FREE, SSE_REQUEST, SSE_STREAMING };
+struct SseClient {
+  WiFiClient client;
+  SseState state;
+  unsigned long since;
+  char head[12];
+  uint8_t head_len;
+  uint32_t tail;
+  uint8_t drops;
+};
+WiFiServer* sseServer = nullptr;
+SseClient sseClients[HAL_SSE_MAX_CLIENTS];
+unsigned long sseLastPing = 0;
+
+// Entradas con interrupcion de flanco (botones). En light sleep el CPU
+// suspendido no ve flancos: durante la espera pasan a nivel bajo con
+// despertar (ONLOW_WE) y al volver se restituye su ISR.
+struct WakePin {
+  uint8_t pin;
+  void (*isr)();
+};
+WakePin wakePins[HAL_WAKE_PINS];
+int wakePinCount = 0;
+volatile bool idleWakeRequested = false;
+
+unsigned long IRAM_ATTR halMillis() {
+  return millis();
+}
+
+unsigned long halMicros() {
+  return micros();
+}
+
+long halRandom(long max) {
+  return random(max);
+}
+
+void halDigitalWrite(uint8_t pin, bool high) {
+  digitalWrite(pin, high ? HIGH : LOW);
+}
+
+bool IRAM_ATTR halDigitalRead(uint8_t pin) {
+  return digitalRead(pin) == HIGH;
+}
+
+void halAttachChangeInterrupt(uint8_t pin, void (*isr)()) {
+  attachInterrupt(digitalPinToInterrupt(pin), isr, CHANGE);
+  if (wakePinCount < HAL_WAKE_PINS) wakePins[wakePinCount++] = { pin, isr };
+}
+
+void halSetLightSleep(bool enabled) {
+  // Modem sleep es el modo por defecto del SDK
+  WiFi.setSleepMode(enabled ? WIFI_LIGHT_SLEEP : WIFI_MODEM_SLEEP);
+}
+
+void IRAM_ATTR halIdleWake() {
+  idleWakeRequested = true;
+  esp_schedule();  // Corta el esp_delay() de halIdle
+}
+
+// Boton presionado durante light sleep. Un nivel sostenido volveria a
+// disparar sin parar: el pin vuelve a flancos en el acto y el flanco se
+// encola con la ISR original (que tambien corta la espera).
+void IRAM_ATTR lightSleepWakeIsr(void* arg) {
+  WakePin* w = (WakePin*)arg;
+  GPC(w->pin) = (GPC(w->pin) & ~(0xF << GPCI)) | (CHANGE << GPCI);
+  w->isr();
+}
+
+void halIdle(unsigned long ms, bool light) {
+  idleWakeRequested = false;
+  if (light) {
+    // Un pin que ya esta bajo despertaria en el acto: queda con su flanco
+    for (int i = 0; i < wakePinCount; i++) {
+      if (digitalRead(wakePins[i].pin) == HIGH) {
+        attachInterruptArg(digitalPinToInterrupt(wakePins[i].pin), lightSleepWakeIsr, &wakePins[i], ONLOW_WE);
+      }
+    }
+  }
+
+  esp_delay(ms, []() { return !idleWakeRequested; });
+
+  if (light) {
+    // Volver a flancos y pasar el nivel actual por la ISR: un soltar que
+    // ocurrio mientras el pin estaba por nivel se encola ahora
+    for (int i = 0; i < wakePinCount; i++) {
+      attachInterrupt(digitalPinToInterrupt(wakePins[i].pin), wakePins[i].isr, CHANGE);
+      noInterrupts();  // La cola de botones espera un solo productor a la vez
+      wakePins[i].isr();
+      interrupts();
+    }
+  }
+}
+
+void halLog(const char* format, ...) {
+  static char buffer[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  Serial.print(buffer);
+}
+
+// Estado de una sonda. La conexion se hace con la API raw de lwIP para
+// que connect() y la resolucion DNS no bloqueen loop(); los callbacks solo
+// marcan resultados que luego consume pollTcpProbe(). Las sondas de
+// aplicacion mantienen la conexion abierta hasta validar la respuesta; el eco
+// UDP usa un udp_pcb propio.
+enum ProbeState { PROBE_IDLE, PROBE_RESOLVING, PROBE_CONNECTING };
+
+struct TcpProbe {
+  char host[64];                  // Host cuyo IP esta en cache
+  uint16_t port;
+  uint8_t type;                   // ProbeType
+  char match[PROBE_MATCH_SIZE];
+  uint16_t http_status;
+  ProbeState state;
+  struct tcp_pcb* pcb;
+  struct udp_pcb* udp;
+  volatile int8_t result;         // ProbeResult, escrito desde callbacks lwIP
+  char rx[PROBE_RESPONSE_SIZE];   // Comienzo de la respuesta
+  size_t rx_len;
+  unsigned long start_ms;
+  unsigned long deadline_ms;
+  unsigned long last_rtt_ms;      // RTT del ultimo connect exitoso
+  unsigned long last_response_ms; // Hasta la ultima respuesta valida
+  // Cache DNS
+  IPAddress ip;
+  volatile bool ip_valid;
+  volatile bool dns_pending;
+  unsigned long resolved_at;
+};
+
+TcpProbe probes[HAL_PROBE_SLOTS] = {};
+
+void probeDnsFound(const char* name, const ip_addr_t* ipaddr, void* arg) {
+  TcpProbe* probe = (TcpProbe*)arg;
+  probe->dns_pending = false;
+  halIdleWake();  // El connect arranca en el proximo halProbePoll()
+  if (ipaddr == nullptr || strcmp(name, probe->host) != 0) return;
+  probe->ip = IPAddress(ipaddr);
+  probe->ip_valid = true;
+  probe->resolved_at = millis();
+}
+
+// Lanza una resolucion DNS en segundo plano (si no hay una en curso)
+void resolveProbeHost(TcpProbe& probe) {
+  if (probe.dns_pending) return;
+
+  IPAddress literal;
+  if (literal.fromString(probe.host)) {
+    probe.ip = literal;
+    probe.ip_valid = true;
+    probe.resolved_at = millis();
+    return;
+  }
+
+  ip_addr_t addr;
+  probe.dns_pending = true;
+  err_t err = dns_gethostbyname(probe.host, &addr, probeDnsFound, &probe);
+  if (err == ERR_OK) {
+    probe.dns_pending = false;
+    probe.ip = IPAddress(&addr);
+    probe.ip_valid = true;
+    probe.resolved_at = millis();
+  } else if (err != ERR_INPROGRESS) {
+    probe.dns_pending = false;
+    halLog("Watchdog: error resolviendo %s (%d)\n", probe.host, err);
+  }
+}
+
+ProbeRequest probeRequestOf(const TcpProbe& probe) {
+  return { probe.type, probe.host, probe.port, probe.match, probe.http_status, 0 };
+}
+
+// Cierra la conexion desde un callback de lwIP con el resultado final
+err_t finishProbeConnection(TcpProbe* probe, struct tcp_pcb* pcb, ProbeResult result) {
+  if (result == PROBE_OK) probe->last_response_ms = millis() - probe->start_ms;
+  probe->pcb = nullptr;
+  probe->result = result;
+  halIdleWake();
+
+  tcp_arg(pcb, nullptr);
+  tcp_err(pcb, nullptr);
+  tcp_recv(pcb, nullptr);
+  if (tcp_close(pcb) != ERR_OK) {
+    tcp_abort(pcb);
+    return ERR_ABRT;
+  }
+  return ERR_OK;
+}
+
+// Acumula el comienzo de la respuesta hasta poder decidir
+err_t probeRecv(void* arg, struct tcp_pcb* pcb, struct pbuf* p, err_t err) {
+  TcpProbe* probe = (TcpProbe*)arg;
+  if (p == nullptr) {
+    // El servidor cerro: se decide con lo que haya llegado
+    ProbeResult result = checkProbeResponse(probeRequestOf(*probe), probe->rx, probe->rx_len);
+    return finishProbeConnection(probe, pcb, result == PROBE_OK ? PROBE_OK : PROBE_MISMATCH);
+  }
+
+  size_t room = sizeof(probe->rx) - probe->rx_len;
+  size_t copied = pbuf_copy_partial(p, probe->rx + probe->rx_len, min((size_t)p->tot_len, room), 0);
+  probe->rx_len += copied;
+  tcp_recved(pcb, p->tot_len);
+  pbuf_free(p);
+
+  ProbeResult result = checkProbeResponse(probeRequestOf(*probe), probe->rx, probe->rx_len);
+  if (result == PROBE_PENDING && probe->rx_len < sizeof(probe->rx)) return ERR_OK;
+  return finishProbeConnection(probe, pcb, result == PROBE_OK ? PROBE_OK : PROBE_MISMATCH);
+}
+
+err_t probeConnected(void* arg, struct tcp_pcb* pcb, err_t err) {
+  TcpProbe* probe = (TcpProbe*)arg;
+  probe->last_rtt_ms = millis() - probe->start_ms;
+  if (probe->type == PROBE_TCP) return finishProbeConnection(probe, pcb, PROBE_OK);
+
+  tcp_recv(pcb, probeRecv);
+  if (probe->type == PROBE_HTTP) {
+    static char request[160];
+    int len = snprintf(request, sizeof(request),
+                       "GET %s HTTP/1.0\r\nHost: %s\r\nUser-Agent: atx-watchdog\r\nConnection: close\r\n\r\n",
+                       probe->match[0] != '\0' ? probe->match : "/", probe->host);
+    if (tcp_write(pcb, request, len, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+      return finishProbeConnection(probe, pcb, PROBE_FAILED);
+    }
+    tcp_output(pcb);
+  }
+  return ERR_OK;
+}
+
+void probeUdpRecv(void* arg, struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* addr, u16_t port) {
+  TcpProbe* probe = (TcpProbe*)arg;
+  if (probe->result == PROBE_PENDING) {
+    probe->rx_len = pbuf_copy_partial(p, probe->rx, sizeof(probe->rx), 0);
+    ProbeResult result = checkProbeResponse(probeRequestOf(*probe), probe->rx, probe->rx_len);
+    if (result == PROBE_OK) {
+      probe->last_rtt_ms = millis() - probe->start_ms;
+      probe->last_response_ms = probe->last_rtt_ms;
+    }
+    probe->result = result;
+    halIdleWake();
+  }
+  pbuf_free(p);
+}
+
+void probeError(void* arg, err_t err) {
+  // lwIP ya libero el pcb (RST, timeout interno, etc.)
+  TcpProbe* probe = (TcpProbe*)arg;
+  if (probe == nullptr) return;
+  probe->pcb = nullptr;
+  probe->result = PROBE_FAILED;
+  halIdleWake();
+}
+
+void abortProbeConnection(TcpProbe& probe) {
+  if (probe.udp != nullptr) {
+    udp_remove(probe.udp);
+    probe.udp = nullptr;
+  }
+  if (probe.pcb == nullptr) return;
+  tcp_arg(probe.pcb, nullptr);
+  tcp_err(probe.pcb, nullptr);
+  tcp_recv(probe.pcb, nullptr);
+  tcp_abort(probe.pcb);
+  probe.pcb = nullptr;
+}
+
+void beginUdpEcho(TcpProbe& probe) {
+  probe.state = PROBE_CONNECTING;
+  probe.udp = udp_new();
+  if (probe.udp == nullptr) {
+    probe.result = PROBE_FAILED;
+    return;
+  }
+  udp_recv(probe.udp, probeUdpRecv, &probe);
+
+  const char* payload = udpEchoPayload(probe.match);
+  size_t len = strlen(payload);
+  struct pbuf* p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+  if (p == nullptr) {
+    probe.result = PROBE_FAILED;
+    return;
+  }
+  memcpy(p->payload, payload, len);
+  ip_addr_t addr = probe.ip;
+  if (udp_sendto(probe.udp, p, &addr, probe.port) != ERR_OK) probe.result = PROBE_FAILED;
+  pbuf_free(p);
+}
+
+void beginProbeConnect(TcpProbe& probe) {
+  probe.result = PROBE_PENDING;
+  if (probe.type == PROBE_UDP_ECHO) {
+    beginUdpEcho(probe);
+    return;
+  }
+  probe.pcb = tcp_new();
+  if (probe.pcb == nullptr) {
+    probe.result = PROBE_FAILED;
+    return;
+  }
+
+  tcp_arg(probe.pcb, &probe);
+  tcp_err(probe.pcb, probeError);
+
+  ip_addr_t addr = probe.ip;
+  err_t err = tcp_connect(probe.pcb, &addr, probe.port, probeConnected);
+  if (err != ERR_OK) {
+    abortProbeConnection(probe);
+    probe.result = PROBE_FAILED;
+    return;
+  }
+  probe.state = PROBE_CONNECTING;
+}
+
+void startTcpProbe(TcpProbe& probe, const ProbeRequest& request) {
+  abortProbeConnection(probe);
+
+  // Si cambio el host, invalidar la cache DNS
+  if (strcmp(probe.host, request.host) != 0) {
+    strlcpy(probe.host, request.host, sizeof(probe.host));
+    probe.ip_valid = false;
+  }
+  probe.port = request.port;
+  probe.type = request.type;
+  strlcpy(probe.match, request.match, sizeof(probe.match));
+  probe.http_status = request.http_status;
+  probe.rx_len = 0;
+  probe.start_ms = millis();
+  probe.deadline_ms = probe.start_ms + request.timeout_ms;
+  probe.result = PROBE_PENDING;
+
+  // Cache vencida: re-resolver en segundo plano y seguir con el IP anterior
+  if (!probe.ip_valid || probe.start_ms - probe.resolved_at >= DNS_CACHE_TTL_MS) {
+    resolveProbeHost(probe);
+  }
+
+  if (probe.ip_valid) {
+    beginProbeConnect(probe);
+  } else {
+    probe.state = PROBE_RESOLVING;
+  }
+}
+
+// Avanza la maquina de estados. Devuelve PROBE_PENDING mientras la sonda
+// siga en curso; al terminar la deja en PROBE_IDLE.
+ProbeResult pollTcpProbe(TcpProbe& probe) {
+  if (probe.state == PROBE_IDLE) return PROBE_PENDING;
+
+  bool expired = (long)(millis() - probe.deadline_ms) >= 0;
+
+  if (probe.state == PROBE_RESOLVING) {
+    if (probe.ip_valid) {
+      beginProbeConnect(probe);
+    } else if (expired || !probe.dns_pending) {
+      probe.state = PROBE_IDLE;
+      return PROBE_FAILED;
+    } else {
+      return PROBE_PENDING;
+    }
+  }
+
+  if (probe.result != PROBE_PENDING) {
+    abortProbeConnection(probe);  // Libera el udp_pcb del eco
+    probe.state = PROBE_IDLE;
+    return (ProbeResult)probe.result;
+  }
+
+  if (expired) {
+    abortProbeConnection(probe);
+    probe.state = PROBE_IDLE;
+    return PROBE_FAILED;
+  }
+
+  return PROBE_PENDING;
+}
+
+void halProbeStart(int slot, const ProbeRequest& request) {
+  startTcpProbe(probes[slot], request);
+}
+
+ProbeResult halProbePoll(int slot) {
+  return pollTcpProbe(probes[slot]);
+}
+
+bool halProbeIdle(int slot) {
+  return probes[slot].state == PROBE_IDLE;
+}
+
+void halProbeAbort(int slot) {
+  abortProbeConnection(probes[slot]);
+  probes[slot].state = PROBE_IDLE;
+}
+
+unsigned long halProbeRtt(int slot) {
+  return probes[slot].last_rtt_ms;
+}
+
+unsigned long halProbeResponseRtt(int slot) {
+  return probes[slot].last_response_ms;
+}
+
+void halProbeFlushDns(int slot) {
+  probes[slot].resolved_at = millis() - DNS_CACHE_TTL_MS;
+}
+
+uint32_t halProbeAddress(int slot) {
+  return probes[slot].ip_valid ? (uint32_t)probes[slot].ip : 0;
+}
+
+bool halHeartbeatBegin(uint16_t port) {
+  if (heartbeatListening) heartbeatUdp.stop();
+  heartbeatListening = port != 0 && heartbeatUdp.begin(port) == 1;
+  return heartbeatListening;
+}
+
+int halHeartbeatReceive(char* buffer, size_t size) {
+  if (!heartbeatListening) return -1;
+  int available = heartbeatUdp.parsePacket();
+  if (available <= 0) return -1;
+  // Lo que no entra se descarta con el proximo parsePacket()
+  int len = heartbeatUdp.read(buffer, size - 1);
+  if (len < 0) len = 0;
+  buffer[len] = '\0';
+  return len;
+}
+
+bool halHeartbeatRecordLoad(void* data, size_t len) {
+  File file = LittleFS.open(HEARTBEAT_RECORD_FILE, "r");
+  if (!file) return false;
+  bool ok = file.size() == len && file.read((uint8_t*)data, len) == (int)len;
+  file.close();
+  return ok;
+}
+
+bool halHeartbeatRecordSave(const void* data, size_t len) {
+  File file = LittleFS.open(HEARTBEAT_RECORD_FILE, "w");
+  if (!file) return false;
+  bool ok = file.write((const uint8_t*)data, len) == len;
+  file.close();
+  return ok;
+}
+
+bool halJournalOpen(size_t size) {
+  journalFile = LittleFS.open(JOURNAL_FILE, "r+");
+  if (journalFile && journalFile.size() == size) return true;
+  if (journalFile) journalFile.close();
+
+  // Preasignar en ceros: despues solo se sobrescribe en el lugar
+  journalFile = LittleFS.open(JOURNAL_FILE, "w+");
+  if (!journalFile) return false;
+  uint8_t zeros[256] = {};
+  for (size_t written = 0; written < size; written += sizeof(zeros)) {
+    size_t n = size - written < sizeof(zeros) ? size - written : sizeof(zeros);
+    if (journalFile.write(zeros, n) != n) {
+      journalFile.close();
+      return false;
+    }
+  }
+  journalFile.flush();
+  return true;
+}
+
+bool halJournalRead(size_t offset, void* data, size_t len) {
+  if (!journalFile || !journalFile.seek(offset, SeekSet)) return false;
+  return journalFile.read((uint8_t*)data, len) == (int)len;
+}
+
+bool halJournalWrite(size_t offset, const void* data, size_t len) {
+  if (!journalFile || !journalFile.seek(offset, SeekSet)) return false;
+  bool ok = journalFile.write((const uint8_t*)data, len) == len;
+  journalFile.flush();
+  return ok;
+}
+
+bool halSseBegin(uint16_t port) {
+  if (sseServer != nullptr || port == 0) return false;
+  sseServer = new WiFiServer(port);
+  sseServer->begin();
+  sseServer->setNoDelay(true);
+  return true;
+}
+
+void sseRelease(SseClient& c) {
+  c.client.stop();
+  c.state = SSE_FREE;
+}
+
+// Escribe sin bloquear: si el buffer TCP del cliente no tiene lugar se
+// descarta el mensaje (el navegador se pone al dia con el proximo)
+void sseWrite(SseClient& c, const char* data, size_t len) {
+  if ((size_t)c.client.availableForWrite() < len) {
+    if (++c.drops >= SSE_MAX_DROPS) sseRelease(c);
+    return;
+  }
+  c.client.write((const uint8_t*)data, len);
+  c.drops = 0;
+}
+
+void sseHandleRequest(SseClient& c) {
+  while (c.client.available() > 0) {
+    int ch = c.client.read();
+    if (ch < 0) break;
+    if (c.head_len < sizeof(c.head)) c.head[c.head_len++] = ch;
+    c.tail = (c.tail << 8) | (uint8_t)ch;
+    if (c.tail != 0x0D0A0D0A) continue;
+
+    if (c.head_len == sizeof(c.head) && memcmp(c.head, "GET /events", 11) == 0 &&
+        (c.head[11] == ' ' || c.head[11] == '?')) {
+      static const char HEADERS[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Connection: keep-alive\r\n\r\n"
+        "retry: 3000\n\n";
+      c.client.write((const uint8_t*)HEADERS, sizeof(HEADERS) - 1);
+      c.state = SSE_STREAMING;
+      c.drops = 0;
+    } else {
+      static const char NOT_FOUND[] = "HTTP/1.1 404 Not Found\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+      c.client.write((const uint8_t*)NOT_FOUND, sizeof(NOT_FOUND) - 1);
+      sseRelease(c);
+    }
+    return;
+  }
+  if (halMillis() - c.since > SSE_REQUEST_TIMEOUT_MS) sseRelease(c);
+}
+
+void halSsePoll() {
+  if (sseServer == nullptr) return;
+
+  WiFiClient incoming = sseServer->accept();
+  if (incoming) {
+    SseClient* slot = nullptr;
+    for (SseClient& c : sseClients) {
+      if (c.state == SSE_FREE) {
+        slot = &c;
+        break;
+      }
+    }
+    if (slot == nullptr) {
+      static const char BUSY[] = "HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+      incoming.write((const uint8_t*)BUSY, sizeof(BUSY) - 1);
+      incoming.stop();
+    } else {
+      slot->client = incoming;
+      slot->client.setNoDelay(true);
+      slot->state = SSE_REQUEST;
+      slot->since = halMillis();
+      slot->head_len = 0;
+      slot->tail = 0;
+    }
+  }
+
+  bool ping = halMillis() - sseLastPing >= SSE_PING_INTERVAL_MS;
+  if (ping) sseLastPing = halMillis();
+  for (SseClient& c : sseClients) {
+    if (c.state == SSE_FREE) continue;
+    if (!c.client.connected()) {
+      sseRelease(c);
+    } else if (c.state == SSE_REQUEST) {
+      sseHandleRequest(c);
+    } else {
+      // Lo que mande el navegador despues del pedido se ignora
+      while (c.client.available() > 0) c.client.read();
+      if (ping) sseWrite(c, ": ping\n\n", 8);
+    }
+  }
+}
+
+int halSseClientCount() {
+  int count = 0;
+  for (SseClient& c : sseClients) {
+    if (c.state == SSE_STREAMING) count++;
+  }
+  return count;
+}
+
+void halSseSend(const char* event, const char* data) {
+  static char message[SSE_MESSAGE_SIZE];
+  int len = snprintf(message, sizeof(message), "event: %s\ndata: %s\n\n", event, data);
+  if (len <= 0 || len >= (int)sizeof(message)) return;
+  for (SseClient& c : sseClients) {
+    if (c.state != SSE_STREAMING) continue;
+    if (!c.client.connected()) {
+      sseRelease(c);
+    } else {
+      sseWrite(c, message, len);
+    }
+  }
+}
+
+// Descarga OTA con la API raw de lwIP, igual que las sondas: el connect no
+// bloquea loop() y el request sale desde el callback de conexion. Lo recibido
+// queda encolado en pbufs y recien se confirma a lwIP (tcp_recved) al leerlo,
+// asi la ventana TCP frena al servidor mientras no se consume.
+struct FetchConnection {
+  struct tcp_pcb* pcb;
+  volatile int8_t result;         // ProbeResult: PENDING conectando, OK conectado
+  volatile bool remote_closed;
+  struct pbuf* rx;
+  char request[FETCH_REQUEST_SIZE];
+};
+
+FetchConnection fetchConn = { nullptr, PROBE_FAILED, false, nullptr, {} };
+
+err_t fetchRecv(void* arg, struct tcp_pcb* pcb, struct pbuf* p, err_t err) {
+  FetchConnection* fetch = (FetchConnection*)arg;
+  if (p == nullptr) {
+    fetch->remote_closed = true;
+  } else if (fetch->rx == nullptr) {
+    fetch->rx = p;
+  } else {
+    pbuf_cat(fetch->rx, p);
+  }
+  halIdleWake();
+  return ERR_OK;
+}
+
+err_t fetchConnected(void* arg, struct tcp_pcb* pcb, err_t err) {
+  FetchConnection* fetch = (FetchConnection*)arg;
+  tcp_nagle_disable(pcb);
+  tcp_recv(pcb, fetchRecv);
+  if (tcp_write(pcb, fetch->request, strlen(fetch->request), TCP_WRITE_FLAG_COPY) != ERR_OK) {
+    tcp_arg(pcb, nullptr);
+    tcp_err(pcb, nullptr);
+    tcp_recv(pcb, nullptr);
+    tcp_abort(pcb);
+    fetch->pcb = nullptr;
+    fetch->result = PROBE_FAILED;
+    return ERR_ABRT;
+  }
+  tcp_output(pcb);
+  fetch->result = PROBE_OK;
+  halIdleWake();
+  return ERR_OK;
+}
+
+void fetchError(void* arg, err_t err) {
+  // lwIP ya libero el pcb (RST, timeout interno, etc.)
+  FetchConnection* fetch = (FetchConnection*)arg;
+  if (fetch == nullptr) return;
+  fetch->pcb = nullptr;
+  fetch->result = PROBE_FAILED;
+  halIdleWake();
+}
+
+bool halFetchOpen(uint32_t address, uint16_t port, const char* request) {
+  halFetchClose();
+  if (address == 0 || strlcpy(fetchConn.request, request, sizeof(fetchConn.request)) >= sizeof(fetchConn.request)) {
+    return false;
+  }
+  fetchConn.pcb = tcp_new();
+  if (fetchConn.pcb == nullptr) return false;
+
+  tcp_arg(fetchConn.pcb, &fetchConn);
+  tcp_err(fetchConn.pcb, fetchError);
+  fetchConn.result = PROBE_PENDING;
+  fetchConn.remote_closed = false;
+
+  ip_addr_t addr = IPAddress(address);
+  if (tcp_connect(fetchConn.pcb, &addr, port, fetchConnected) != ERR_OK) {
+    halFetchClose();
+    return false;
+  }
+  return true;
+}
+
+ProbeResult halFetchPoll() {
+  return (ProbeResult)fetchConn.result;
+}
+
+int halFetchRead(uint8_t* buffer, size_t size) {
+  if (fetchConn.result == PROBE_PENDING) return 0;
+  if (fetchConn.rx == nullptr) {
+    return fetchConn.result == PROBE_OK && !fetchConn.remote_closed ? 0 : -1;
+  }
+  size_t n = pbuf_copy_partial(fetchConn.rx, buffer, size, 0);
+  fetchConn.rx = pbuf_free_header(fetchConn.rx, n);
+  if (fetchConn.pcb != nullptr) tcp_recved(fetchConn.pcb, n);
+  return (int)n;
+}
+
+void halFetchClose() {
+  if (fetchConn.pcb != nullptr) {
+    tcp_arg(fetchConn.pcb, nullptr);
+    tcp_err(fetchConn.pcb, nullptr);
+    tcp_recv(fetchConn.pcb, nullptr);
+    if (tcp_close(fetchConn.pcb) != ERR_OK) tcp_abort(fetchConn.pcb);
+    fetchConn.pcb = nullptr;
+  }
+  if (fetchConn.rx != nullptr) {
+    pbuf_free(fetchConn.rx);
+    fetchConn.rx = nullptr;
+  }
+  fetchConn.result = PROBE_FAILED;
+}
+
+bool halUpdateBegin(size_t size) {
+  if (Update.begin(size)) return true;
+  halLog("Update.begin: %s\n", Update.getErrorString().c_str());
+  return false;
+}
+
+bool halUpdateWrite(const uint8_t* data, size_t len) {
+  return Update.write((uint8_t*)data, len) == len;
+}
+
+bool halUpdateEnd(bool commit) {
+  // Sin todos los bytes escritos end() descarta la actualizacion
+  if (!commit) {
+    Update.end(false);
+    return false;
+  }
+  if (Update.end()) return true;
+  halLog("Update.end: %s\n", Update.getErrorString().c_str());
+  return false;
+}
+
+size_t halFirmwareSize() {
+  return ESP.getSketchSize();
+}
+
+bool halFirmwareRead(size_t offset, uint8_t* data, size_t len) {
+  // La imagen en ejecucion empieza al principio de la flash
+  return ESP.flashRead(offset, data, len);
+}
+
+bool halBackupBegin(size_t size) {
+  halBackupClose();
+  LittleFS.remove(OTA_BACKUP_FILE);
+  FSInfo info;
+  if (!LittleFS.info(info) || info.totalBytes - info.usedBytes < size + OTA_FS_MARGIN) return false;
+  otaBackupFile = LittleFS.open(OTA_BACKUP_FILE, "w");
+  otaBackupWriting = (bool)otaBackupFile;
+  return otaBackupWriting;
+}
+
+bool halBackupWrite(const uint8_t* data, size_t len) {
+  return otaBackupWriting && otaBackupFile.write(data, len) == len;
+}
+
+bool halBackupRead(size_t offset, uint8_t* data, size_t len) {
+  if (otaBackupWriting) halBackupClose();
+  if (!otaBackupFile) otaBackupFile = LittleFS.open(OTA_BACKUP_FILE, "r");
+  if (!otaBackupFile || !otaBackupFile.seek(offset, SeekSet)) return false;
+  return otaBackupFile.read(data, len) == (int)len;
+}
+
+void halBackupClose() {
+  if (otaBackupFile) otaBackupFile.close();
+  otaBackupWriting = false;
+}
+
+bool halOtaRecordLoad(void* data, size_t len) {
+  File file = LittleFS.open(OTA_RECORD_FILE, "r");
+  if (!file) return false;
+  bool ok = file.size() == len && file.read((uint8_t*)data, len) == (int)len;
+  file.close();
+  return ok;
+}
+
+bool halOtaRecordSave(const void* data, size_t len) {
+  File file = LittleFS.open(OTA_RECORD_FILE, "w");
+  if (!file) return false;
+  bool ok = file.write((const uint8_t*)data, len) == len;
+  file.close();
+  return ok;
+}
+
+void halRestart() {
+  ESP.restart();
+}
+
+uint32_t halLocalIp() {
+  return (uint32_t)WiFi.localIP();
+}
+
+int halWifiRssi() {
+  return WiFi.RSSI();
+}
+
+uint32_t halFreeHeap() {
+  return ESP.getFreeHeap();
+}
+
+uint32_t halMaxFreeBlock() {
+  return ESP.getMaxFreeBlockSize();
+}
+
+uint8_t halHeapFragmentation() {
+  return ESP.getHeapFragmentation();
+}
+
+void halHttpPoll() {
+  server.handleClient();
+}
+
+bool halMqttConnect(uint32_t address, uint16_t port, const char* client_id, const char* user,
+                    const char* pass, const char* will_topic, const char* will_payload) {
+  // IP ya resuelto por la sonda: connect() no vuelve a consultar el DNS
+  mqttClient.setServer(IPAddress(address), port);
+  return mqttClient.connect(client_id, user, pass, will_topic, 1, true, will_payload);
+}
+
+int halMqttState() {
+  return mqttClient.state();
+}
+
+bool halMqttSubscribe(const char* topic) {
+  return mqttClient.subscribe(topic);
+}
+
+void halMqttLoop() {
+  mqttClient.loop();
+}
+
+bool halMqttConnected() {
+  return mqttClient.connected();
+}
+
+bool halMqttPublish(const char* topic, const char* payload, bool retained) {
+  if (!mqttClient.connected()) return false;
+  return mqttClient.publish(topic, payload, retained);
+}
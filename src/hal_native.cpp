@@ -0,0 +1,709 @@
+// Implementacion falsa de la HAL para el build nativo ([env:native]). El
+// reloj de millis() es simulado y solo avanza con simAdvance(); micros()
+// usa el reloj real del host para medir el costo de cada iteracion.
+
+#ifndef ARDUINO
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+#include "hal.h"
+#include "app_loop.h"
+#include "probes.h"
+#include "sha256.h"
+
+#define SIM_PIN_COUNT 17
+#define SIM_MAX_TCP_TARGETS 8
+#define SIM_HEARTBEAT_QUEUE 4
+#define SIM_FIRMWARE_SIZE 49152        // Imagen "en ejecucion" inicial
+#define SIM_HTTP_HEADER_SIZE 128
+#define SIM_FETCH_CONNECT_MS 5         // Connect de la descarga (un RTT de LAN)
+#define SIM_MQTT_SUBSCRIPTIONS 8
+#define SIM_MQTT_TOPICS 16             // Topics con ultimo payload guardado
+#define SIM_MQTT_TOPIC_SIZE 64
+#define SIM_MQTT_PAYLOAD_SIZE 512
+#define SIM_LOCAL_IP 0x3201A8C0UL      // 192.168.1.50 en el orden de lwIP
+
+struct SimTcpTarget {
+  char host[64];
+  uint16_t port;
+  bool up;
+  unsigned long rtt_ms;
+  char response[PROBE_RESPONSE_SIZE];  // Lo que contesta el servicio tras el connect
+  unsigned long response_ms;
+};
+
+// Sonda en curso: el resultado se entrega cuando el reloj simulado llega a done_at
+struct SimProbe {
+  bool active;
+  ProbeResult result;
+  unsigned long done_at;
+  unsigned long rtt_ms;
+  unsigned long response_ms;
+  unsigned long last_rtt_ms;
+  unsigned long last_response_ms;
+  uint32_t address;               // 10.0.0.<n> del objetivo simulado, 0 = no resuelto
+};
+
+unsigned long simNow = 0;
+uint32_t simRandomState = 12345;
+bool simPins[SIM_PIN_COUNT];
+bool simPinsReady = false;
+void (*simPinIsr[SIM_PIN_COUNT])() = {};
+SimTcpTarget simTcpTargets[SIM_MAX_TCP_TARGETS] = {};
+int simTcpTargetCount = 0;
+SimProbe simProbes[HAL_PROBE_SLOTS] = {};
+bool simMqttConnected = false;
+char simMqttWillTopic[SIM_MQTT_TOPIC_SIZE];
+char simMqttWillPayload[SIM_MQTT_PAYLOAD_SIZE];
+char simMqttSubscriptions[SIM_MQTT_SUBSCRIPTIONS][SIM_MQTT_TOPIC_SIZE];
+int simMqttSubscriptionCount = 0;
+struct SimPublish {
+  char topic[SIM_MQTT_TOPIC_SIZE];
+  char payload[SIM_MQTT_PAYLOAD_SIZE];
+};
+SimPublish simPublishes[SIM_MQTT_TOPICS];
+int simPublishCount = 0;
+char simHeartbeats[SIM_HEARTBEAT_QUEUE][256];
+int simHeartbeatCount = 0;
+bool simHeartbeatListening = false;
+uint8_t simHeartbeatRecord[1024];       // "Flash": sobrevive a simReboot()
+size_t simHeartbeatRecordSize = 0;
+unsigned long simHeartbeatRecordWrites = 0;
+bool simLogLineStart = true;
+uint8_t* simJournal = nullptr;
+size_t simJournalSize = 0;
+unsigned long simJournalWrites = 0;
+int simSseClients = 0;
+// Flash simulada: imagen en ejecucion, area de actualizacion y copia
+uint8_t* simFirmware = nullptr;
+size_t simFirmwareLength = 0;
+uint8_t* simUpdate = nullptr;
+size_t simUpdateSize = 0;
+size_t simUpdateWritten = 0;
+bool simUpdateReady = false;           // Confirmada: se aplica al reiniciar
+uint8_t* simBackup = nullptr;
+size_t simBackupSize = 0;
+size_t simBackupWritten = 0;
+uint8_t simOtaRecord[128];
+size_t simOtaRecordSize = 0;
+bool simRestartRequested = false;
+// Servidor HTTP simulado: headers + archivo, entregados a bytes_per_ms
+const uint8_t* simHttpData = nullptr;
+size_t simHttpLength = 0;
+unsigned long simHttpRate = 0;
+bool simFetchOpen = false;
+char simFetchHeader[SIM_HTTP_HEADER_SIZE];
+size_t simFetchHeaderLength = 0;
+size_t simFetchPosition = 0;
+unsigned long simFetchStart = 0;
+// Espera de ahorro de energia en curso (halIdle)
+bool simIdle = false;
+unsigned long simIdleUntil = 0;
+
+#ifdef HAL_NEEDS_STRLCPY
+size_t strlcpy(char* dest, const char* src, size_t size) {
+  size_t len = strlen(src);
+  if (size > 0) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dest, src, n);
+    dest[n] = '\0';
+  }
+  return len;
+}
+#endif
+
+// Todos los pines arrancan en HIGH (reposo con pull-up)
+void simInitPins() {
+  if (simPinsReady) return;
+  for (int i = 0; i < SIM_PIN_COUNT; i++) simPins[i] = true;
+  simPinsReady = true;
+}
+
+unsigned long halMillis() {
+  return simNow;
+}
+
+unsigned long halMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long)(ts.tv_sec * 1000000UL + ts.tv_nsec / 1000);
+}
+
+// Generador deterministico: la misma simulacion da siempre el mismo log
+long halRandom(long max) {
+  if (max <= 0) return 0;
+  simRandomState = simRandomState * 1103515245UL + 12345UL;
+  return (long)((simRandomState >> 16) % (unsigned long)max);
+}
+
+void halDigitalWrite(uint8_t pin, bool high) {
+  simInitPins();
+  if (pin >= SIM_PIN_COUNT) return;
+  if (simPins[pin] != high) halLog("[sim] GPIO%d -> %s\n", pin, high ? "HIGH" : "LOW");
+  simPins[pin] = high;
+}
+
+bool halDigitalRead(uint8_t pin) {
+  simInitPins();
+  return pin < SIM_PIN_COUNT ? simPins[pin] : true;
+}
+
+void halAttachChangeInterrupt(uint8_t pin, void (*isr)()) {
+  if (pin < SIM_PIN_COUNT) simPinIsr[pin] = isr;
+}
+
+void halSetLightSleep(bool) {
+}
+
+// No puede bloquear: el simulador deja de llamar a loop() hasta que vence.
+// Light y modem sleep se simulan igual.
+void halIdle(unsigned long ms, bool) {
+  simIdle = true;
+  simIdleUntil = simNow + ms;
+}
+
+void halIdleWake() {
+  simIdle = false;
+}
+
+// Antepone el tiempo simulado a cada linea
+void halLog(const char* format, ...) {
+  if (simLogLineStart) printf("[%9lu] ", simNow);
+  va_list args;
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
+  size_t len = strlen(format);
+  simLogLineStart = len > 0 && format[len - 1] == '\n';
+}
+
+SimTcpTarget* findSimTcpTarget(const char* host, uint16_t port) {
+  for (int i = 0; i < simTcpTargetCount; i++) {
+    if (simTcpTargets[i].port == port && strcmp(simTcpTargets[i].host, host) == 0) {
+      return &simTcpTargets[i];
+    }
+  }
+  return nullptr;
+}
+
+void halProbeStart(int slot, const ProbeRequest& request) {
+  SimProbe& probe = simProbes[slot];
+  SimTcpTarget* target = findSimTcpTarget(request.host, request.port);
+  probe.active = true;
+
+  if (target == nullptr) {
+    // Host desconocido: falla como un error de DNS
+    probe.result = PROBE_FAILED;
+    probe.done_at = simNow;
+    return;
+  }
+  probe.address = (uint32_t)(target - simTcpTargets + 1) << 24 | 10;
+
+  unsigned long total_ms = target->rtt_ms;
+  ProbeResult result = PROBE_OK;
+  if (request.type != PROBE_TCP) {
+    // Misma validacion que en el ESP sobre la respuesta configurada
+    total_ms += target->response_ms;
+    result = checkProbeResponse(request, target->response, strlen(target->response));
+    if (result == PROBE_PENDING) result = PROBE_MISMATCH;
+  }
+
+  if (target->up && total_ms < request.timeout_ms) {
+    probe.result = result;
+    probe.done_at = simNow + total_ms;
+    probe.rtt_ms = target->rtt_ms;
+    probe.response_ms = total_ms;
+  } else {
+    probe.result = PROBE_FAILED;
+    probe.done_at = simNow + request.timeout_ms;
+  }
+}
+
+ProbeResult halProbePoll(int slot) {
+  SimProbe& probe = simProbes[slot];
+  if (!probe.active || (long)(simNow - probe.done_at) < 0) return PROBE_PENDING;
+  probe.active = false;
+  if (probe.result == PROBE_OK) {
+    probe.last_rtt_ms = probe.rtt_ms;
+    probe.last_response_ms = probe.response_ms;
+  }
+  return probe.result;
+}
+
+bool halProbeIdle(int slot) {
+  return !simProbes[slot].active;
+}
+
+void halProbeAbort(int slot) {
+  simProbes[slot].active = false;
+}
+
+unsigned long halProbeRtt(int slot) {
+  return simProbes[slot].last_rtt_ms;
+}
+
+unsigned long halProbeResponseRtt(int slot) {
+  return simProbes[slot].last_response_ms;
+}
+
+void halProbeFlushDns(int slot) {
+  simProbes[slot].address = 0;
+}
+
+uint32_t halProbeAddress(int slot) {
+  return simProbes[slot].address;
+}
+
+bool halHeartbeatBegin(uint16_t port) {
+  simHeartbeatListening = port != 0;
+  return simHeartbeatListening;
+}
+
+int halHeartbeatReceive(char* buffer, size_t size) {
+  if (simHeartbeatCount == 0) return -1;
+  strlcpy(buffer, simHeartbeats[0], size);
+  simHeartbeatCount--;
+  memmove(simHeartbeats[0], simHeartbeats[1], sizeof(simHeartbeats[0]) * simHeartbeatCount);
+  return strlen(buffer);
+}
+
+bool halHeartbeatRecordLoad(void* data, size_t len) {
+  if (simHeartbeatRecordSize != len) return false;
+  memcpy(data, simHeartbeatRecord, len);
+  return true;
+}
+
+bool halHeartbeatRecordSave(const void* data, size_t len) {
+  if (len > sizeof(simHeartbeatRecord)) return false;
+  memcpy(simHeartbeatRecord, data, len);
+  simHeartbeatRecordSize = len;
+  simHeartbeatRecordWrites++;
+  return true;
+}
+
+unsigned long simHeartbeatRecordWriteCount() {
+  return simHeartbeatRecordWrites;
+}
+
+unsigned long simJournalWriteCount() {
+  return simJournalWrites;
+}
+
+// Diario en memoria: se pierde al terminar la simulacion
+bool halJournalOpen(size_t size) {
+  if (simJournal == nullptr) simJournal = (uint8_t*)calloc(1, size);
+  simJournalSize = size;
+  return simJournal != nullptr;
+}
+
+bool halJournalRead(size_t offset, void* data, size_t len) {
+  if (offset + len > simJournalSize) return false;
+  memcpy(data, simJournal + offset, len);
+  return true;
+}
+
+bool halJournalWrite(size_t offset, const void* data, size_t len) {
+  if (offset + len > simJournalSize) return false;
+  memcpy(simJournal + offset, data, len);
+  simJournalWrites++;
+  return true;
+}
+
+bool halSseBegin(uint16_t port) {
+  return port != 0;
+}
+
+void halSsePoll() {
+}
+
+int halSseClientCount() {
+  return simSseClients;
+}
+
+void halSseSend(const char* event, const char* data) {
+  if (simSseClients > 0) halLog("[sim] SSE %s: %s\n", event, data);
+}
+
+void simSetSseClients(int count) {
+  simSseClients = count;
+}
+
+// Un solo servidor simulado: el puerto no se usa. El connect tarda
+// SIM_FETCH_CONNECT_MS y recien ahi empieza a llegar la respuesta.
+bool halFetchOpen(uint32_t address, uint16_t, const char* request) {
+  if (address == 0) return false;
+  const char* line_end = strchr(request, '\r');
+  halLog("[sim] HTTP %.*s\n", line_end != nullptr ? (int)(line_end - request) : 0, request);
+  if (simHttpData != nullptr) {
+    simFetchHeaderLength = snprintf(simFetchHeader, sizeof(simFetchHeader),
+                                    "HTTP/1.1 200 OK\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n",
+                                    (unsigned long)simHttpLength);
+  } else {
+    simFetchHeaderLength = snprintf(simFetchHeader, sizeof(simFetchHeader),
+                                    "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+  }
+  simFetchOpen = true;
+  simFetchPosition = 0;
+  simFetchStart = simNow + SIM_FETCH_CONNECT_MS;
+  return true;
+}
+
+ProbeResult halFetchPoll() {
+  if (!simFetchOpen) return PROBE_FAILED;
+  return (long)(simNow - simFetchStart) >= 0 ? PROBE_OK : PROBE_PENDING;
+}
+
+int halFetchRead(uint8_t* buffer, size_t size) {
+  if (!simFetchOpen) return -1;
+  if (halFetchPoll() == PROBE_PENDING) return 0;
+  size_t total = simFetchHeaderLength + (simHttpData != nullptr ? simHttpLength : 0);
+  if (simFetchPosition >= total) return -1;
+  // Los headers llegan enseguida; el cuerpo al ritmo configurado
+  size_t arrived = simFetchHeaderLength + (simNow - simFetchStart) * simHttpRate;
+  if (arrived > total) arrived = total;
+  size_t n = arrived - simFetchPosition;
+  if (n > size) n = size;
+  for (size_t i = 0; i < n; i++, simFetchPosition++) {
+    buffer[i] = simFetchPosition < simFetchHeaderLength ? (uint8_t)simFetchHeader[simFetchPosition]
+                                                        : simHttpData[simFetchPosition - simFetchHeaderLength];
+  }
+  return (int)n;
+}
+
+void halFetchClose() {
+  simFetchOpen = false;
+}
+
+bool halUpdateBegin(size_t size) {
+  free(simUpdate);
+  simUpdate = (uint8_t*)malloc(size);
+  simUpdateSize = size;
+  simUpdateWritten = 0;
+  simUpdateReady = false;
+  return simUpdate != nullptr;
+}
+
+bool halUpdateWrite(const uint8_t* data, size_t len) {
+  if (simUpdate == nullptr || simUpdateWritten + len > simUpdateSize) return false;
+  memcpy(simUpdate + simUpdateWritten, data, len);
+  simUpdateWritten += len;
+  return true;
+}
+
+bool halUpdateEnd(bool commit) {
+  simUpdateReady = commit && simUpdate != nullptr && simUpdateWritten == simUpdateSize;
+  if (!simUpdateReady) {
+    free(simUpdate);
+    simUpdate = nullptr;
+  }
+  return simUpdateReady;
+}
+
+// Imagen inicial: bytes pseudoaleatorios con el magic 0xE9 de las imagenes ESP
+void simEnsureFirmware() {
+  if (simFirmware != nullptr) return;
+  simFirmwareLength = SIM_FIRMWARE_SIZE;
+  simFirmware = (uint8_t*)malloc(simFirmwareLength);
+  uint32_t x = 2463534242UL;
+  for (size_t i = 0; i < simFirmwareLength; i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    simFirmware[i] = x;
+  }
+  simFirmware[0] = 0xE9;
+}
+
+size_t halFirmwareSize() {
+  simEnsureFirmware();
+  return simFirmwareLength;
+}
+
+bool halFirmwareRead(size_t offset, uint8_t* data, size_t len) {
+  simEnsureFirmware();
+  if (offset + len > simFirmwareLength) return false;
+  memcpy(data, simFirmware + offset, len);
+  return true;
+}
+
+bool halBackupBegin(size_t size) {
+  free(simBackup);
+  simBackup = (uint8_t*)malloc(size);
+  simBackupSize = size;
+  simBackupWritten = 0;
+  return simBackup != nullptr;
+}
+
+bool halBackupWrite(const uint8_t* data, size_t len) {
+  if (simBackup == nullptr || simBackupWritten + len > simBackupSize) return false;
+  memcpy(simBackup + simBackupWritten, data, len);
+  simBackupWritten += len;
+  return true;
+}
+
+bool halBackupRead(size_t offset, uint8_t* data, size_t len) {
+  if (simBackup == nullptr || offset + len > simBackupWritten) return false;
+  memcpy(data, simBackup + offset, len);
+  return true;
+}
+
+void halBackupClose() {
+}
+
+bool halOtaRecordLoad(void* data, size_t len) {
+  if (simOtaRecordSize != len) return false;
+  memcpy(data, simOtaRecord, len);
+  return true;
+}
+
+bool halOtaRecordSave(const void* data, size_t len) {
+  if (len > sizeof(simOtaRecord)) return false;
+  memcpy(simOtaRecord, data, len);
+  simOtaRecordSize = len;
+  return true;
+}
+
+void halRestart() {
+  if (!simRestartRequested) halLog("[sim] reinicio pedido\n");
+  simRestartRequested = true;
+}
+
+void simSetHttpFile(const uint8_t* data, size_t len, unsigned long bytes_per_ms) {
+  simHttpData = data;
+  simHttpLength = len;
+  simHttpRate = bytes_per_ms;
+}
+
+bool simTakeRestart() {
+  if (!simRestartRequested) return false;
+  simRestartRequested = false;
+  simFetchOpen = false;
+  if (simUpdateReady) {
+    // Lo que hace eboot: copiar la imagen nueva sobre la actual
+    free(simFirmware);
+    simFirmware = simUpdate;
+    simFirmwareLength = simUpdateSize;
+    simUpdate = nullptr;
+    simUpdateReady = false;
+  }
+  return true;
+}
+
+void simFirmwareDigest(uint8_t digest[32]) {
+  simEnsureFirmware();
+  Sha256 ctx;
+  sha256Init(ctx);
+  sha256Update(ctx, simFirmware, simFirmwareLength);
+  sha256Final(ctx, digest);
+}
+
+uint32_t halLocalIp() {
+  return SIM_LOCAL_IP;
+}
+
+int halWifiRssi() {
+  return -58;
+}
+
+// Valores tipicos del ESP8266 con la web y MQTT activos
+uint32_t halFreeHeap() {
+  return 31240;
+}
+
+uint32_t halMaxFreeBlock() {
+  return 28160;
+}
+
+uint8_t halHeapFragmentation() {
+  return 7;
+}
+
+void halHttpPoll() {
+}
+
+// Guarda el ultimo payload de cada topic para los chequeos del simulador
+void simRecordPublish(const char* topic, const char* payload) {
+  SimPublish* slot = nullptr;
+  for (int i = 0; i < simPublishCount && slot == nullptr; i++) {
+    if (strcmp(simPublishes[i].topic, topic) == 0) slot = &simPublishes[i];
+  }
+  if (slot == nullptr) {
+    if (simPublishCount >= SIM_MQTT_TOPICS) return;
+    slot = &simPublishes[simPublishCount++];
+    strlcpy(slot->topic, topic, sizeof(slot->topic));
+  }
+  strlcpy(slot->payload, payload, sizeof(slot->payload));
+}
+
+// El CONNECT simulado siempre se acepta (la sonda ya vio al broker)
+bool halMqttConnect(uint32_t address, uint16_t port, const char* client_id, const char* user,
+                    const char* pass, const char* will_topic, const char* will_payload) {
+  (void)user;
+  (void)pass;
+  halLog("[sim] MQTT CONNECT %lu.%lu.%lu.%lu:%u como %s\n", (unsigned long)(address & 0xff),
+         (unsigned long)((address >> 8) & 0xff), (unsigned long)((address >> 16) & 0xff),
+         (unsigned long)(address >> 24), port, client_id);
+  strlcpy(simMqttWillTopic, will_topic, sizeof(simMqttWillTopic));
+  strlcpy(simMqttWillPayload, will_payload, sizeof(simMqttWillPayload));
+  simMqttSubscriptionCount = 0;
+  simMqttConnected = true;
+  return true;
+}
+
+int halMqttState() {
+  return simMqttConnected ? 0 : -1;
+}
+
+bool halMqttSubscribe(const char* topic) {
+  if (!simMqttConnected || simMqttSubscriptionCount >= SIM_MQTT_SUBSCRIPTIONS) return false;
+  strlcpy(simMqttSubscriptions[simMqttSubscriptionCount++], topic, SIM_MQTT_TOPIC_SIZE);
+  return true;
+}
+
+void halMqttLoop() {
+}
+
+bool halMqttConnected() {
+  return simMqttConnected;
+}
+
+bool halMqttPublish(const char* topic, const char* payload, bool retained) {
+  if (!simMqttConnected) return false;
+  halLog("[sim] MQTT %s%s: %s\n", topic, retained ? " (retained)" : "", payload);
+  simRecordPublish(topic, payload);
+  return true;
+}
+
+bool simMqttDeliver(const char* topic, const char* payload) {
+  if (!simMqttConnected) return false;
+  for (int i = 0; i < simMqttSubscriptionCount; i++) {
+    if (strcmp(simMqttSubscriptions[i], topic) != 0) continue;
+    static char topicCopy[SIM_MQTT_TOPIC_SIZE];
+    strlcpy(topicCopy, topic, sizeof(topicCopy));
+    mqttCallback(topicCopy, (uint8_t*)payload, strlen(payload));
+    return true;
+  }
+  return false;
+}
+
+const char* simLastPublish(const char* topic) {
+  for (int i = 0; i < simPublishCount; i++) {
+    if (strcmp(simPublishes[i].topic, topic) == 0) return simPublishes[i].payload;
+  }
+  return "";
+}
+
+void simAdvance(unsigned long ms) {
+  simNow += ms;
+}
+
+bool simIdling() {
+  if (!simIdle) return false;
+  if ((long)(simNow - simIdleUntil) >= 0) simIdle = false;
+  // Una sonda que termina despierta al loop, como el callback de lwIP
+  for (int i = 0; i < HAL_PROBE_SLOTS; i++) {
+    if (simProbes[i].active && (long)(simNow - simProbes[i].done_at) >= 0) simIdle = false;
+  }
+  return simIdle;
+}
+
+// Cambia una entrada y dispara su interrupcion como lo haria el hardware
+void simSetPin(uint8_t pin, bool high) {
+  simInitPins();
+  if (pin >= SIM_PIN_COUNT || simPins[pin] == high) return;
+  simPins[pin] = high;
+  if (simPinIsr[pin] != nullptr) simPinIsr[pin]();
+}
+
+void simSetTcpTarget(const char* host, uint16_t port, bool up, unsigned long rtt_ms) {
+  SimTcpTarget* target = findSimTcpTarget(host, port);
+  if (target == nullptr) {
+    if (simTcpTargetCount >= SIM_MAX_TCP_TARGETS) return;
+    target = &simTcpTargets[simTcpTargetCount++];
+    strlcpy(target->host, host, sizeof(target->host));
+    target->port = port;
+  }
+  target->up = up;
+  target->rtt_ms = rtt_ms;
+}
+
+void simSetProbeResponse(const char* host, uint16_t port, const char* response, unsigned long response_ms) {
+  SimTcpTarget* target = findSimTcpTarget(host, port);
+  if (target == nullptr) return;
+  strlcpy(target->response, response, sizeof(target->response));
+  target->response_ms = response_ms;
+}
+
+// Encola un datagrama como si llegara al puerto de latidos
+void simSendHeartbeat(const char* datagram) {
+  if (!simHeartbeatListening || simHeartbeatCount >= SIM_HEARTBEAT_QUEUE) return;
+  strlcpy(simHeartbeats[simHeartbeatCount++], datagram, sizeof(simHeartbeats[0]));
+}
+
+// Al cortarse la sesion el broker publica el Last Will
+void simSetMqttConnected(bool connected) {
+  if (simMqttConnected && !connected && simMqttWillTopic[0] != '\0') {
+    halLog("[sim] MQTT %s (retained, Last Will): %s\n", simMqttWillTopic, simMqttWillPayload);
+    simRecordPublish(simMqttWillTopic, simMqttWillPayload);
+  }
+  if (!connected) simMqttSubscriptionCount = 0;
+  simMqttConnected = connected;
+}
+
+size_t Print::write(const uint8_t* data, size_t size) {
+  for (size_t i = 0; i < size; i++) write(data[i]);
+  return size;
+}
+
+size_t Print::print(const char* str) {
+  return write((const uint8_t*)str, strlen(str));
+}
+
+size_t Print::print(char c) {
+  return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char value) {
+  return print((unsigned long)value);
+}
+
+size_t Print::print(int value) {
+  return print((long)value);
+}
+
+size_t Print::print(unsigned int value) {
+  return print((unsigned long)value);
+}
+
+size_t Print::print(long value) {
+  return printf("%ld", value);
+}
+
+size_t Print::print(unsigned long value) {
+  return printf("%lu", value);
+}
+
+size_t Print::print(long long value) {
+  return printf("%lld", value);
+}
+
+size_t Print::print(unsigned long long value) {
+  return printf("%llu", value);
+}
+
+size_t Print::print(double value, int digits) {
+  return printf("%.*f", digits, value);
+}
+
+size_t Print::printf(const char* format, ...) {
+  char buffer[64];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (n < 0) return 0;
+  return write((const uint8_t*)buffer, (size_t)n < sizeof(buffer) ? n : sizeof(buffer) - 1);
+}
+
+#endif
@@ -0,0 +1,153 @@
+#include "heartbeat.h"
+#include "metrics.h"
+#include "sha256.h"
+#include "watchdog.h"
+
+HeartbeatRecord heartbeatRecord = {};
+bool heartbeatRecordDirty = false;
+unsigned long heartbeatRecordSavedAt = 0;
+
+bool parseHeartbeat(const char* datagram, size_t len, const char* key, HeartbeatMessage& out) {
+  memset(&out, 0, sizeof(out));
+  size_t prefix_len = strlen(HEARTBEAT_PREFIX);
+  if (len <= prefix_len || strncmp(datagram, HEARTBEAT_PREFIX, prefix_len) != 0) return false;
+
+  // La firma es el ultimo campo: 64 digitos hex
+  const char* mac_hex = strrchr(datagram, ' ');
+  if (mac_hex == nullptr || (size_t)(datagram + len - (mac_hex + 1)) != SHA256_DIGEST_SIZE * 2) return false;
+  size_t signed_len = mac_hex - datagram;
+  mac_hex++;
+
+  // sender: hasta el proximo espacio, sin comillas ni controles (va a eventos JSON)
+  const char* p = datagram + prefix_len;
+  size_t sender_len = 0;
+  while (p[sender_len] != ' ' && p + sender_len < mac_hex) {
+    char c = p[sender_len];
+    if (c == '"' || c == '\\' || (uint8_t)c < 0x21) return false;
+    if (++sender_len >= sizeof(out.sender)) return false;
+  }
+  if (sender_len == 0) return false;
+  memcpy(out.sender, p, sender_len);
+  p += sender_len;
+
+  char* end;
+  out.seq = strtoull(p, &end, 10);
+  if (end == p || *end != ' ') return false;
+  p = end;
+  out.ts = strtoul(p, &end, 10);
+  if (end == p || end != datagram + signed_len) return false;
+
+  uint8_t mac[SHA256_DIGEST_SIZE];
+  char expected[SHA256_DIGEST_SIZE * 2 + 1];
+  hmacSha256((const uint8_t*)key, strlen(key), datagram, signed_len, mac);
+  toHex(mac, sizeof(mac), expected);
+  return constantTimeEquals(expected, mac_hex, SHA256_DIGEST_SIZE * 2);
+}
+
+void setupHeartbeatListener() {
+  // Sin clave no se aceptan latidos: el puerto queda cerrado
+  uint16_t port = config.heartbeat_key[0] != '\0' ? config.heartbeat_port : 0;
+  if (halHeartbeatBegin(port)) {
+    halLog("Latidos UDP: escuchando en el puerto %u\n", port);
+  } else if (port != 0) {
+    halLog("Latidos UDP: no se pudo abrir el puerto %u\n", port);
+  }
+}
+
+// Objetivo con sonda heartbeat cuyo host es el emisor, o -1
+int findHeartbeatTarget(const char* sender) {
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    if (config.probes[i].type == PROBE_HEARTBEAT && strcmp(config.targets[i].host, sender) == 0) return i;
+  }
+  return -1;
+}
+
+uint32_t heartbeatRecordCrc(const HeartbeatRecord& r) {
+  HeartbeatRecord copy = r;
+  copy.crc = 0;
+  return crc32Update(0, (const uint8_t*)&copy, sizeof(copy));
+}
+
+void setupHeartbeatRecord() {
+  heartbeatRecordDirty = false;
+  heartbeatRecordSavedAt = halMillis();
+  if (!halHeartbeatRecordLoad(&heartbeatRecord, sizeof(heartbeatRecord)) ||
+      heartbeatRecord.magic != HEARTBEAT_RECORD_MAGIC || heartbeatRecord.crc != heartbeatRecordCrc(heartbeatRecord)) {
+    memset(&heartbeatRecord, 0, sizeof(heartbeatRecord));
+  }
+}
+
+void saveHeartbeatRecord() {
+  if (!heartbeatRecordDirty) return;
+  heartbeatRecord.magic = HEARTBEAT_RECORD_MAGIC;
+  heartbeatRecord.crc = heartbeatRecordCrc(heartbeatRecord);
+  if (!halHeartbeatRecordSave(&heartbeatRecord, sizeof(heartbeatRecord))) {
+    halLog("Latidos UDP: no se pudo guardar el ultimo seq\n");
+  }
+  heartbeatRecordDirty = false;
+  heartbeatRecordSavedAt = halMillis();
+}
+
+// Entrada del emisor en el registro. Si no tiene, toma una libre o la de un
+// emisor que ya no es objetivo. nullptr si no hay lugar.
+HeartbeatSeqEntry* heartbeatSeqEntry(const char* sender) {
+  HeartbeatSeqEntry* free_entry = nullptr;
+  for (HeartbeatSeqEntry& e : heartbeatRecord.entries) {
+    if (strcmp(e.sender, sender) == 0) return &e;
+    if (free_entry == nullptr && (e.sender[0] == '\0' || findHeartbeatTarget(e.sender) < 0)) free_entry = &e;
+  }
+  if (free_entry != nullptr) {
+    strlcpy(free_entry->sender, sender, sizeof(free_entry->sender));
+    free_entry->seq = 0;
+  }
+  return free_entry;
+}
+
+void rejectHeartbeat(const char* reason, const char* sender) {
+  actionCounters.heartbeats_rejected++;
+  // Solo el primero de cada tanda: un emisor mal configurado no inunda el log
+  if (actionCounters.heartbeats_rejected % 100 == 1) {
+    halLog("Latido rechazado (%s) de %s [%lu rechazados]\n", reason, sender,
+           (unsigned long)actionCounters.heartbeats_rejected);
+  }
+}
+
+void checkHeartbeats() {
+  static char datagram[HEARTBEAT_MAX_DATAGRAM + 1];
+
+  for (int n = 0; n < HEARTBEAT_MAX_PER_LOOP; n++) {
+    int len = halHeartbeatReceive(datagram, sizeof(datagram));
+    if (len < 0) break;
+
+    HeartbeatMessage msg;
+    if (config.heartbeat_key[0] == '\0' || !parseHeartbeat(datagram, len, config.heartbeat_key, msg)) {
+      rejectHeartbeat("firma o formato invalido", "?");
+      continue;
+    }
+
+    int index = findHeartbeatTarget(msg.sender);
+    if (index < 0) {
+      rejectHeartbeat("emisor desconocido", msg.sender);
+      continue;
+    }
+
+    // seq estrictamente creciente, tambien entre reinicios: un datagrama
+    // capturado no se puede repetir
+    HeartbeatSeqEntry* last = heartbeatSeqEntry(msg.sender);
+    if (last == nullptr || (last->seq != 0 && msg.seq <= last->seq)) {
+      rejectHeartbeat("seq repetido", msg.sender);
+      continue;
+    }
+    last->seq = msg.seq;
+    heartbeatRecordDirty = true;
+    TargetState& st = targetStates[index];
+    st.heartbeat_seq = msg.seq;
+    st.heartbeat_ts = msg.ts;
+    actionCounters.heartbeats_ok++;
+    onHeartbeat(index);
+  }
+
+  if (heartbeatRecordDirty && halMillis() - heartbeatRecordSavedAt >= HEARTBEAT_SAVE_INTERVAL_MS) {
+    saveHeartbeatRecord();
+  }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// Latidos UDP (modo push). El host monitoreado manda cada pocos segundos
+//
+//   hb1 <sender> <seq> <ts> <hmac>
+//
+// donde hmac es HMAC-SHA256 en hex, con la clave config.heartbeat_key, de
+// todo lo anterior al ultimo espacio. seq debe crecer en cada datagrama (evita
+// repeticiones) y ts es el reloj del emisor (informativo: el watchdog no tiene
+// hora propia contra la cual compararlo). Un latido valido cuenta como
+// respuesta del objetivo con sonda "heartbeat" y host = sender.
+//
+// El ultimo seq de cada emisor se guarda en flash, asi un latido capturado
+// tampoco se acepta despues de un reinicio. Para no gastar la flash se guarda
+// como mucho una vez por minuto (y siempre antes de un reinicio programado):
+// tras un corte de luz o un cuelgue solo se podrian repetir los latidos del
+// ultimo minuto anterior.
+
+#include "config.h"
+
+#define HEARTBEAT_DEFAULT_PORT 4210
+#define HEARTBEAT_MAX_DATAGRAM 200
+#define HEARTBEAT_MAX_PER_LOOP 4       // Datagramas procesados por iteracion
+#define HEARTBEAT_PREFIX "hb1 "
+#define HEARTBEAT_RECORD_MAGIC 0x3142484FUL   // "OHB1"
+#define HEARTBEAT_SAVE_INTERVAL_MS 60000UL    // Guardado del ultimo seq en flash
+
+struct HeartbeatMessage {
+  char sender[64];
+  uint64_t seq;
+  uint32_t ts;
+};
+
+struct HeartbeatSeqEntry {
+  char sender[64];               // "" = libre
+  uint64_t seq;                  // Ultimo seq aceptado
+};
+
+struct HeartbeatRecord {
+  uint32_t magic;
+  uint32_t crc;
+  HeartbeatSeqEntry entries[MAX_WATCHDOG_TARGETS];
+};
+
+extern HeartbeatRecord heartbeatRecord;
+
+// Parsea y verifica la firma. false si el formato o el HMAC no son validos.
+bool parseHeartbeat(const char* datagram, size_t len, const char* key, HeartbeatMessage& out);
+// Abre (o cierra) el puerto segun la configuracion
+void setupHeartbeatListener();
+// Carga el ultimo seq de cada emisor (solo al arrancar)
+void setupHeartbeatRecord();
+// Guarda el ultimo seq de cada emisor si cambio (antes de reiniciar)
+void saveHeartbeatRecord();
+void checkHeartbeats();
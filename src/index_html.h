@@ -0,0 +1,215 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Pagina principal (estatica). Los valores de configuracion y estado se
+// cargan desde /api/config y /api/status, asi el HTML se sirve directo desde
+// flash sin armar Strings en RAM.
+const char INDEX_HTML[] PROGMEM = R"rawliteral(<!DOCTYPE html><html><head><meta charset='UTF-8'>
+<meta name='viewport' content='width=device-width, initial-scale=1.0'>
+<title>ATX Watchdog Config</title>
+<style>
+body{font-family:Arial,sans-serif;max-width:600px;margin:50px auto;padding:20px;background:#f0f0f0}
+h1{color:#333;text-align:center}
+.card{background:white;padding:20px;margin:20px 0;border-radius:8px;box-shadow:0 2px 4px rgba(0,0,0,0.1)}
+label{display:block;margin:10px 0 5px;font-weight:bold}
+input,select{width:100%;padding:8px;margin-bottom:10px;border:1px solid #ddd;border-radius:4px;box-sizing:border-box}
+button{background:#4CAF50;color:white;padding:10px 20px;border:none;border-radius:4px;cursor:pointer;width:100%;margin:5px 0}
+button:hover{background:#45a049}
+.danger{background:#f44336}.danger:hover{background:#da190b}
+.warning{background:#ff9800}.warning:hover{background:#e68900}
+table{width:100%;font-size:13px}td,th{text-align:left}
+</style></head><body>
+<h1>ATX Watchdog</h1>
+
+<form action='/save' method='POST'>
+<div class='card'><h2>Configuracion General</h2>
+<label>Hostname:</label><input name='hostname'>
+<label>Client ID:</label><input name='client_id'>
+<label>Grupos MQTT:</label><input name='mqtt_groups' placeholder='rack1,gpu'>
+</div>
+
+<div class='card'><h2>Red</h2>
+<p>Dejar la IP vacia para usar DHCP. Cambiar estos valores reinicia el equipo.</p>
+<label>IP fija:</label><input name='static_ip' placeholder='192.168.1.50'>
+<label>Gateway:</label><input name='static_gateway' placeholder='192.168.1.1'>
+<label>Mascara:</label><input name='static_mask' placeholder='255.255.255.0'>
+<label>DNS:</label><input name='static_dns' placeholder='(gateway)'>
+</div>
+
+<div class='card'><h2>Configuracion MQTT</h2>
+<label>MQTT Server:</label><input name='mqtt_server'>
+<label>MQTT Port:</label><input type='number' name='mqtt_port'>
+<label>MQTT User:</label><input name='mqtt_user'>
+<label>MQTT Password:</label><input type='password' name='mqtt_pass'>
+</div>
+
+<div class='card'><h2>Actualizacion OTA</h2>
+<p>Los pedidos de actualizacion (<code>POST /api/ota</code> o comando MQTT <code>ota</code>) se firman con esta clave, ver <code>ota_update.py</code>.</p>
+<label>Clave OTA (HMAC, sin clave = deshabilitado):</label><input type='password' name='ota_key' autocomplete='new-password'>
+<label>Clave OTA actual (para cambiarla o borrarla):</label><input type='password' name='ota_key_current' autocomplete='off'>
+<label><input type='checkbox' name='ota_key_clear' value='1' style='width:auto'> Borrar la clave OTA</label>
+</div>
+
+<div class='card'><h2>Ahorro de energia</h2>
+<p>Entre sondas el equipo espera al proximo vencimiento en vez de girar sin pausa (a lo sumo 250 ms, asi la web y MQTT siguen respondiendo). Los botones fisicos lo despiertan al instante.</p>
+<label>Modo:</label><select name='power_save_mode'><option value='0'>Siempre activo</option><option value='1'>Modem sleep</option><option value='2'>Light sleep</option></select>
+</div>
+
+<div class='card'><h2>Configuracion Botones</h2>
+<label>Power Click (ms):</label><input type='number' name='power_click_ms'>
+<label>Reset Click (ms):</label><input type='number' name='reset_click_ms'>
+</div>
+
+<div class='card'><h2>Watchdog TCP</h2>
+<label>Habilitar Watchdog:</label><input type='checkbox' name='watchdog_enabled' value='1' style='width:auto'>
+<p>Dejar el host vacio para deshabilitar un objetivo. Intervalos y timeout en ms. El intervalo es adaptativo: tras un fallo se sondea cada <b>Int. min</b> para confirmar la caida y con el objetivo sano se relaja hasta <b>Int. max</b>.</p>
+<p>Con accion <b>escalar</b> el timeout no se usa: se ejecutan los pasos de la escalera (reset, power, force_off, power_on) a los segundos sin respuesta indicados, p.ej. <code>reset:120,force_off:240,power_on:260</code>. Al terminar la escalera se espera el cooldown (s) y se reintenta hasta el maximo de intentos.</p>
+<p>Sonda: <b>tcp</b> solo conecta; <b>banner</b> espera que la respuesta empiece con el texto esperado (ej. <code>SSH-2.0</code>); <b>http</b> hace GET al path esperado y compara el status (0 = cualquiera menor a 400); <b>udp_echo</b> envia el texto esperado y espera el mismo eco. Degradado %: el objetivo se marca degradado si su RTT promedio supera ese porcentaje de su linea de base (0 = no detectar).</p>
+<p>Sonda <b>heartbeat</b>: no sale a la red, el host manda latidos UDP firmados (ver <code>heartbeat_sender.py</code>) con su nombre igual al Host del objetivo. Vence si no llega ninguno durante el intervalo.</p>
+<label>Puerto latidos UDP:</label><input type='number' name='heartbeat_port'>
+<label>Clave latidos (HMAC, sin clave = deshabilitado):</label><input type='password' name='heartbeat_key' autocomplete='new-password'>
+<label>Clave latidos actual (para cambiarla o borrarla):</label><input type='password' name='heartbeat_key_current' autocomplete='off'>
+<label><input type='checkbox' name='heartbeat_key_clear' value='1' style='width:auto'> Borrar la clave de latidos</label>
+<label>LED de power (D7):</label><select name='power_led_mode'><option value='0'>Sin sensor</option><option value='1'>Activo en LOW</option><option value='2'>Activo en HIGH</option></select>
+<table id='targets'></table>
+<button type='submit'>Guardar Configuracion</button>
+</div>
+</form>
+
+<div class='card'><h2>Control Manual</h2>
+<button class='warning' onclick='fetch("/power",{method:"POST"}).then(r=>alert(r.ok?"Power click enviado":"Pin ocupado"))'>POWER CLICK</button>
+<button class='danger' onclick='fetch("/reset",{method:"POST"}).then(r=>alert(r.ok?"Reset click enviado":"Pin ocupado"))'>RESET CLICK</button>
+</div>
+
+<div class='card' style='border:2px solid #f44336'><h2 style='color:#f44336'>Zona Peligrosa</h2>
+<p><b>Resetear WiFi:</b> Borra las credenciales WiFi guardadas y reinicia el ESP8266 en modo AP para reconfigurar.</p>
+<button class='danger' onclick='if(confirm("¿Estas seguro? Se perderan las credenciales WiFi")){fetch("/resetwifi",{method:"POST"}).then(()=>alert("WiFi reseteado. Reiniciando..."))}'>RESETEAR WiFi</button>
+</div>
+
+<div class='card'><h2>Estado</h2><div id='status'>Cargando...</div></div>
+
+<script>
+const ACTIONS=['power','reset','alerta','escalar'];
+const PROBES=['tcp','banner','http','udp_echo','heartbeat'];
+function q(n){return document.querySelector("[name='"+n+"']");}
+function el(tag,text){const e=document.createElement(tag);if(text!==undefined)e.textContent=text;return e;}
+function input(name,value,type){const e=el('input');e.name=name;e.value=value;if(type)e.type=type;return e;}
+function cell(row,child){const td=el('td');td.appendChild(child);row.appendChild(td);}
+function header(tbl,cols){const tr=el('tr');cols.forEach(c=>tr.appendChild(el('th',c)));tbl.appendChild(tr);}
+function para(box,label,value){const p=el('p');p.appendChild(el('b',label+': '));p.appendChild(document.createTextNode(value));box.appendChild(p);}
+
+fetch('/api/config').then(r=>r.json()).then(c=>{
+  ['hostname','client_id','mqtt_groups','static_ip','static_gateway','static_mask','static_dns','mqtt_server','mqtt_port','mqtt_user','mqtt_pass','power_click_ms','reset_click_ms','heartbeat_port'].forEach(k=>q(k).value=c[k]);
+  ['heartbeat_key','ota_key'].forEach(k=>q(k).placeholder=c[k+'_set']?'configurada (vacio = sin cambios)':'sin clave');
+  q('watchdog_enabled').checked=c.watchdog_enabled;
+  q('power_led_mode').value=c.power_led_mode;
+  q('power_save_mode').value=c.power_save_mode;
+  const tbl=document.getElementById('targets');
+  header(tbl,['Host','Puerto','Intervalo','Int. min','Int. max','Timeout','Accion','Escalera','Cooldown','Intentos','Sonda','Esperado','Status HTTP','Degradado %']);
+  c.targets.forEach((t,i)=>{
+    const tr=el('tr'),p='t'+i+'_';
+    cell(tr,input(p+'host',t.host));
+    cell(tr,input(p+'port',t.port,'number'));
+    cell(tr,input(p+'interval',t.interval_ms,'number'));
+    cell(tr,input(p+'min_interval',t.min_interval_ms,'number'));
+    cell(tr,input(p+'max_interval',t.max_interval_ms,'number'));
+    cell(tr,input(p+'timeout',t.timeout_ms,'number'));
+    const sel=el('select');sel.name=p+'action';
+    ACTIONS.forEach((a,v)=>{const o=el('option',a);o.value=v;o.selected=(v==t.action);sel.appendChild(o);});
+    cell(tr,sel);
+    const r=t.recovery;
+    cell(tr,input(p+'steps',r.steps.map(s=>s.action+':'+s.after_ms/1000).join(',')));
+    cell(tr,input(p+'cooldown',r.cooldown_ms/1000,'number'));
+    cell(tr,input(p+'attempts',r.max_attempts,'number'));
+    const ps=el('select');ps.name=p+'probe';
+    PROBES.forEach((a,v)=>{const o=el('option',a);o.value=v;o.selected=(a==t.probe.type);ps.appendChild(o);});
+    cell(tr,ps);
+    cell(tr,input(p+'match',t.probe.match));
+    cell(tr,input(p+'http_status',t.probe.http_status,'number'));
+    cell(tr,input(p+'degraded',t.probe.degraded_pct,'number'));
+    tbl.appendChild(tr);
+  });
+});
+
+// Estado: /api/status al cargar (y cada minuto para resincronizar); los
+// cambios llegan en vivo por SSE. Sin SSE se vuelve a consultar cada 5 s.
+let st=null,live=null,poll=null;
+const recent=[];
+function loadStatus(){
+  fetch('/api/status').then(r=>r.json()).then(s=>{
+    const now=Date.now();
+    s._at=now;
+    s.targets.forEach(t=>{t._check=now-t.last_check_s*1000;t._ok=now-t.last_ok_s*1000;});
+    st=s;
+    renderStatus();
+    if(!live&&!poll)startLive();
+  }).catch(()=>{});
+}
+function ago(ms){return 'hace '+Math.max(0,Math.round((Date.now()-ms)/1000))+'s';}
+function renderStatus(){
+  const s=st;
+  if(!s)return;
+  const box=document.getElementById('status');
+  box.textContent='';
+  para(box,'IP',s.ip);
+  para(box,'MQTT',s.mqtt?'Conectado':'Desconectado');
+  para(box,'Topic CMD','/watchdog/'+s.client_id+'/cmd');
+  para(box,'Topic Status','/watchdog/'+s.client_id+'/status');
+  if(s.mqtt_groups)para(box,'Grupos',s.mqtt_groups);
+  para(box,'Uptime',Math.round(s.uptime+(Date.now()-s._at)/1000)+'s');
+  para(box,'Heap libre',s.heap_free+' bytes');
+  para(box,'Energia',s.power_save.mode+', CPU activo '+s.power_save.duty_pct+'%, ~'+s.power_save.est_ma+' mA (estimado)');
+  para(box,'Arranque',(s.boot.path=='fast'?'rapido':'WiFiManager')+', IP a los '+s.boot.wifi_ip_ms+' ms, MQTT a los '+s.boot.mqtt_connected_ms+' ms');
+  para(box,'Actualizacion',live&&live.readyState==1?'en vivo':'cada 5 s');
+  para(box,'Watchdog',s.watchdog_enabled?'Habilitado':'Deshabilitado');
+  if(s.power!==null)para(box,'Equipo',s.power=='on'?'Encendido':'Apagado');
+  if(s.watchdog_enabled){
+    const tbl=el('table');
+    header(tbl,['Objetivo','Ult. chequeo','Ult. OK','Intervalo','RTT','Respuesta (prom/p95)','Fallos','Accion']);
+    s.targets.forEach(t=>{
+      const tr=el('tr');
+      const action=t.recovery&&t.recovery!='-'?t.action+' ('+t.recovery+', paso '+t.recovery_step+', intento '+t.recovery_attempts+')':t.action;
+      const resp=t.probe+' '+t.response_avg_ms+'/'+t.response_p95_ms+' ms'+(t.degraded?' DEGRADADO':'');
+      [t.host+':'+t.port,ago(t._check),ago(t._ok),t.interval_ms/1000+'s',t.rtt_ms+' ms',resp,t.failures,action].forEach(v=>tr.appendChild(el('td',v)));
+      tbl.appendChild(tr);
+    });
+    box.appendChild(tbl);
+  }
+  if(recent.length){
+    const ul=el('ul');
+    recent.forEach(e=>ul.appendChild(el('li',e)));
+    box.appendChild(el('b','Ultimos eventos'));
+    box.appendChild(ul);
+  }
+}
+function startLive(){
+  if(!window.EventSource){poll=setInterval(loadStatus,5000);return;}
+  live=new EventSource('http://'+location.hostname+':'+st.live_port+'/events');
+  live.addEventListener('probe',m=>{
+    const u=JSON.parse(m.data),now=Date.now();
+    const t=st.targets.find(x=>x.index==u.index);
+    if(!t)return;
+    Object.assign(t,u);
+    t._check=now-u.last_check_s*1000;t._ok=now-u.last_ok_s*1000;
+    renderStatus();
+  });
+  live.addEventListener('mqtt',m=>{st.mqtt=JSON.parse(m.data).connected;renderStatus();});
+  live.addEventListener('event',m=>{
+    const e=JSON.parse(m.data);
+    recent.unshift(new Date().toLocaleTimeString()+' '+e.event+(e.host?' '+e.host:''));
+    if(recent.length>10)recent.pop();
+    renderStatus();
+  });
+  live.onopen=()=>{loadStatus();};
+  live.onerror=()=>{
+    // Servidor lleno o sin respuesta: se cae a consultas periodicas
+    if(live.readyState==2){live=null;poll=setInterval(loadStatus,5000);renderStatus();}
+  };
+}
+loadStatus();
+setInterval(renderStatus,5000);
+setInterval(loadStatus,60000);
+</script>
+</body></html>
+)rawliteral";
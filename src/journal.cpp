@@ -0,0 +1,144 @@
+#include "journal.h"
+#include "config.h"
+
+const char* const JOURNAL_TYPE_NAMES[JOURNAL_TYPE_COUNT] = {
+  "boot", "config", "click", "button", "watchdog_timeout", "recovery_step",
+  "recovery_exhausted", "recovery_succeeded", "target_down", "target_up",
+  "probe_degraded", "probe_normal", "mqtt_connected", "ota_started", "ota_installed",
+  "ota_failed", "ota_confirmed", "ota_rollback",
+};
+
+uint32_t journalBoot = 0;
+bool journalReady = false;
+uint32_t journalNextSeq = 1;
+
+// Registros todavia en RAM: seq consecutivos desde journalPending[0]
+JournalRecord journalPending[JOURNAL_BATCH];
+int journalPendingCount = 0;
+unsigned long journalPendingSince = 0;
+
+const char* journalTypeName(uint8_t type) {
+  return type < JOURNAL_TYPE_COUNT ? JOURNAL_TYPE_NAMES[type] : "?";
+}
+
+uint32_t journalRecordCrc(const JournalRecord& r) {
+  JournalRecord copy = r;
+  copy.crc = 0;
+  return crc32Update(0, (const uint8_t*)&copy, sizeof(copy));
+}
+
+bool journalRecordValid(const JournalRecord& r) {
+  return r.seq != 0 && r.crc == journalRecordCrc(r);
+}
+
+size_t journalOffset(uint32_t seq) {
+  return (size_t)(seq % JOURNAL_CAPACITY) * sizeof(JournalRecord);
+}
+
+void setupJournal() {
+  journalReady = halJournalOpen(JOURNAL_CAPACITY * sizeof(JournalRecord));
+  if (!journalReady) {
+    halLog("Diario: no se pudo abrir el almacenamiento\n");
+    return;
+  }
+
+  // Un solo recorrido al arrancar: el registro valido de mayor seq es la cabeza
+  uint32_t last_seq = 0;
+  uint32_t last_boot = 0;
+  JournalRecord r;
+  for (uint32_t i = 0; i < JOURNAL_CAPACITY; i++) {
+    if (!halJournalRead(i * sizeof(JournalRecord), &r, sizeof(r)) || !journalRecordValid(r)) continue;
+    if (r.seq > last_seq) {
+      last_seq = r.seq;
+      last_boot = r.boot;
+    }
+  }
+  journalNextSeq = last_seq + 1;
+  journalBoot = last_boot + 1;
+  halLog("Diario: %lu registros previos, arranque #%lu\n", (unsigned long)last_seq,
+         (unsigned long)journalBoot);
+}
+
+void journalAppend(uint8_t type, uint8_t target, uint16_t code, uint32_t value, const char* detail) {
+  if (!journalReady) return;
+  if (journalPendingCount == JOURNAL_BATCH) journalFlush();
+
+  JournalRecord& r = journalPending[journalPendingCount];
+  memset(&r, 0, sizeof(r));
+  r.seq = journalNextSeq++;
+  r.boot = journalBoot;
+  r.uptime_ms = halMillis();
+  r.type = type;
+  r.target = target;
+  r.code = code;
+  r.value = value;
+  if (detail != nullptr) {
+    // Se copia ya apto para JSON: formatJournalRecord no necesita escapar
+    for (size_t i = 0; i < sizeof(r.detail) - 1 && detail[i] != '\0'; i++) {
+      char c = detail[i];
+      r.detail[i] = (c == '"' || c == '\\' || (uint8_t)c < 0x20) ? '?' : c;
+    }
+  }
+  r.crc = journalRecordCrc(r);
+
+  if (journalPendingCount++ == 0) journalPendingSince = halMillis();
+  if (journalPendingCount == JOURNAL_BATCH) journalFlush();
+}
+
+void journalLoop() {
+  if (journalPendingCount > 0 && halMillis() - journalPendingSince >= JOURNAL_FLUSH_INTERVAL_MS) {
+    journalFlush();
+  }
+}
+
+void journalFlush() {
+  if (!journalReady || journalPendingCount == 0) return;
+
+  // Los pendientes son consecutivos: a lo sumo dos escrituras (si dan la vuelta)
+  int first = 0;
+  while (first < journalPendingCount) {
+    uint32_t seq = journalPending[first].seq;
+    int run = JOURNAL_CAPACITY - seq % JOURNAL_CAPACITY;
+    if (run > journalPendingCount - first) run = journalPendingCount - first;
+    if (!halJournalWrite(journalOffset(seq), &journalPending[first], run * sizeof(JournalRecord))) {
+      halLog("Diario: error escribiendo %d registros\n", run);
+    }
+    first += run;
+  }
+  journalPendingCount = 0;
+}
+
+uint32_t journalLastSeq() {
+  return journalNextSeq - 1;
+}
+
+uint32_t journalFirstSeq() {
+  return journalNextSeq > JOURNAL_CAPACITY ? journalNextSeq - JOURNAL_CAPACITY : 1;
+}
+
+bool journalRead(uint32_t seq, JournalRecord& out) {
+  if (!journalReady || seq < journalFirstSeq() || seq > journalLastSeq()) return false;
+
+  if (journalPendingCount > 0 && seq >= journalPending[0].seq) {
+    out = journalPending[seq - journalPending[0].seq];
+    return true;
+  }
+  return halJournalRead(journalOffset(seq), &out, sizeof(out)) && journalRecordValid(out) && out.seq == seq;
+}
+
+int formatJournalRecord(const JournalRecord& r, char* out, size_t size) {
+  int n = snprintf(out, size, "{\"seq\":%lu,\"boot\":%lu,\"uptime_ms\":%lu,\"type\":\"%s\",",
+                   (unsigned long)r.seq, (unsigned long)r.boot, (unsigned long)r.uptime_ms,
+                   journalTypeName(r.type));
+  if (r.target == JOURNAL_NO_TARGET) {
+    n += snprintf(out + n, size - n, "\"target\":null");
+  } else {
+    n += snprintf(out + n, size - n, "\"target\":%u", r.target);
+  }
+  char detail[JOURNAL_DETAIL_SIZE];
+  memcpy(detail, r.detail, sizeof(detail) - 1);
+  detail[sizeof(detail) - 1] = '\0';
+  n += snprintf(out + n, size - n, ",\"code\":%u,\"value\":%lu,\"detail\":\"%s\"}",
+                r.code, (unsigned long)r.value, detail);
+  return n;
+}
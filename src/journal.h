@@ -0,0 +1,75 @@
+#pragma once
+
+// Diario persistente de eventos en LittleFS, para reconstruir un incidente
+// despues de que paso. Registros de 64 bytes en un anillo preasignado:
+// cada registro va siempre al mismo offset (seq % JOURNAL_CAPACITY), asi el
+// archivo no crece ni se reescribe entero. Los registros se juntan en RAM y
+// se bajan a flash de a JOURNAL_BATCH, cada JOURNAL_FLUSH_INTERVAL_MS o antes
+// de un reinicio: una sonda que falla no toca la flash en cada intento.
+//
+// Cada registro lleva el numero de arranque (boot) y los ms desde ese
+// arranque. code, value y detail dependen del tipo (ver README).
+
+#include "hal.h"
+
+#define JOURNAL_CAPACITY 512               // 32 KB en flash
+#define JOURNAL_BATCH 8                    // Registros en RAM antes de escribir
+#define JOURNAL_FLUSH_INTERVAL_MS 60000UL  // Maximo que un registro espera en RAM
+#define JOURNAL_DETAIL_SIZE 40
+#define JOURNAL_JSON_SIZE 192              // Un registro formateado como JSON
+#define JOURNAL_TAIL_DEFAULT 10            // Registros del comando MQTT "journal"
+#define JOURNAL_TAIL_MAX 20
+#define JOURNAL_NO_TARGET 0xFF
+
+enum JournalType {
+  JOURNAL_BOOT = 0,
+  JOURNAL_CONFIG,
+  JOURNAL_CLICK,
+  JOURNAL_BUTTON,
+  JOURNAL_WATCHDOG_TIMEOUT,
+  JOURNAL_RECOVERY_STEP,
+  JOURNAL_RECOVERY_EXHAUSTED,
+  JOURNAL_RECOVERY_SUCCEEDED,
+  JOURNAL_TARGET_DOWN,
+  JOURNAL_TARGET_UP,
+  JOURNAL_PROBE_DEGRADED,
+  JOURNAL_PROBE_NORMAL,
+  JOURNAL_MQTT_CONNECTED,
+  JOURNAL_OTA_STARTED,
+  JOURNAL_OTA_INSTALLED,
+  JOURNAL_OTA_FAILED,
+  JOURNAL_OTA_CONFIRMED,
+  JOURNAL_OTA_ROLLBACK,
+  JOURNAL_TYPE_COUNT
+};
+
+struct JournalRecord {
+  uint32_t seq;          // Creciente en toda la vida del diario (0 = slot vacio)
+  uint32_t boot;
+  uint32_t uptime_ms;
+  uint8_t type;          // JournalType
+  uint8_t target;        // Indice del objetivo o JOURNAL_NO_TARGET
+  uint16_t code;
+  uint32_t value;
+  char detail[JOURNAL_DETAIL_SIZE];
+  uint32_t crc;          // CRC32 del registro con crc = 0
+};
+
+static_assert(sizeof(JournalRecord) == 64, "registro del diario de 64 bytes");
+
+extern uint32_t journalBoot;
+
+// Abre (o crea) el archivo y ubica el ultimo registro
+void setupJournal();
+// detail puede ser nullptr. Comillas, barras y controles se reemplazan por '?'
+void journalAppend(uint8_t type, uint8_t target, uint16_t code, uint32_t value, const char* detail);
+// Baja a flash lo pendiente si paso JOURNAL_FLUSH_INTERVAL_MS
+void journalLoop();
+void journalFlush();
+// Rango de seq disponibles (puede haber huecos si un registro no valida)
+uint32_t journalFirstSeq();
+uint32_t journalLastSeq();
+bool journalRead(uint32_t seq, JournalRecord& out);
+const char* journalTypeName(uint8_t type);
+// {"seq":..,"boot":..,"uptime_ms":..,"type":"..","target":..,"code":..,"value":..,"detail":".."}
+int formatJournalRecord(const JournalRecord& r, char* out, size_t size);
@@ -5,67 +5,85 @@
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
 #include <LittleFS.h>
-
-// Pines GPIO - Salidas (conectar a motherboard)
-#define POWER_PIN D1  // GPIO5 - Output para boton POWER
-#define RESET_PIN D2  // GPIO4 - Output para boton RESET
-
-// Pines GPIO - Entradas (botones fisicos en el watchdog)
-#define POWER_BUTTON_PIN D5  // GPIO14 - Input para boton POWER fisico
-#define RESET_BUTTON_PIN D6  // GPIO12 - Input para boton RESET fisico
-
-// Archivo de configuracion
-#define CONFIG_FILE "/config.json"
-
-// Estructura de configuracion
-struct Config {
-  char hostname[32];
-  char mqtt_server[64];
-  int mqtt_port;
-  char mqtt_user[32];
-  char mqtt_pass[32];
-  char client_id[32];
-  int power_click_ms;
-  int reset_click_ms;
-  int watchdog_timeout_ms;
-  char watchdog_host[64];
-  int watchdog_port;
-  int watchdog_check_interval_ms;
-  bool watchdog_enabled;
+#include "index_html.h"
+#include "hal.h"
+#include "config.h"
+#include "metrics.h"
+#include "pulses.h"
+#include "buttons.h"
+#include "watchdog.h"
+#include "commands.h"
+#include "events.h"
+#include "heartbeat.h"
+#include "mqtt_link.h"
+#include "journal.h"
+#include "ota.h"
+#include "powersave.h"
+#include "app_loop.h"
+#include "render.h"
+
+// Conexion WiFi rapida (sin escaneo) usando BSSID/canal del ultimo arranque
+#define FAST_CONNECT_FILE "/wifi_fast.bin"
+#define FAST_CONNECT_RTC_OFFSET 64      // Bloques de 4 bytes; los primeros los usa eboot (OTA)
+#define FAST_CONNECT_ATTEMPTS 2
+#define FAST_CONNECT_TIMEOUT_MS 4000
+
+// Paquete MQTT maximo: un comando ota (url + hash + firma) no entra en los
+// 256 bytes por defecto de PubSubClient
+#define MQTT_BUFFER_SIZE 512
+
+// Respuestas HTTP en streaming
+#define WEB_CHUNK_SIZE 256             // Buffer fijo por respuesta chunked
+
+// Archivos de configuracion. La configuracion se guarda como registro
+// binario (cabecera + Config) en dos copias A/B; el JSON solo se usa para
+// migrar configuraciones viejas y para importar/exportar desde la API web.
+#define CONFIG_FILE "/config.json"        // Formato anterior (solo migracion)
+#define CONFIG_FILE_A "/config.a.bin"
+#define CONFIG_FILE_B "/config.b.bin"
+#define CONFIG_FILE_TMP "/config.tmp"
+
+// Ultimo AP al que se asocio el equipo. Se guarda en memoria RTC (sobrevive
+// reinicios por software/OTA) y en flash (sobrevive cortes de energia).
+struct FastConnectRecord {
+  uint32_t crc;       // CRC32 del resto del registro
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t reserved;
 };
 
 // Variables globales
-Config config;
+WiFiEventHandler wifiConnectedHandler;
+WiFiEventHandler wifiGotIpHandler;
+uint32_t configSequence = 0;           // Secuencia del ultimo registro valido
+int configActiveSlot = -1;             // Copia con el registro vigente (0=A, 1=B)
+const char* const CONFIG_SLOT_FILES[2] = { CONFIG_FILE_A, CONFIG_FILE_B };
 WiFiClient espClient;
 PubSubClient mqttClient(espClient);
 ESP8266WebServer server(80);
 
-unsigned long lastMqttKeepalive = 0;
-unsigned long lastWatchdogCheck = 0;
-unsigned long lastWatchdogSuccess = 0;
-const unsigned long MQTT_KEEPALIVE_INTERVAL = 60000; // 60 segundos
-int consecutiveWatchdogFailures = 0;
-
-// Variables para botones fisicos
-unsigned long lastPowerButtonPress = 0;
-unsigned long lastResetButtonPress = 0;
-const unsigned long BUTTON_DEBOUNCE_MS = 300; // Debounce de 300ms
+// ETag de la pagina principal (hash de INDEX_HTML, calculado al arrancar)
+char indexEtag[12] = "";
 
 // Funciones adelantadas
 void loadConfig();
 void saveConfig();
+bool fastConnectWiFi();
+void saveFastConnectRecord();
+void applyStaticIpConfig();
 void setupWebServer();
 void handleRoot();
+void handleApiStatus();
+void handleApiConfig();
+void handleApiEvents();
+void handleApiOta();
 void handleSaveConfig();
 void handleClickPower();
 void handleClickReset();
-void clickButton(int pin, int duration_ms);
-void mqttCallback(char* topic, byte* payload, unsigned int length);
-void reconnectMqtt();
-void publishKeepalive();
-void checkTcpWatchdog();
-bool testTcpConnection(const char* host, int port, int timeout_ms);
-void checkPhysicalButtons();
+void handleMetrics();
+uint8_t commitConfig(const Config& previous);
+void handleApiConfigImport();
+void applyConfigChanges(const Config& previous, uint8_t changes);
 
 void setup() {
   Serial.begin(115200);
@@ -84,10 +102,12 @@ void setup() {
   // Configurar pines de entrada con pull-up interno
   pinMode(POWER_BUTTON_PIN, INPUT_PULLUP);
   pinMode(RESET_BUTTON_PIN, INPUT_PULLUP);
+  pinMode(POWER_LED_PIN, INPUT_PULLUP);
+  setupPhysicalButtons();
 
   Serial.println("GPIOs configurados:");
   Serial.println("  Salidas: D1=Power, D2=Reset");
-  Serial.println("  Entradas: D5=Power Button, D6=Reset Button");
+  Serial.println("  Entradas: D5=Power Button, D6=Reset Button, D7=Power LED");
 
   // Inicializar LittleFS
   if (!LittleFS.begin()) {
@@ -96,32 +116,62 @@ void setup() {
   }
   Serial.println("LittleFS montado correctamente");
 
+  // Diario de eventos: el arranque (motivo del reset y, si fue una
+  // excepcion, su causa) se escribe enseguida, asi queda registrado aunque
+  // el equipo se reinicie otra vez en segundos
+  setupJournal();
+  const rst_info* resetInfo = ESP.getResetInfoPtr();
+  journalAppend(JOURNAL_BOOT, JOURNAL_NO_TARGET, resetInfo->reason, resetInfo->exccause,
+                ESP.getResetReason().c_str());
+  journalFlush();
+
+  // Imagen instalada por OTA: chequeo de salud (o rollback si no arranca bien)
+  setupOta();
+
   // Cargar configuracion
   loadConfig();
 
-  // WiFiManager - Configuracion inicial
-  WiFiManager wifiManager;
-  wifiManager.setConfigPortalTimeout(180); // 3 minutos timeout
-
-  // Mejorar deteccion de portal captivo
-  wifiManager.setAPCallback([](WiFiManager *myWiFiManager) {
-    Serial.println("\n========================================");
-    Serial.println("MODO PORTAL CAPTIVO ACTIVADO");
-    Serial.println("========================================");
-    Serial.println("SSID: ATX-Watchdog-Setup");
-    Serial.println("IP: 192.168.4.1");
-    Serial.println("\nConectate al WiFi y abre:");
-    Serial.println("  http://192.168.4.1");
-    Serial.println("========================================\n");
+  // Registrar los hitos del arranque
+  wifiConnectedHandler = WiFi.onStationModeConnected([](const WiFiEventStationModeConnected&) {
+    if (bootTimeline.wifi_associated == 0) bootTimeline.wifi_associated = millis();
+  });
+  wifiGotIpHandler = WiFi.onStationModeGotIP([](const WiFiEventStationModeGotIP&) {
+    if (bootTimeline.wifi_ip == 0) bootTimeline.wifi_ip = millis();
   });
 
-  Serial.println("Conectando a WiFi...");
-  if (!wifiManager.autoConnect("ATX-Watchdog-Setup")) {
-    Serial.println("Fallo al conectar WiFi. Reiniciando...");
-    delay(3000);
-    ESP.restart();
+  applyStaticIpConfig();
+
+  // Camino rapido: reconectar al ultimo AP conocido sin escanear
+  bootTimeline.fast_path = fastConnectWiFi();
+  if (!bootTimeline.fast_path) {
+    // WiFiManager - Configuracion inicial
+    WiFiManager wifiManager;
+    wifiManager.setConfigPortalTimeout(180); // 3 minutos timeout
+
+    // Mejorar deteccion de portal captivo
+    wifiManager.setAPCallback([](WiFiManager *myWiFiManager) {
+      Serial.println("\n========================================");
+      Serial.println("MODO PORTAL CAPTIVO ACTIVADO");
+      Serial.println("========================================");
+      Serial.println("SSID: ATX-Watchdog-Setup");
+      Serial.println("IP: 192.168.4.1");
+      Serial.println("\nConectate al WiFi y abre:");
+      Serial.println("  http://192.168.4.1");
+      Serial.println("========================================\n");
+    });
+
+    Serial.println("Conectando a WiFi...");
+    if (!wifiManager.autoConnect("ATX-Watchdog-Setup")) {
+      Serial.println("Fallo al conectar WiFi. Reiniciando...");
+      journalFlush();
+      delay(3000);
+      ESP.restart();
+    }
   }
 
+  // Recordar BSSID/canal para el proximo arranque
+  saveFastConnectRecord();
+
   Serial.println("WiFi conectado!");
   Serial.print("IP: ");
   Serial.println(WiFi.localIP());
@@ -131,14 +181,31 @@ void setup() {
     WiFi.hostname(config.hostname);
   }
 
-  // Configurar MQTT
-  mqttClient.setServer(config.mqtt_server, config.mqtt_port);
+  // Configurar MQTT (el servidor se fija con el IP que resuelve mqtt_link)
   mqttClient.setCallback(mqttCallback);
+  mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
+  mqttClient.setSocketTimeout((MQTT_CONNECT_TIMEOUT_MS + 999) / 1000);
+  espClient.setTimeout(MQTT_CONNECT_TIMEOUT_MS);
+
+  // Repartir las sondas de los objetivos a lo largo del intervalo
+  scheduleWatchdogTargets();
+  setupHeartbeatRecord();
+  setupHeartbeatListener();
+  setupPowerSave();
 
   // Iniciar webserver
+  // Sin keep-alive: ESP8266WebServer atiende un cliente a la vez y una
+  // conexion abierta bloquearia a los demas hasta su timeout (5 s)
   setupWebServer();
   server.begin();
   Serial.println("Servidor web iniciado en puerto 80");
+  if (halSseBegin(LIVE_PORT)) {
+    Serial.printf("Estado en vivo (SSE) en http://%s:%d/events\n", WiFi.localIP().toString().c_str(), LIVE_PORT);
+  }
+
+  Serial.printf("Arranque (%s): asociado %lu ms, IP %lu ms, listo %lu ms\n",
+                bootTimeline.fast_path ? "rapido" : "WiFiManager",
+                bootTimeline.wifi_associated, bootTimeline.wifi_ip, millis());
 
   Serial.println("\n=================================");
   Serial.println("Sistema listo!");
@@ -146,51 +213,40 @@ void setup() {
 }
 
 void loop() {
-  // Chequear botones fisicos
-  checkPhysicalButtons();
-
-  // Manejar servidor web
-  server.handleClient();
+  appLoop();
+}
 
-  // Mantener conexion MQTT
-  if (!mqttClient.connected()) {
-    reconnectMqtt();
+// Lee una copia del registro binario sobre out, que debe venir con los
+// valores por defecto (un registro de una version anterior es mas corto y
+// deja el resto en default). Si devuelve false, out queda inutilizable.
+bool readConfigRecord(const char* path, Config& out, uint32_t& sequence) {
+  File file = LittleFS.open(path, "r");
+  if (!file) return false;
+
+  ConfigHeader header;
+  bool ok = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+            header.magic == CONFIG_MAGIC &&
+            header.version >= 1 && header.version <= CONFIG_SCHEMA_VERSION &&
+            header.size > 0 && header.size <= sizeof(Config);
+  if (ok) {
+    ok = file.read((uint8_t*)&out, header.size) == header.size &&
+         configRecordCrc(header, out) == header.crc;
   }
-  mqttClient.loop();
+  file.close();
 
-  // Enviar keepalive MQTT
-  unsigned long now = millis();
-  if (now - lastMqttKeepalive > MQTT_KEEPALIVE_INTERVAL) {
-    publishKeepalive();
-    lastMqttKeepalive = now;
+  if (!ok) {
+    Serial.printf("Registro de configuracion invalido: %s\n", path);
+    return false;
   }
 
-  // Verificar watchdog TCP
-  checkTcpWatchdog();
+  sequence = header.sequence;
+  return true;
 }
 
-void loadConfig() {
-  // Valores por defecto
-  strcpy(config.hostname, "atx-watchdog");
-  strcpy(config.mqtt_server, "");
-  config.mqtt_port = 1883;
-  strcpy(config.mqtt_user, "");
-  strcpy(config.mqtt_pass, "");
-  strcpy(config.client_id, "watchdog-001");
-  config.power_click_ms = 200;
-  config.reset_click_ms = 200;
-  config.watchdog_timeout_ms = 120000; // 2 minutos
-  strcpy(config.watchdog_host, "");
-  config.watchdog_port = 22;
-  config.watchdog_check_interval_ms = 30000; // 30 segundos
-  config.watchdog_enabled = false;
-
+// Migra el config.json del formato anterior al registro binario
+bool migrateJsonConfig() {
   File file = LittleFS.open(CONFIG_FILE, "r");
-  if (!file) {
-    Serial.println("Config no encontrado, usando valores por defecto");
-    saveConfig(); // Guardar defaults
-    return;
-  }
+  if (!file) return false;
 
   JsonDocument doc;
   DeserializationError error = deserializeJson(doc, file);
@@ -198,373 +254,593 @@ void loadConfig() {
 
   if (error) {
     Serial.println("Error parseando config JSON");
+    return false;
+  }
+
+  configFromJson(doc.as<JsonVariantConst>(), config);
+  saveConfig();
+  LittleFS.rename(CONFIG_FILE, CONFIG_FILE ".bak");
+  Serial.println("Configuracion JSON migrada a formato binario");
+  return true;
+}
+
+void loadConfig() {
+  unsigned long start = micros();
+  static Config candidate; // Static: evita ~1KB de stack y cualquier malloc
+
+  // Valores por defecto
+  setDefaultConfig(config);
+
+  // Elegir la copia valida mas reciente entre A y B
+  uint32_t seqA = 0, seqB = 0;
+  setDefaultConfig(candidate);
+  bool validA = readConfigRecord(CONFIG_FILE_A, candidate, seqA);
+  if (validA) {
+    config = candidate;
+    configSequence = seqA;
+    configActiveSlot = 0;
+  }
+
+  setDefaultConfig(candidate);
+  bool validB = readConfigRecord(CONFIG_FILE_B, candidate, seqB);
+  if (validB && (!validA || (int32_t)(seqB - seqA) > 0)) {
+    config = candidate;
+    configSequence = seqB;
+    configActiveSlot = 1;
+  }
+
+  if (configActiveSlot >= 0) {
+    // Registros de versiones anteriores pueden traer hosts sin validar
+    for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+      sanitizeTarget(config.targets[i]);
+      sanitizeRecovery(config.recovery[i]);
+      sanitizeProbeSettings(config.probes[i]);
+      sanitizeSchedule(config.schedules[i], config.targets[i]);
+    }
+    Serial.printf("Configuracion cargada desde %s (seq %lu) en %lu us\n",
+                  CONFIG_SLOT_FILES[configActiveSlot], (unsigned long)configSequence, micros() - start);
     return;
   }
 
-  strlcpy(config.hostname, doc["hostname"] | "atx-watchdog", sizeof(config.hostname));
-  strlcpy(config.mqtt_server, doc["mqtt_server"] | "", sizeof(config.mqtt_server));
-  config.mqtt_port = doc["mqtt_port"] | 1883;
-  strlcpy(config.mqtt_user, doc["mqtt_user"] | "", sizeof(config.mqtt_user));
-  strlcpy(config.mqtt_pass, doc["mqtt_pass"] | "", sizeof(config.mqtt_pass));
-  strlcpy(config.client_id, doc["client_id"] | "watchdog-001", sizeof(config.client_id));
-  config.power_click_ms = doc["power_click_ms"] | 200;
-  config.reset_click_ms = doc["reset_click_ms"] | 200;
-  config.watchdog_timeout_ms = doc["watchdog_timeout_ms"] | 120000;
-  strlcpy(config.watchdog_host, doc["watchdog_host"] | "", sizeof(config.watchdog_host));
-  config.watchdog_port = doc["watchdog_port"] | 22;
-  config.watchdog_check_interval_ms = doc["watchdog_check_interval_ms"] | 30000;
-  config.watchdog_enabled = doc["watchdog_enabled"] | false;
-
-  Serial.println("Configuracion cargada desde archivo");
+  if (migrateJsonConfig()) return;
+
+  Serial.println("Config no encontrado, usando valores por defecto");
+  saveConfig(); // Guardar defaults
 }
 
+// Escribe el registro en un archivo temporal y lo renombra sobre la copia
+// A/B mas vieja, asi un corte de energia a mitad de escritura deja intacta
+// la ultima configuracion valida.
 void saveConfig() {
-  JsonDocument doc;
-
-  doc["hostname"] = config.hostname;
-  doc["mqtt_server"] = config.mqtt_server;
-  doc["mqtt_port"] = config.mqtt_port;
-  doc["mqtt_user"] = config.mqtt_user;
-  doc["mqtt_pass"] = config.mqtt_pass;
-  doc["client_id"] = config.client_id;
-  doc["power_click_ms"] = config.power_click_ms;
-  doc["reset_click_ms"] = config.reset_click_ms;
-  doc["watchdog_timeout_ms"] = config.watchdog_timeout_ms;
-  doc["watchdog_host"] = config.watchdog_host;
-  doc["watchdog_port"] = config.watchdog_port;
-  doc["watchdog_check_interval_ms"] = config.watchdog_check_interval_ms;
-  doc["watchdog_enabled"] = config.watchdog_enabled;
-
-  File file = LittleFS.open(CONFIG_FILE, "w");
+  ConfigHeader header;
+  header.magic = CONFIG_MAGIC;
+  header.version = CONFIG_SCHEMA_VERSION;
+  header.size = sizeof(Config);
+  header.sequence = configSequence + 1;
+  header.crc = configRecordCrc(header, config);
+
+  File file = LittleFS.open(CONFIG_FILE_TMP, "w");
   if (!file) {
     Serial.println("Error abriendo archivo config para escritura");
     return;
   }
 
-  serializeJson(doc, file);
+  bool ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+            file.write((const uint8_t*)&config, sizeof(Config)) == sizeof(Config);
   file.close();
-  Serial.println("Configuracion guardada");
-}
 
-void handleResetWiFi();
-
-void setupWebServer() {
-  server.on("/", handleRoot);
-  server.on("/save", HTTP_POST, handleSaveConfig);
-  server.on("/power", HTTP_POST, handleClickPower);
-  server.on("/reset", HTTP_POST, handleClickReset);
-  server.on("/resetwifi", HTTP_POST, handleResetWiFi);
-}
-
-void handleRoot() {
-  String html = "<!DOCTYPE html><html><head><meta charset='UTF-8'>";
-  html += "<meta name='viewport' content='width=device-width, initial-scale=1.0'>";
-  html += "<title>ATX Watchdog Config</title>";
-  html += "<style>";
-  html += "body{font-family:Arial,sans-serif;max-width:600px;margin:50px auto;padding:20px;background:#f0f0f0}";
-  html += "h1{color:#333;text-align:center}";
-  html += ".card{background:white;padding:20px;margin:20px 0;border-radius:8px;box-shadow:0 2px 4px rgba(0,0,0,0.1)}";
-  html += "label{display:block;margin:10px 0 5px;font-weight:bold}";
-  html += "input{width:100%;padding:8px;margin-bottom:10px;border:1px solid #ddd;border-radius:4px;box-sizing:border-box}";
-  html += "button{background:#4CAF50;color:white;padding:10px 20px;border:none;border-radius:4px;cursor:pointer;width:100%;margin:5px 0}";
-  html += "button:hover{background:#45a049}";
-  html += ".danger{background:#f44336}.danger:hover{background:#da190b}";
-  html += ".warning{background:#ff9800}.warning:hover{background:#e68900}";
-  html += "</style></head><body>";
-  html += "<h1>ATX Watchdog</h1>";
-
-  html += "<div class='card'><h2>Configuracion General</h2>";
-  html += "<form action='/save' method='POST'>";
-  html += "<label>Hostname:</label><input name='hostname' value='" + String(config.hostname) + "'>";
-  html += "<label>Client ID:</label><input name='client_id' value='" + String(config.client_id) + "'>";
-  html += "</div>";
-
-  html += "<div class='card'><h2>Configuracion MQTT</h2>";
-  html += "<label>MQTT Server:</label><input name='mqtt_server' value='" + String(config.mqtt_server) + "'>";
-  html += "<label>MQTT Port:</label><input type='number' name='mqtt_port' value='" + String(config.mqtt_port) + "'>";
-  html += "<label>MQTT User:</label><input name='mqtt_user' value='" + String(config.mqtt_user) + "'>";
-  html += "<label>MQTT Password:</label><input type='password' name='mqtt_pass' value='" + String(config.mqtt_pass) + "'>";
-  html += "</div>";
-
-  html += "<div class='card'><h2>Configuracion Botones</h2>";
-  html += "<label>Power Click (ms):</label><input type='number' name='power_click_ms' value='" + String(config.power_click_ms) + "'>";
-  html += "<label>Reset Click (ms):</label><input type='number' name='reset_click_ms' value='" + String(config.reset_click_ms) + "'>";
-  html += "</div>";
-
-  html += "<div class='card'><h2>Watchdog TCP</h2>";
-  html += "<label>Habilitar Watchdog:</label><input type='checkbox' name='watchdog_enabled' value='1' " + String(config.watchdog_enabled ? "checked" : "") + " style='width:auto'>";
-  html += "<label>Host a monitorear:</label><input name='watchdog_host' value='" + String(config.watchdog_host) + "' placeholder='192.168.1.100'>";
-  html += "<label>Puerto:</label><input type='number' name='watchdog_port' value='" + String(config.watchdog_port) + "' placeholder='22'>";
-  html += "<label>Intervalo de chequeo (ms):</label><input type='number' name='watchdog_check_interval_ms' value='" + String(config.watchdog_check_interval_ms) + "'>";
-  html += "<label>Timeout sin respuesta (ms):</label><input type='number' name='watchdog_timeout_ms' value='" + String(config.watchdog_timeout_ms) + "'>";
-  html += "<button type='submit'>Guardar Configuracion</button>";
-  html += "</form></div>";
-
-  html += "<div class='card'><h2>Control Manual</h2>";
-  html += "<button class='warning' onclick='fetch(\"/power\",{method:\"POST\"}).then(()=>alert(\"Power click enviado\"))'>POWER CLICK</button>";
-  html += "<button class='danger' onclick='fetch(\"/reset\",{method:\"POST\"}).then(()=>alert(\"Reset click enviado\"))'>RESET CLICK</button>";
-  html += "</div>";
-
-  html += "<div class='card' style='border:2px solid #f44336'><h2 style='color:#f44336'>Zona Peligrosa</h2>";
-  html += "<p><b>Resetear WiFi:</b> Borra las credenciales WiFi guardadas y reinicia el ESP8266 en modo AP para reconfigurar.</p>";
-  html += "<button class='danger' onclick='if(confirm(\"¿Estas seguro? Se perderan las credenciales WiFi\")){fetch(\"/resetwifi\",{method:\"POST\"}).then(()=>alert(\"WiFi reseteado. Reiniciando...\"))}'>RESETEAR WiFi</button>";
-  html += "</div>";
-
-  html += "<div class='card'><h2>Estado</h2>";
-  html += "<p><b>IP:</b> " + WiFi.localIP().toString() + "</p>";
-  html += "<p><b>MQTT:</b> " + String(mqttClient.connected() ? "Conectado" : "Desconectado") + "</p>";
-  html += "<p><b>Topic CMD:</b> /watchdog/" + String(config.client_id) + "/cmd</p>";
-  html += "<p><b>Topic Status:</b> /watchdog/" + String(config.client_id) + "/status</p>";
-  if (config.watchdog_enabled) {
-    unsigned long timeSinceCheck = (millis() - lastWatchdogCheck) / 1000;
-    unsigned long timeSinceSuccess = (millis() - lastWatchdogSuccess) / 1000;
-    html += "<p><b>Watchdog:</b> Habilitado</p>";
-    html += "<p><b>Monitoreando:</b> " + String(config.watchdog_host) + ":" + String(config.watchdog_port) + "</p>";
-    html += "<p><b>Ultimo chequeo:</b> hace " + String(timeSinceCheck) + "s</p>";
-    html += "<p><b>Ultima respuesta OK:</b> hace " + String(timeSinceSuccess) + "s</p>";
-    html += "<p><b>Fallos consecutivos:</b> " + String(consecutiveWatchdogFailures) + "</p>";
-  } else {
-    html += "<p><b>Watchdog:</b> Deshabilitado</p>";
+  if (!ok) {
+    Serial.println("Error escribiendo configuracion");
+    LittleFS.remove(CONFIG_FILE_TMP);
+    return;
   }
-  html += "</div>";
 
-  html += "</body></html>";
+  // Sobrescribir la copia que NO tiene el registro vigente
+  int slot = (configActiveSlot == 0) ? 1 : 0;
+  if (!LittleFS.rename(CONFIG_FILE_TMP, CONFIG_SLOT_FILES[slot])) {
+    Serial.println("Error renombrando archivo config");
+    return;
+  }
 
-  server.send(200, "text/html", html);
+  configSequence = header.sequence;
+  configActiveSlot = slot;
+  Serial.printf("Configuracion guardada en %s (seq %lu)\n",
+                CONFIG_SLOT_FILES[slot], (unsigned long)configSequence);
 }
 
-void handleSaveConfig() {
-  if (server.hasArg("hostname")) strlcpy(config.hostname, server.arg("hostname").c_str(), sizeof(config.hostname));
-  if (server.hasArg("mqtt_server")) strlcpy(config.mqtt_server, server.arg("mqtt_server").c_str(), sizeof(config.mqtt_server));
-  if (server.hasArg("mqtt_port")) config.mqtt_port = server.arg("mqtt_port").toInt();
-  if (server.hasArg("mqtt_user")) strlcpy(config.mqtt_user, server.arg("mqtt_user").c_str(), sizeof(config.mqtt_user));
-  if (server.hasArg("mqtt_pass")) strlcpy(config.mqtt_pass, server.arg("mqtt_pass").c_str(), sizeof(config.mqtt_pass));
-  if (server.hasArg("client_id")) strlcpy(config.client_id, server.arg("client_id").c_str(), sizeof(config.client_id));
-  if (server.hasArg("power_click_ms")) config.power_click_ms = server.arg("power_click_ms").toInt();
-  if (server.hasArg("reset_click_ms")) config.reset_click_ms = server.arg("reset_click_ms").toInt();
-  if (server.hasArg("watchdog_timeout_ms")) config.watchdog_timeout_ms = server.arg("watchdog_timeout_ms").toInt();
-
-  // Watchdog TCP
-  config.watchdog_enabled = server.hasArg("watchdog_enabled");
-  if (server.hasArg("watchdog_host")) strlcpy(config.watchdog_host, server.arg("watchdog_host").c_str(), sizeof(config.watchdog_host));
-  if (server.hasArg("watchdog_port")) config.watchdog_port = server.arg("watchdog_port").toInt();
-  if (server.hasArg("watchdog_check_interval_ms")) config.watchdog_check_interval_ms = server.arg("watchdog_check_interval_ms").toInt();
-
-  saveConfig();
+uint32_t fastConnectCrc(const FastConnectRecord& rec) {
+  return crc32Update(0, (const uint8_t*)&rec + sizeof(rec.crc), sizeof(rec) - sizeof(rec.crc));
+}
 
-  server.send(200, "text/html", "<html><body><h1>Configuracion guardada!</h1><p>Reiniciando en 3 segundos...</p><script>setTimeout(()=>window.location='/',3000)</script></body></html>");
+// Busca el registro primero en RTC y despues en flash
+bool loadFastConnectRecord(FastConnectRecord& rec) {
+  if (ESP.rtcUserMemoryRead(FAST_CONNECT_RTC_OFFSET, (uint32_t*)&rec, sizeof(rec)) &&
+      rec.crc == fastConnectCrc(rec) && rec.channel != 0) {
+    return true;
+  }
 
-  delay(3000);
-  ESP.restart();
+  File file = LittleFS.open(FAST_CONNECT_FILE, "r");
+  if (!file) return false;
+  bool ok = file.read((uint8_t*)&rec, sizeof(rec)) == sizeof(rec);
+  file.close();
+  return ok && rec.crc == fastConnectCrc(rec) && rec.channel != 0;
 }
 
-void handleClickPower() {
-  Serial.println("Click POWER desde web");
-  clickButton(POWER_PIN, config.power_click_ms);
-  server.send(200, "text/plain", "OK");
+void clearFastConnectRecord() {
+  FastConnectRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  ESP.rtcUserMemoryWrite(FAST_CONNECT_RTC_OFFSET, (uint32_t*)&rec, sizeof(rec));
+  LittleFS.remove(FAST_CONNECT_FILE);
 }
 
-void handleClickReset() {
-  Serial.println("Click RESET desde web");
-  clickButton(RESET_PIN, config.reset_click_ms);
-  server.send(200, "text/plain", "OK");
+// Guarda BSSID/canal actuales. La flash solo se reescribe si cambiaron.
+void saveFastConnectRecord() {
+  FastConnectRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  memcpy(rec.bssid, WiFi.BSSID(), sizeof(rec.bssid));
+  rec.channel = WiFi.channel();
+  rec.crc = fastConnectCrc(rec);
+
+  ESP.rtcUserMemoryWrite(FAST_CONNECT_RTC_OFFSET, (uint32_t*)&rec, sizeof(rec));
+
+  FastConnectRecord stored;
+  File file = LittleFS.open(FAST_CONNECT_FILE, "r");
+  bool same = file && file.read((uint8_t*)&stored, sizeof(stored)) == sizeof(stored) &&
+              memcmp(&stored, &rec, sizeof(rec)) == 0;
+  if (file) file.close();
+  if (same) return;
+
+  file = LittleFS.open(FAST_CONNECT_FILE, "w");
+  if (!file) return;
+  file.write((const uint8_t*)&rec, sizeof(rec));
+  file.close();
+  Serial.printf("AP recordado para conexion rapida (canal %d)\n", rec.channel);
 }
 
-void handleResetWiFi() {
-  Serial.println("========================================");
-  Serial.println("RESETEO DE WiFi SOLICITADO");
-  Serial.println("Borrando credenciales WiFi...");
-  Serial.println("========================================");
+// Conecta directo al BSSID/canal recordados con las credenciales que
+// WiFiManager dejo guardadas en el SDK. Tras FAST_CONNECT_ATTEMPTS fallos se
+// descarta el registro y se sigue por WiFiManager.
+bool fastConnectWiFi() {
+  FastConnectRecord rec;
+  if (!loadFastConnectRecord(rec)) return false;
+
+  String ssid = WiFi.SSID();
+  String psk = WiFi.psk();
+  if (ssid.length() == 0) return false;
+
+  WiFi.mode(WIFI_STA);
+  for (int attempt = 1; attempt <= FAST_CONNECT_ATTEMPTS; attempt++) {
+    Serial.printf("Conexion rapida a %s (canal %d), intento %d...\n", ssid.c_str(), rec.channel, attempt);
+    WiFi.begin(ssid.c_str(), psk.c_str(), rec.channel, rec.bssid, true);
+
+    unsigned long start = millis();
+    while (WiFi.status() != WL_CONNECTED && millis() - start < FAST_CONNECT_TIMEOUT_MS) {
+      delay(10);
+    }
+    if (WiFi.status() == WL_CONNECTED) return true;
 
-  server.send(200, "text/html", "<html><body><h1>WiFi Reseteado</h1><p>Reiniciando en modo AP...</p><p>Conectate a la red: <b>ATX-Watchdog-Setup</b></p></body></html>");
+    WiFi.disconnect();
+  }
 
-  delay(1000);
+  Serial.println("Conexion rapida fallida, usando WiFiManager");
+  clearFastConnectRecord();
+  return false;
+}
 
-  // Borrar credenciales WiFi
-  WiFiManager wifiManager;
-  wifiManager.resetSettings();
+// IP fija opcional; sin static_ip se usa DHCP
+void applyStaticIpConfig() {
+  if (config.static_ip[0] == '\0') return;
 
-  Serial.println("Credenciales borradas. Reiniciando...");
-  delay(1000);
-  ESP.restart();
-}
+  IPAddress ip, gateway, mask(255, 255, 255, 0), dns;
+  if (!ip.fromString(config.static_ip) || !gateway.fromString(config.static_gateway)) {
+    Serial.println("IP fija invalida, usando DHCP");
+    return;
+  }
+  if (config.static_mask[0] != '\0') mask.fromString(config.static_mask);
+  if (config.static_dns[0] == '\0' || !dns.fromString(config.static_dns)) dns = gateway;
 
-void clickButton(int pin, int duration_ms) {
-  Serial.printf("Ejecutando click en pin %d por %d ms\n", pin, duration_ms);
-  digitalWrite(pin, LOW);
-  delay(duration_ms);
-  digitalWrite(pin, HIGH);
+  WiFi.config(ip, gateway, mask, dns);
+  Serial.printf("Usando IP fija %s\n", config.static_ip);
 }
 
-void reconnectMqtt() {
-  static unsigned long lastAttempt = 0;
-  unsigned long now = millis();
-
-  if (now - lastAttempt < 5000) return; // Intentar cada 5 segundos
-  lastAttempt = now;
+void handleResetWiFi();
 
-  if (strlen(config.mqtt_server) == 0) return; // No configurado
+// Respuesta HTTP chunked escrita a traves de un buffer fijo en el stack.
+// Nunca arma la respuesta completa en RAM, asi el heap usado por request es
+// constante sin importar el tamaño del contenido.
+class ChunkedResponse : public Print {
+public:
+  ChunkedResponse(int code, const char* contentType) : len(0) {
+    heapAtStart = ESP.getFreeHeap();
+    peakUse = 0;
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(code, contentType, "");
+  }
 
-  Serial.print("Conectando a MQTT...");
+  size_t write(uint8_t c) override {
+    if (len == sizeof(buf)) flushChunk();
+    buf[len++] = c;
+    return 1;
+  }
 
-  String clientId = String(config.client_id);
-  bool connected = false;
+  size_t write(const uint8_t* data, size_t size) override {
+    for (size_t i = 0; i < size; i++) write(data[i]);
+    return size;
+  }
 
-  if (strlen(config.mqtt_user) > 0) {
-    connected = mqttClient.connect(clientId.c_str(), config.mqtt_user, config.mqtt_pass);
-  } else {
-    connected = mqttClient.connect(clientId.c_str());
+  void end() {
+    flushChunk();
+    server.sendContent("");
+    lastWebHeapUse = peakUse;
+    if (peakUse > maxWebHeapUse) maxWebHeapUse = peakUse;
   }
 
-  if (connected) {
-    Serial.println("MQTT conectado!");
+private:
+  void flushChunk() {
+    if (len > 0) server.sendContent(buf, len);
+    len = 0;
+    uint32_t heap = ESP.getFreeHeap();
+    if (heap < heapAtStart && heapAtStart - heap > peakUse) peakUse = heapAtStart - heap;
+  }
 
-    // Suscribirse al topic de comandos
-    String cmdTopic = "/watchdog/" + String(config.client_id) + "/cmd";
-    mqttClient.subscribe(cmdTopic.c_str());
-    Serial.printf("Suscrito a: %s\n", cmdTopic.c_str());
+  char buf[WEB_CHUNK_SIZE];
+  size_t len;
+  uint32_t heapAtStart;
+  uint32_t peakUse;
+};
 
-    // Publicar que estamos online
-    publishKeepalive();
-  } else {
-    Serial.printf("fallo, rc=%d\n", mqttClient.state());
+// Hash FNV-1a de la pagina en flash, usado como ETag
+void computeIndexEtag() {
+  uint32_t hash = 2166136261UL;
+  size_t size = strlen_P(INDEX_HTML);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= pgm_read_byte(INDEX_HTML + i);
+    hash *= 16777619UL;
   }
+  snprintf(indexEtag, sizeof(indexEtag), "\"%08lx\"", (unsigned long)hash);
 }
 
-void publishKeepalive() {
-  if (!mqttClient.connected()) return;
+void setupWebServer() {
+  static const char* headerKeys[] = { "If-None-Match" };
+  server.collectHeaders(headerKeys, 1);
+  computeIndexEtag();
 
-  String statusTopic = "/watchdog/" + String(config.client_id) + "/status";
+  server.on("/", handleRoot);
+  server.on("/api/status", HTTP_GET, handleApiStatus);
+  server.on("/api/config", HTTP_GET, handleApiConfig);
+  server.on("/api/config", HTTP_POST, handleApiConfigImport);
+  server.on("/api/events", HTTP_GET, handleApiEvents);
+  server.on("/api/ota", HTTP_POST, handleApiOta);
+  server.on("/metrics", HTTP_GET, handleMetrics);
+  server.on("/save", HTTP_POST, handleSaveConfig);
+  server.on("/power", HTTP_POST, handleClickPower);
+  server.on("/reset", HTTP_POST, handleClickReset);
+  server.on("/resetwifi", HTTP_POST, handleResetWiFi);
+}
 
-  JsonDocument doc;
-  doc["status"] = "online";
-  doc["uptime"] = millis() / 1000;
-  doc["ip"] = WiFi.localIP().toString();
-  doc["rssi"] = WiFi.RSSI();
+void handleRoot() {
+  server.sendHeader("ETag", indexEtag);
+  server.sendHeader("Cache-Control", "no-cache");
+
+  if (server.hasHeader("If-None-Match") && server.header("If-None-Match") == indexEtag) {
+    server.send(304);
+    return;
+  }
 
-  String payload;
-  serializeJson(doc, payload);
+  server.send_P(200, "text/html", INDEX_HTML);
+}
 
-  mqttClient.publish(statusTopic.c_str(), payload.c_str());
-  Serial.println("Keepalive MQTT enviado");
+void handleApiStatus() {
+  ChunkedResponse out(200, "application/json");
+  renderStatusJson(out);
+  out.end();
 }
 
-void mqttCallback(char* topic, byte* payload, unsigned int length) {
-  Serial.printf("Mensaje MQTT recibido en %s: ", topic);
+// Diario de eventos con seq > since, del mas viejo al mas nuevo. Se lee y
+// se envia de a un registro: nunca hay mas de uno en RAM.
+void handleApiEvents() {
+  uint32_t since = server.hasArg("since") ? strtoul(server.arg("since").c_str(), nullptr, 10) : 0;
+  long limit = server.hasArg("limit") ? server.arg("limit").toInt() : JOURNAL_CAPACITY;
+  if (limit <= 0 || limit > JOURNAL_CAPACITY) limit = JOURNAL_CAPACITY;
+
+  ChunkedResponse out(200, "application/json");
+  uint32_t first = since + 1 > journalFirstSeq() ? since + 1 : journalFirstSeq();
+  uint32_t last = journalLastSeq();
+
+  out.write('{');
+  printJsonKey(out, "boot", true);
+  out.print(journalBoot);
+  printJsonKey(out, "first_seq");
+  out.print(journalFirstSeq());
+  printJsonKey(out, "last_seq");
+  out.print(last);
+  printJsonKey(out, "events");
+  out.write('[');
+  static char record[JOURNAL_JSON_SIZE];
+  JournalRecord r;
+  long sent = 0;
+  for (uint32_t seq = first; seq <= last && sent < limit; seq++) {
+    if (!journalRead(seq, r)) continue;
+    if (sent++ > 0) out.write(',');
+    formatJournalRecord(r, record, sizeof(record));
+    out.print(record);
+  }
+  out.write(']');
+  out.write('}');
+  out.end();
+}
 
-  // Parsear JSON
-  JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, payload, length);
+void handleApiConfig() {
+  ChunkedResponse out(200, "application/json");
+  renderConfigJson(out);
+  out.end();
+}
 
-  if (error) {
-    Serial.println("Error parseando JSON");
-    return;
+// Metricas en formato de texto de Prometheus
+void handleMetrics() {
+  ChunkedResponse out(200, "text/plain; version=0.0.4");
+  renderMetrics(out);
+  out.end();
+}
+
+// Intento de cambiar una clave HMAC sin la clave vigente
+void rejectSecretChange(const char* name) {
+  Serial.printf("Config: cambio de %s rechazado (clave actual incorrecta) desde %s\n", name,
+                server.client().remoteIP().toString().c_str());
+}
+
+// Clave de solo escritura desde el formulario: campo vacio = sin cambios,
+// <name>_clear la borra y <name>_current trae la vigente. false si no se
+// presento la vigente correcta.
+bool secretKeyFromArgs(const char* name, char* key, size_t size) {
+  String field(name);
+  if (updateSecretKey(key, size, server.arg(field).c_str(), server.hasArg(field + "_clear"),
+                      server.arg(field + "_current").c_str()) != SECRET_DENIED) {
+    return true;
   }
+  rejectSecretChange(name);
+  return false;
+}
 
-  serializeJson(doc, Serial);
-  Serial.println();
+void handleSaveConfig() {
+  static Config previous; // Static para no ocupar ~1KB de stack
+  previous = config;
 
-  // Procesar comandos
-  const char* cmd = doc["cmd"];
-  if (cmd == nullptr) return;
+  if (server.hasArg("hostname")) strlcpy(config.hostname, server.arg("hostname").c_str(), sizeof(config.hostname));
+  if (server.hasArg("mqtt_server")) strlcpy(config.mqtt_server, server.arg("mqtt_server").c_str(), sizeof(config.mqtt_server));
+  if (server.hasArg("mqtt_port")) config.mqtt_port = server.arg("mqtt_port").toInt();
+  if (server.hasArg("mqtt_user")) strlcpy(config.mqtt_user, server.arg("mqtt_user").c_str(), sizeof(config.mqtt_user));
+  if (server.hasArg("mqtt_pass")) strlcpy(config.mqtt_pass, server.arg("mqtt_pass").c_str(), sizeof(config.mqtt_pass));
+  if (server.hasArg("client_id")) strlcpy(config.client_id, server.arg("client_id").c_str(), sizeof(config.client_id));
+  if (server.hasArg("mqtt_groups")) strlcpy(config.mqtt_groups, server.arg("mqtt_groups").c_str(), sizeof(config.mqtt_groups));
+  if (server.hasArg("static_ip")) strlcpy(config.static_ip, server.arg("static_ip").c_str(), sizeof(config.static_ip));
+  if (server.hasArg("static_gateway")) strlcpy(config.static_gateway, server.arg("static_gateway").c_str(), sizeof(config.static_gateway));
+  if (server.hasArg("static_mask")) strlcpy(config.static_mask, server.arg("static_mask").c_str(), sizeof(config.static_mask));
+  if (server.hasArg("static_dns")) strlcpy(config.static_dns, server.arg("static_dns").c_str(), sizeof(config.static_dns));
+  if (server.hasArg("power_click_ms")) config.power_click_ms = server.arg("power_click_ms").toInt();
+  if (server.hasArg("reset_click_ms")) config.reset_click_ms = server.arg("reset_click_ms").toInt();
 
-  if (strcmp(cmd, "power") == 0) {
-    int duration = doc["duration"] | config.power_click_ms;
-    Serial.printf("Comando POWER recibido (duracion: %d ms)\n", duration);
-    clickButton(POWER_PIN, duration);
+  // Watchdog TCP
+  config.watchdog_enabled = server.hasArg("watchdog_enabled");
+  if (server.hasArg("heartbeat_port")) config.heartbeat_port = server.arg("heartbeat_port").toInt();
+  if (server.hasArg("power_led_mode")) {
+    config.power_led_mode = server.arg("power_led_mode").toInt();
+    if (config.power_led_mode > POWER_LED_ACTIVE_HIGH) config.power_led_mode = POWER_LED_NONE;
   }
-  else if (strcmp(cmd, "reset") == 0) {
-    int duration = doc["duration"] | config.reset_click_ms;
-    Serial.printf("Comando RESET recibido (duracion: %d ms)\n", duration);
-    clickButton(RESET_PIN, duration);
+  if (server.hasArg("power_save_mode")) {
+    config.power_save_mode = server.arg("power_save_mode").toInt();
+    if (config.power_save_mode > POWER_SAVE_LIGHT) config.power_save_mode = POWER_SAVE_OFF;
   }
-  else {
-    Serial.printf("Comando desconocido: %s\n", cmd);
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    WatchdogTarget& t = config.targets[i];
+    String prefix = "t" + String(i) + "_";
+    if (server.hasArg(prefix + "host")) strlcpy(t.host, server.arg(prefix + "host").c_str(), sizeof(t.host));
+    if (server.hasArg(prefix + "port")) t.port = server.arg(prefix + "port").toInt();
+    if (server.hasArg(prefix + "interval")) t.check_interval_ms = server.arg(prefix + "interval").toInt();
+    if (server.hasArg(prefix + "timeout")) t.timeout_ms = server.arg(prefix + "timeout").toInt();
+    if (server.hasArg(prefix + "action")) t.action = server.arg(prefix + "action").toInt();
+    sanitizeTarget(t);
+
+    ProbeSchedule& sched = config.schedules[i];
+    if (server.hasArg(prefix + "min_interval")) sched.min_interval_ms = server.arg(prefix + "min_interval").toInt();
+    if (server.hasArg(prefix + "max_interval")) sched.max_interval_ms = server.arg(prefix + "max_interval").toInt();
+    sanitizeSchedule(sched, t);
+
+    // Escalera: "reset:120,force_off:240,power_on:260" (segundos); si el
+    // texto es invalido se conservan los pasos anteriores
+    RecoveryPolicy& p = config.recovery[i];
+    if (server.hasArg(prefix + "steps") && !parseRecoverySteps(server.arg(prefix + "steps").c_str(), p)) {
+      Serial.printf("Escalera invalida para el objetivo %d, se conserva la anterior\n", i);
+    }
+    if (server.hasArg(prefix + "cooldown")) p.cooldown_ms = server.arg(prefix + "cooldown").toInt() * 1000UL;
+    if (server.hasArg(prefix + "attempts")) p.max_attempts = constrain(server.arg(prefix + "attempts").toInt(), 1, RECOVERY_MAX_ATTEMPTS);
+    sanitizeRecovery(p);
+
+    ProbeSettings& ps = config.probes[i];
+    if (server.hasArg(prefix + "probe")) ps.type = server.arg(prefix + "probe").toInt();
+    if (server.hasArg(prefix + "match")) strlcpy(ps.match, server.arg(prefix + "match").c_str(), sizeof(ps.match));
+    if (server.hasArg(prefix + "http_status")) ps.http_status = constrain(server.arg(prefix + "http_status").toInt(), 0, 599);
+    if (server.hasArg(prefix + "degraded")) ps.degraded_pct = constrain(server.arg(prefix + "degraded").toInt(), 0, DEGRADED_PCT_MAX);
+    sanitizeProbeSettings(ps);
   }
-}
-
-bool testTcpConnection(const char* host, int port, int timeout_ms) {
-  WiFiClient testClient;
-  testClient.setTimeout(timeout_ms);
 
-  Serial.printf("Probando conexion TCP a %s:%d... ", host, port);
+  if (!secretKeyFromArgs("heartbeat_key", config.heartbeat_key, sizeof(config.heartbeat_key)) ||
+      !secretKeyFromArgs("ota_key", config.ota_key, sizeof(config.ota_key))) {
+    config = previous;
+    server.send(403, "text/html", "<html><body><h1>Clave actual incorrecta</h1><p>No se guardo ningun cambio.</p><script>setTimeout(()=>window.location='/',2000)</script></body></html>");
+    return;
+  }
 
-  bool connected = testClient.connect(host, port);
+  uint8_t changes = commitConfig(previous);
+  if (changes == CHANGE_NONE) {
+    server.send(200, "text/html", "<html><body><h1>Sin cambios</h1><script>setTimeout(()=>window.location='/',1000)</script></body></html>");
+    return;
+  }
 
-  if (connected) {
-    Serial.println("OK");
-    testClient.stop();
-    return true;
+  if (changes & CHANGE_RESTART) {
+    server.send(200, "text/html", "<html><body><h1>Configuracion guardada!</h1><p>Reiniciando en 3 segundos...</p><script>setTimeout(()=>window.location='/',3000)</script></body></html>");
   } else {
-    Serial.println("FALLO");
-    return false;
+    server.send(200, "text/html", "<html><body><h1>Configuracion guardada!</h1><p>Cambios aplicados sin reiniciar.</p><script>setTimeout(()=>window.location='/',1000)</script></body></html>");
   }
 }
 
-void checkTcpWatchdog() {
-  if (!config.watchdog_enabled) return;
-  if (strlen(config.watchdog_host) == 0) return;
+// Importa configuracion en JSON (mismo formato que GET /api/config)
+void handleApiConfigImport() {
+  static Config previous;
+  previous = config;
 
-  unsigned long now = millis();
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, server.arg("plain"));
+  if (error || !configFromJson(doc.as<JsonVariantConst>(), config)) {
+    config = previous;
+    server.send(400, "application/json", "{\"error\":\"json invalido\"}");
+    return;
+  }
+  const char* denied = nullptr;
+  if (secretKeyFromJson(doc.as<JsonVariantConst>(), "heartbeat_key", config.heartbeat_key,
+                        sizeof(config.heartbeat_key)) == SECRET_DENIED) {
+    denied = "heartbeat_key";
+  } else if (secretKeyFromJson(doc.as<JsonVariantConst>(), "ota_key", config.ota_key,
+                               sizeof(config.ota_key)) == SECRET_DENIED) {
+    denied = "ota_key";
+  }
+  if (denied != nullptr) {
+    config = previous;
+    rejectSecretChange(denied);
+    server.send(403, "application/json", "{\"error\":\"clave actual incorrecta\"}");
+    return;
+  }
 
-  // Verificar si es momento de hacer un chequeo
-  if (now - lastWatchdogCheck >= config.watchdog_check_interval_ms) {
-    lastWatchdogCheck = now;
+  uint8_t changes = commitConfig(previous);
+  char response[64];
+  snprintf(response, sizeof(response), "{\"changes\":%u,\"restart\":%s}",
+           changes, (changes & CHANGE_RESTART) ? "true" : "false");
+  server.send(200, "application/json", response);
+}
 
-    // Intentar conectar al host:puerto
-    bool success = testTcpConnection(config.watchdog_host, config.watchdog_port, 5000);
+// Guarda y aplica los cambios respecto de previous. Devuelve la mascara.
+uint8_t commitConfig(const Config& previous) {
+  uint8_t changes = diffConfig(previous, config);
+  if (changes == CHANGE_NONE) return changes;
 
-    if (success) {
-      // Conexion exitosa
-      lastWatchdogSuccess = now;
-      consecutiveWatchdogFailures = 0;
-      Serial.println("Watchdog: Host respondiendo correctamente");
+  saveConfig();
+  journalAppend(JOURNAL_CONFIG, JOURNAL_NO_TARGET, changes, configSequence, config.hostname);
+  applyConfigChanges(previous, changes);
+  return changes;
+}
+
+// Aplica en vivo lo que cambio respecto de la configuracion anterior
+void applyConfigChanges(const Config& previous, uint8_t changes) {
+  Serial.printf("Aplicando cambios de configuracion (mascara 0x%02x)\n", changes);
+
+  if (changes & CHANGE_WATCHDOG) {
+    if (previous.watchdog_enabled != config.watchdog_enabled) {
+      // Al (des)habilitar se reparten de nuevo todas las sondas
+      scheduleWatchdogTargets();
     } else {
-      // Fallo en la conexion
-      consecutiveWatchdogFailures++;
-      Serial.printf("Watchdog: Fallo #%d conectando al host\n", consecutiveWatchdogFailures);
-
-      // Calcular tiempo sin respuesta
-      unsigned long timeSinceSuccess = now - lastWatchdogSuccess;
-
-      if (timeSinceSuccess >= config.watchdog_timeout_ms) {
-        Serial.println("========================================");
-        Serial.println("WATCHDOG TIMEOUT!");
-        Serial.printf("Host %s:%d sin responder por %lu ms\n",
-                      config.watchdog_host,
-                      config.watchdog_port,
-                      timeSinceSuccess);
-        Serial.println("Ejecutando POWER CLICK para reiniciar...");
-        Serial.println("========================================");
-
-        clickButton(POWER_PIN, config.power_click_ms);
-
-        // Resetear contadores
-        lastWatchdogSuccess = now;
-        consecutiveWatchdogFailures = 0;
+      // Solo se reinicia el estado de los objetivos modificados
+      for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+        if (!targetConfigEquals(previous, config, i)) resetWatchdogTarget(i);
       }
     }
+    Serial.println("Watchdog reconfigurado");
+  }
+
+  if (changes & CHANGE_MQTT) {
+    // Un disconnect limpio no dispara el Last Will: marcar offline a mano
+    // el topic viejo (el client_id pudo cambiar)
+    if (mqttClient.connected()) {
+      static char oldTopic[64];
+      snprintf(oldTopic, sizeof(oldTopic), "/watchdog/%s/status", previous.client_id);
+      mqttClient.publish(oldTopic, MQTT_OFFLINE_PAYLOAD, true);
+    }
+
+    // Reconectar (y re-suscribir) de inmediato con los datos nuevos
+    mqttClient.disconnect();
+    mqttLinkRestart();
+    Serial.println("MQTT reconfigurado, reconectando...");
+  }
+
+  if (changes & CHANGE_HEARTBEAT) {
+    setupHeartbeatListener();
+  }
+
+  if (changes & CHANGE_POWER_SAVE) {
+    setupPowerSave();
+  }
+
+  if (changes & CHANGE_HOSTNAME) {
+    // Se anuncia con el nuevo nombre en la proxima renovacion DHCP
+    WiFi.hostname(config.hostname);
+    Serial.printf("Hostname actualizado: %s\n", config.hostname);
+  }
+
+  if (changes & CHANGE_RESTART) {
+    pendingRestartAt = millis() + 3000;
   }
 }
 
-void checkPhysicalButtons() {
-  unsigned long now = millis();
+// Pedido de actualizacion firmado: {"url":...,"sha256":...,"sig":...}. Solo
+// valida y arranca la descarga, que sigue en otaLoop(); el avance se ve en
+// /api/status y en los eventos ota_*.
+void handleApiOta() {
+  JsonDocument doc;
+  if (deserializeJson(doc, server.arg("plain"))) {
+    server.send(400, "application/json", "{\"status\":\"rejected\",\"reason\":\"invalid_json\"}");
+    return;
+  }
 
-  // Leer estado de los botones (LOW = presionado porque usamos INPUT_PULLUP)
-  bool powerPressed = (digitalRead(POWER_BUTTON_PIN) == LOW);
-  bool resetPressed = (digitalRead(RESET_BUTTON_PIN) == LOW);
+  const char* reason;
+  if (!otaStart(doc["url"] | "", doc["sha256"] | "", doc["sig"] | "", reason)) {
+    int code = 400;
+    if (strcmp(reason, "busy") == 0 || strcmp(reason, "trial_pending") == 0) code = 409;
+    if (strcmp(reason, "bad_signature") == 0 || strcmp(reason, "disabled") == 0) code = 403;
+    char response[64];
+    snprintf(response, sizeof(response), "{\"status\":\"rejected\",\"reason\":\"%s\"}", reason);
+    server.send(code, "application/json", response);
+    return;
+  }
+  char response[64];
+  snprintf(response, sizeof(response), "{\"status\":\"accepted\",\"deadline_ms\":%lu}", OTA_HEALTH_DEADLINE_MS);
+  server.send(202, "application/json", response);
+}
 
-  // Chequear boton POWER con debounce
-  if (powerPressed && (now - lastPowerButtonPress > BUTTON_DEBOUNCE_MS)) {
-    lastPowerButtonPress = now;
-    Serial.println("Boton POWER fisico presionado!");
-    clickButton(POWER_PIN, config.power_click_ms);
+void handleClickPower() {
+  Serial.println("Click POWER desde web");
+  if (clickButton(POWER_PIN, config.power_click_ms)) {
+    server.send(200, "text/plain", "OK");
+  } else {
+    server.send(409, "text/plain", "BUSY");
   }
+}
 
-  // Chequear boton RESET con debounce
-  if (resetPressed && (now - lastResetButtonPress > BUTTON_DEBOUNCE_MS)) {
-    lastResetButtonPress = now;
-    Serial.println("Boton RESET fisico presionado!");
-    clickButton(RESET_PIN, config.reset_click_ms);
+void handleClickReset() {
+  Serial.println("Click RESET desde web");
+  if (clickButton(RESET_PIN, config.reset_click_ms)) {
+    server.send(200, "text/plain", "OK");
+  } else {
+    server.send(409, "text/plain", "BUSY");
   }
 }
+
+void handleResetWiFi() {
+  Serial.println("========================================");
+  Serial.println("RESETEO DE WiFi SOLICITADO");
+  Serial.println("Borrando credenciales WiFi...");
+  Serial.println("========================================");
+
+  server.send(200, "text/html", "<html><body><h1>WiFi Reseteado</h1><p>Reiniciando en modo AP...</p><p>Conectate a la red: <b>ATX-Watchdog-Setup</b></p></body></html>");
+
+  delay(1000);
+
+  // Borrar credenciales WiFi
+  WiFiManager wifiManager;
+  wifiManager.resetSettings();
+  clearFastConnectRecord();
+
+  Serial.println("Credenciales borradas. Reiniciando...");
+  journalFlush();
+  saveHeartbeatRecord();
+  delay(1000);
+  ESP.restart();
+}
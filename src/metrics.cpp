@@ -0,0 +1,26 @@
+#include "metrics.h"
+
+const char* const SECTION_NAMES[SEC_COUNT] = {
+  "pulses", "buttons", "http", "mqtt_reconnect", "mqtt_loop", "keepalive", "watchdog", "ota", "loop"
+};
+
+LatencyStats loopStats[SEC_COUNT] = {};
+ActionCounters actionCounters = {};
+BootTimeline bootTimeline = {};
+
+// Registra la duracion de una seccion del loop y devuelve halMicros() actual,
+// para encadenar mediciones sin llamadas extra.
+uint32_t recordSection(LoopSection section, uint32_t start_us) {
+  uint32_t now = halMicros();
+  uint32_t elapsed = now - start_us;
+  LatencyStats& st = loopStats[section];
+
+  int bucket = 0;
+  while (bucket < LATENCY_BUCKET_COUNT - 1 && elapsed > LATENCY_BUCKETS_US[bucket]) bucket++;
+  st.buckets[bucket]++;
+  st.count++;
+  st.sum_us += elapsed;
+  if (elapsed > st.max_us) st.max_us = elapsed;
+  if (elapsed > STALL_THRESHOLD_US) st.stalls++;
+  return now;
+}
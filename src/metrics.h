@@ -0,0 +1,56 @@
+#pragma once
+
+// Instrumentacion del loop (histogramas de latencia por seccion), contadores
+// de acciones e hitos del arranque. Se exportan en /metrics y por MQTT.
+
+#include "hal.h"
+
+#define STALL_THRESHOLD_US 50000        // Una seccion que tarda mas cuenta como stall
+
+// Momentos del arranque (ms desde el encendido, 0 = todavia no ocurrio)
+struct BootTimeline {
+  bool fast_path;              // true si conecto sin pasar por WiFiManager
+  unsigned long wifi_associated;
+  unsigned long wifi_ip;
+  unsigned long mqtt_connected;
+  unsigned long first_probe;
+};
+
+// Secciones de loop() instrumentadas
+enum LoopSection {
+  SEC_PULSES, SEC_BUTTONS, SEC_HTTP, SEC_MQTT_RECONNECT, SEC_MQTT_LOOP,
+  SEC_KEEPALIVE, SEC_WATCHDOG, SEC_OTA, SEC_LOOP, SEC_COUNT
+};
+extern const char* const SECTION_NAMES[SEC_COUNT];
+
+// Limites superiores (us) de los buckets del histograma; el ultimo es +Inf
+const uint32_t LATENCY_BUCKETS_US[] = { 100, 500, 1000, 5000, 10000, 50000, 100000, 500000 };
+const int LATENCY_BUCKET_COUNT = sizeof(LATENCY_BUCKETS_US) / sizeof(LATENCY_BUCKETS_US[0]) + 1;
+
+struct LatencyStats {
+  uint32_t buckets[LATENCY_BUCKET_COUNT]; // No acumulativos
+  uint32_t count;
+  uint64_t sum_us;
+  uint32_t max_us;
+  uint32_t stalls;
+};
+
+// Contadores de acciones
+struct ActionCounters {
+  uint32_t power_clicks;
+  uint32_t reset_clicks;
+  uint32_t watchdog_timeouts;
+  uint32_t probes_ok;
+  uint32_t probes_failed;
+  uint32_t mqtt_connects;
+  uint32_t heartbeats_ok;
+  uint32_t heartbeats_rejected;     // Firma, formato, emisor o seq invalidos
+  uint32_t mqtt_connect_failures;   // Intentos fallidos (broker inalcanzable o CONNECT rechazado)
+  uint32_t events_dropped;          // Eventos perdidos por cola offline llena
+};
+
+extern LatencyStats loopStats[SEC_COUNT];
+extern ActionCounters actionCounters;
+extern BootTimeline bootTimeline;
+
+uint32_t recordSection(LoopSection section, uint32_t start_us);
@@ -0,0 +1,75 @@
+#include "mqtt_link.h"
+#include "powersave.h"
+
+static_assert(MQTT_PROBE_SLOT >= MAX_WATCHDOG_TARGETS, "el slot del broker no puede ser de un objetivo");
+
+MqttLink mqttLink = {};
+
+// Equal jitter: la mitad fija y la otra mitad al azar, asi muchos equipos
+// que perdieron el broker a la vez no reintentan todos juntos
+unsigned long mqttBackoffMs(uint8_t failures) {
+  unsigned long delay_ms = MQTT_BACKOFF_MAX_MS;
+  if (failures < 8) {
+    delay_ms = MQTT_BACKOFF_MIN_MS << failures;
+    if (delay_ms > MQTT_BACKOFF_MAX_MS) delay_ms = MQTT_BACKOFF_MAX_MS;
+  }
+  return delay_ms / 2 + halRandom(delay_ms / 2 + 1);
+}
+
+void scheduleMqttRetry() {
+  mqttLink.backoff_ms = mqttBackoffMs(mqttLink.failures);
+  if (mqttLink.failures < 255) mqttLink.failures++;
+  mqttLink.next_attempt = halMillis() + mqttLink.backoff_ms;
+  mqttLink.state = MQTT_LINK_WAITING;
+  halLog("MQTT: reintento en %lu ms (fallos seguidos: %u)\n", mqttLink.backoff_ms, mqttLink.failures);
+}
+
+bool mqttLinkReady(const char* server, uint16_t port) {
+  if (server[0] == '\0') return false;  // No configurado
+  unsigned long now = halMillis();
+
+  if (mqttLink.state == MQTT_LINK_WAITING) {
+    if ((long)(now - mqttLink.next_attempt) < 0) return false;
+    // Primer intento del ciclo: re-resolver el hostname (el broker pudo cambiar de IP)
+    if (mqttLink.failures == 0) halProbeFlushDns(MQTT_PROBE_SLOT);
+    ProbeRequest request = { PROBE_TCP, server, port, "", 0, MQTT_PROBE_TIMEOUT_MS };
+    halProbeStart(MQTT_PROBE_SLOT, request);
+    mqttLink.state = MQTT_LINK_PROBING;
+  }
+
+  ProbeResult result = halProbePoll(MQTT_PROBE_SLOT);
+  if (result == PROBE_PENDING) return false;
+  if (result != PROBE_OK) {
+    halLog("MQTT: broker %s:%u inalcanzable\n", server, port);
+    scheduleMqttRetry();
+    return false;
+  }
+  mqttLink.state = MQTT_LINK_WAITING;
+  return true;
+}
+
+void mqttLinkResult(bool connected) {
+  if (connected) {
+    // Proxima caida: primer reintento inmediato y ciclo nuevo
+    mqttLinkRestart();
+  } else {
+    scheduleMqttRetry();
+  }
+}
+
+void mqttLinkRestart() {
+  halProbeAbort(MQTT_PROBE_SLOT);
+  mqttLink.failures = 0;
+  mqttLink.backoff_ms = 0;
+  mqttLink.next_attempt = halMillis();
+  mqttLink.state = MQTT_LINK_WAITING;
+}
+
+uint32_t mqttLinkAddress() {
+  return halProbeAddress(MQTT_PROBE_SLOT);
+}
+
+void mqttLinkIdleBudget(unsigned long now, unsigned long& budget) {
+  if (config.mqtt_server[0] == '\0') return;
+  if (mqttLink.state == MQTT_LINK_WAITING) limitIdle(budget, now, mqttLink.next_attempt);
+}
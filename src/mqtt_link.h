@@ -0,0 +1,57 @@
+#pragma once
+
+// Conexion al broker MQTT acotando lo que bloquea loop(). PubSubClient::connect()
+// resuelve el hostname y hace el connect TCP de forma bloqueante: con el
+// broker caido el loop quedaba frenado todo el timeout en cada reintento,
+// justo cuando mas importan los botones y el watchdog.
+//
+// Antes de cada intento se verifica el puerto del broker con una sonda TCP
+// asincrona (DNS y connect por lwIP, slot MQTT_PROBE_SLOT). Solo cuando el
+// broker acepta la conexion se llama a connect() contra el IP ya resuelto,
+// que entonces termina en un par de RTT. Los intentos fallidos se espacian
+// con backoff exponencial con jitter, y el hostname se vuelve a resolver una
+// vez por ciclo (al perder la conexion), no en cada reintento.
+//
+// Lo que sigue bloqueando: el connect() TCP y la espera del CONNACK de
+// PubSubClient son sincronicos. Con un broker que acepta la sonda pero despues
+// no responde (sobrecargado, caido entre la sonda y el connect) el loop queda
+// frenado hasta MQTT_CONNECT_TIMEOUT_MS en el connect TCP mas otro tanto
+// esperando el CONNACK, unos 4 s por intento. El backoff espacia esos intentos.
+// Aparte, en el arranque setup() intenta la conexion WiFi rapida de main.cpp
+// (hasta FAST_CONNECT_ATTEMPTS x FAST_CONNECT_TIMEOUT_MS, 2 x 4 s) antes de
+// entrar al loop; en ese lapso no se atienden botones ni sondas. Sacar ambas
+// esperas requiere un cliente MQTT asincrono en lugar de PubSubClient.
+
+#include "hal.h"
+#include "config.h"
+
+#define MQTT_PROBE_SLOT (HAL_PROBE_SLOTS - 1)
+#define MQTT_BACKOFF_MIN_MS 1000UL
+#define MQTT_BACKOFF_MAX_MS 120000UL       // Tope del backoff (2 minutos)
+#define MQTT_PROBE_TIMEOUT_MS 3000UL
+#define MQTT_CONNECT_TIMEOUT_MS 2000       // Tope de connect() y aparte del CONNACK (bloqueantes)
+
+enum MqttLinkState { MQTT_LINK_WAITING, MQTT_LINK_PROBING };
+
+struct MqttLink {
+  MqttLinkState state;
+  uint8_t failures;             // Intentos fallidos seguidos (exponente del backoff)
+  unsigned long next_attempt;
+  unsigned long backoff_ms;     // Ultima espera aplicada
+};
+
+extern MqttLink mqttLink;
+
+// Avanza la maquina de estados mientras no haya sesion. Devuelve true cuando
+// el broker acepto el connect TCP de la sonda: recien ahi conviene llamar a
+// connect() de MQTT y despues informar el resultado con mqttLinkResult().
+bool mqttLinkReady(const char* server, uint16_t port);
+void mqttLinkResult(bool connected);
+// Configuracion nueva: descartar el backoff y reintentar ya
+void mqttLinkRestart();
+// IP del broker resuelto por la sonda (0 = ninguno)
+uint32_t mqttLinkAddress();
+// Acota la espera de powersave.h al proximo intento (solo sin sesion)
+void mqttLinkIdleBudget(unsigned long now, unsigned long& budget);
+// Espera antes del proximo intento tras failures fallos seguidos
+unsigned long mqttBackoffMs(uint8_t failures);
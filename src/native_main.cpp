@@ -0,0 +1,596 @@
+// Simulador nativo ([env:native]): corre el mismo loop() que el ESP8266
+// (appLoop) contra la HAL falsa con tiempo simulado. El escenario es
+// deterministico: ademas de imprimir el log de eventos verifica estados de
+// los pines, contadores y acks en momentos fijos, y termina con codigo 1 si
+// algun chequeo falla. Al final mide el costo por iteracion del loop, de
+// parsear la configuracion y de renderizar las respuestas de la API.
+//
+//   pio run -e native && .pio/build/native/program
+
+#ifndef ARDUINO
+
+#include <stdio.h>
+#include <stdarg.h>
+#include "hal.h"
+#include "app_loop.h"
+#include "render.h"
+#include "config.h"
+#include "metrics.h"
+#include "pulses.h"
+#include "buttons.h"
+#include "watchdog.h"
+#include "commands.h"
+#include "heartbeat.h"
+#include "sha256.h"
+#include "events.h"
+#include "mqtt_link.h"
+#include "journal.h"
+#include "ota.h"
+#include "powersave.h"
+
+#define SIM_STEP_MS 1                  // Paso del reloj simulado por iteracion
+#define SIM_DURATION_MS 300000UL       // 5 minutos simulados
+#define CONFIG_PARSE_ITERATIONS 10000
+#define RENDER_ITERATIONS 2000
+#define SIM_OTA_IMAGE_SIZE 65536
+#define SIM_OTA_RATE 32                // Bytes por ms del servidor HTTP simulado (~32 KB/s)
+#define SIM_OTA_URL "http://fw.lan:8000/firmware.bin"
+#define SIM_CMD_TOPIC "/watchdog/watchdog-001/cmd"
+#define SIM_GROUP_TOPIC "/watchdog/group/rack1/cmd"
+#define SIM_ACK_TOPIC "/watchdog/watchdog-001/response"
+#define SIM_STATUS_TOPIC "/watchdog/watchdog-001/status"
+#define SIM_JOURNAL_TOPIC "/watchdog/watchdog-001/journal"
+
+const char SAMPLE_CONFIG_JSON[] =
+  "{\"hostname\":\"atx-watchdog\",\"mqtt_server\":\"192.168.1.10\",\"mqtt_port\":1883,"
+  "\"client_id\":\"watchdog-001\",\"power_click_ms\":200,\"reset_click_ms\":200,"
+  "\"watchdog_enabled\":true,\"targets\":["
+  "{\"host\":\"server.lan\",\"port\":22,\"interval_ms\":10000,\"timeout_ms\":30000,\"action\":0},"
+  "{\"host\":\"nas.lan\",\"port\":80,\"interval_ms\":15000,\"timeout_ms\":60000,\"action\":2}]}";
+
+// Resultado de los chequeos del escenario
+int simChecks = 0;
+int simFailures = 0;
+
+void check(bool ok, const char* format, ...) __attribute__((format(printf, 2, 3)));
+void check(bool ok, const char* format, ...) {
+  simChecks++;
+  if (ok) return;
+  simFailures++;
+  char message[160];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+  halLog("[check] FALLO: %s\n", message);
+}
+
+// true si el ultimo ack publicado es el del comando id con ese status
+bool lastAckIs(const char* id, const char* status) {
+  char expected[COMMAND_ID_SIZE + 48];
+  const char* ack = simLastPublish(SIM_ACK_TOPIC);
+  snprintf(expected, sizeof(expected), "{\"id\":\"%s\"", id);
+  if (strncmp(ack, expected, strlen(expected)) != 0) return false;
+  snprintf(expected, sizeof(expected), "\"status\":\"%s\"", status);
+  return strstr(ack, expected) != nullptr;
+}
+
+// Ultimo pulso completo (LOW) de cada salida, muestreado despues de cada loop()
+struct PinWatch {
+  uint8_t pin;
+  bool low;
+  unsigned long start;
+  unsigned long last_start;
+  unsigned long last_ms;
+};
+
+PinWatch pinWatches[] = { { POWER_PIN, false, 0, 0, 0 }, { RESET_PIN, false, 0, 0, 0 } };
+
+void watchPins() {
+  for (PinWatch& w : pinWatches) {
+    bool low = !halDigitalRead(w.pin);
+    if (low && !w.low) w.start = halMillis();
+    if (!low && w.low) {
+      w.last_start = w.start;
+      w.last_ms = halMillis() - w.start;
+    }
+    w.low = low;
+  }
+}
+
+const PinWatch& lastPulse(uint8_t pin) {
+  return pin == POWER_PIN ? pinWatches[0] : pinWatches[1];
+}
+
+uint8_t simOtaImage[SIM_OTA_IMAGE_SIZE];
+
+// Imagen "nueva" para el servidor HTTP simulado
+void simBuildOtaImage() {
+  uint32_t x = 88172645UL;
+  for (size_t i = 0; i < sizeof(simOtaImage); i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    simOtaImage[i] = x;
+  }
+  simOtaImage[0] = 0xE9;
+}
+
+// Arma y firma un comando ota como lo haria ota_update.py. hashed_len
+// distinto del tamano de la imagen simula un hash que no coincide.
+void simOtaCommand(const char* id, const char* key, size_t hashed_len) {
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  Sha256 ctx;
+  sha256Init(ctx);
+  sha256Update(ctx, simOtaImage, hashed_len);
+  sha256Final(ctx, digest);
+  char sha_hex[SHA256_DIGEST_SIZE * 2 + 1];
+  toHex(digest, sizeof(digest), sha_hex);
+
+  char message[OTA_URL_SIZE + 80];
+  int n = snprintf(message, sizeof(message), OTA_SIGNATURE_PREFIX "%s %s", SIM_OTA_URL, sha_hex);
+  uint8_t mac[SHA256_DIGEST_SIZE];
+  hmacSha256((const uint8_t*)key, strlen(key), message, n, mac);
+  char sig_hex[SHA256_DIGEST_SIZE * 2 + 1];
+  toHex(mac, sizeof(mac), sig_hex);
+
+  char payload[COMMAND_MAX_PAYLOAD];
+  snprintf(payload, sizeof(payload), "{\"cmd\":\"ota\",\"id\":\"%s\",\"url\":\"%s\",\"sha256\":\"%s\",\"sig\":\"%s\"}",
+           id, SIM_OTA_URL, sha_hex, sig_hex);
+  simMqttDeliver(SIM_CMD_TOPIC, payload);
+}
+
+// Lo que hace setup() en un arranque: diario, chequeo de la imagen, ultimo
+// seq de los latidos (lo que no se guardo se pierde) y MQTT de cero. El resto del estado (objetivos, pulsos) sigue como estaba.
+void simReboot() {
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  char hex[SHA256_DIGEST_SIZE * 2 + 1];
+  simFirmwareDigest(digest);
+  toHex(digest, sizeof(digest), hex);
+  halLog("[sim] ---- reinicio (imagen en ejecucion sha256 %.16s...) ----\n", hex);
+  journalFlush();
+  setupJournal();
+  journalAppend(JOURNAL_BOOT, JOURNAL_NO_TARGET, 4, 0, "Software/System restart");
+  journalFlush();
+  setupOta();
+  setupHeartbeatRecord();
+  simSetMqttConnected(false);
+  mqttLinkRestart();
+  halIdleWake();
+}
+
+// Un ms simulado: una iteracion de loop() salvo que este en la espera de
+// ahorro de energia
+void simStep() {
+  if (!simIdling()) {
+    appLoop();
+    if (simTakeRestart()) simReboot();
+  }
+  watchPins();
+  simAdvance(SIM_STEP_MS);
+}
+
+// Arma y firma un latido como lo haria heartbeat_sender.py
+void simHeartbeat(const char* sender, uint64_t seq, const char* key) {
+  char datagram[HEARTBEAT_MAX_DATAGRAM];
+  int n = snprintf(datagram, sizeof(datagram), HEARTBEAT_PREFIX "%s %llu %lu", sender,
+                   (unsigned long long)seq, 1700000000UL + halMillis() / 1000);
+  uint8_t mac[SHA256_DIGEST_SIZE];
+  hmacSha256((const uint8_t*)key, strlen(key), datagram, n, mac);
+  datagram[n++] = ' ';
+  toHex(mac, sizeof(mac), datagram + n);
+  simSendHeartbeat(datagram);
+}
+
+// Eventos del escenario en tiempo simulado, en orden. Un chequeo en t ve el
+// estado que dejo el loop() de t - 1.
+void simScenario(unsigned long now) {
+  // workstation manda un latido por segundo, salvo entre 100 s y 130 s
+  if (now % 1000 == 500 && (now < 100000 || now >= 130000)) {
+    simHeartbeat("workstation", now / 1000, config.heartbeat_key);
+  }
+
+  static const char RESET_CMD[] = "{\"cmd\":\"reset\",\"duration\":300,\"id\":\"sim-1\"}";
+  static const char RACK_CMD[] =
+    "{\"cmd\":\"power\",\"id\":\"sim-2\",\"filter\":\"watchdog-0*\",\"stagger_ms\":20000}";
+  static const char OTHER_RACK_CMD[] = "{\"cmd\":\"power\",\"id\":\"sim-3\",\"filter\":\"rack2-*\"}";
+  static const char JOURNAL_CMD[] = "{\"cmd\":\"journal\",\"count\":3,\"id\":\"sim-4\"}";
+  static const char LONG_POWER_CMD[] = "{\"cmd\":\"power\",\"duration\":1000,\"id\":\"sim-6\"}";
+  unsigned long staggered = 240000 + staggerOffsetMs(config.client_id, 20000);
+
+  switch (now) {
+    case 10000:
+      check(halMqttConnected() && strstr(simLastPublish(SIM_STATUS_TOPIC), "\"online\"") != nullptr,
+            "sesion MQTT con estado online retenido");
+      break;
+    case 20000:
+      halLog("[sim] comando ota firmado con otra clave\n");
+      simOtaCommand("sim-ota-1", "otra-clave", SIM_OTA_IMAGE_SIZE);
+      break;
+    case 20001:
+      check(lastAckIs("sim-ota-1", "rejected") && strstr(simLastPublish(SIM_ACK_TOPIC), "bad_signature"),
+            "ota con otra clave rechazado: %s", simLastPublish(SIM_ACK_TOPIC));
+      break;
+    case 21000:
+      halLog("[sim] comando ota con un sha256 que no es el de la imagen servida\n");
+      simOtaCommand("sim-ota-2", config.ota_key, SIM_OTA_IMAGE_SIZE - 1);
+      break;
+    case 21001:
+      check(lastAckIs("sim-ota-2", "accepted"), "ota con hash equivocado aceptado hasta descargar");
+      break;
+    case 30000:
+      check(otaStatus.phase == OTA_IDLE && strcmp(otaStatus.error, "hash_mismatch") == 0 &&
+            otaRecord.state == OTA_IMAGE_NONE, "imagen con hash equivocado descartada (%s)", otaStatus.error);
+      halLog("[sim] backup.lan:22 deja de responder (escalera de recuperacion)\n");
+      simSetTcpTarget("backup.lan", 22, false, 0);
+      break;
+    case 35000:
+      halLog("[sim] comando ota valido (64 KB a ~32 KB/s)\n");
+      simOtaCommand("sim-ota-3", config.ota_key, SIM_OTA_IMAGE_SIZE);
+      break;
+    case 35001:
+      check(lastAckIs("sim-ota-3", "accepted"), "ota valido aceptado");
+      break;
+    case 45000:
+      check(otaRecord.state == OTA_IMAGE_CONFIRMED, "imagen nueva confirmada al llegar al broker");
+      break;
+    case 55000:
+      halLog("[sim] se abre el panel web (1 cliente SSE)\n");
+      simSetSseClients(1);
+      break;
+    case 60000:
+      halLog("[sim] server.lan:22 deja de responder\n");
+      simSetTcpTarget("server.lan", 22, false, 0);
+      break;
+    case 75000:
+      halLog("[sim] se cierra el panel web\n");
+      simSetSseClients(0);
+      break;
+    case 80000:
+      check(actionCounters.power_clicks == 0, "sin pulsos antes del timeout de server.lan");
+      break;
+    case 90000:
+      halLog("[sim] latido con clave equivocada y latido repetido\n");
+      simHeartbeat("workstation", now / 1000 + 1, "otra-clave");
+      simHeartbeat("workstation", 1, config.heartbeat_key);
+      break;
+    case 90400:
+      check(actionCounters.heartbeats_rejected == 2, "latidos falsos rechazados (%lu)",
+            (unsigned long)actionCounters.heartbeats_rejected);
+      break;
+    case 100000:
+      check(actionCounters.watchdog_timeouts == 1 && actionCounters.power_clicks == 1 &&
+            lastPulse(POWER_PIN).last_ms == (unsigned long)config.power_click_ms,
+            "timeout de server.lan: un pulso POWER de %d ms", config.power_click_ms);
+      break;
+    case 116000:
+      check(actionCounters.watchdog_timeouts == 2 && actionCounters.power_clicks == 1,
+            "latidos vencidos: alerta sin pulso");
+      break;
+    case 120000:
+      halLog("[sim] boton POWER fisico presionado\n");
+      simSetPin(POWER_BUTTON_PIN, false);
+      break;
+    case 120004:
+      simSetPin(POWER_BUTTON_PIN, true);   // Rebote
+      break;
+    case 120008:
+      simSetPin(POWER_BUTTON_PIN, false);
+      break;
+    case 120100:
+      simSetPin(POWER_BUTTON_PIN, true);
+      break;
+    case 121000:
+      check(actionCounters.power_clicks == 2 && lastPulse(POWER_PIN).last_start > 120100 &&
+            lastPulse(POWER_PIN).last_start <= 120100 + BUTTON_DEBOUNCE_MS + 1 &&
+            lastPulse(POWER_PIN).last_ms == (unsigned long)config.power_click_ms,
+            "boton con rebote: un solo pulso al soltar (inicio %lu)", lastPulse(POWER_PIN).last_start);
+      break;
+    case 150000:
+      halLog("[sim] comando MQTT reset\n");
+      check(simMqttDeliver(SIM_CMD_TOPIC, RESET_CMD), "topic de comandos suscripto");
+      break;
+    case 150001:
+      check(lastAckIs("sim-1", "accepted") && !halDigitalRead(RESET_PIN), "reset por MQTT: ack y RESET en LOW");
+      break;
+    case 150299:
+      check(!halDigitalRead(RESET_PIN), "RESET sigue en LOW antes de 300 ms");
+      break;
+    case 150301:
+      check(halDigitalRead(RESET_PIN) && lastPulse(RESET_PIN).last_start == 150000 &&
+            lastPulse(RESET_PIN).last_ms == 300, "pulso RESET de 300 ms (%lu ms)", lastPulse(RESET_PIN).last_ms);
+      break;
+    case 154000:
+      halLog("[sim] comando MQTT power de 1 s justo antes del timeout de server.lan\n");
+      simMqttDeliver(SIM_CMD_TOPIC, LONG_POWER_CMD);
+      break;
+    case 155500:
+      check(lastPulse(POWER_PIN).last_start == 154000 && targetStates[0].consecutive_failures >= 6,
+            "timeout con el pin ocupado: queda armado (%d fallos)", targetStates[0].consecutive_failures);
+      break;
+    case 160000:
+      check(lastPulse(POWER_PIN).last_start > 155000 &&
+            lastPulse(POWER_PIN).last_ms == (unsigned long)config.power_click_ms,
+            "timeout reintentado en la sonda siguiente (inicio %lu)", lastPulse(POWER_PIN).last_start);
+      halLog("[sim] nas.lan responde lento (120 ms)\n");
+      simSetProbeResponse("nas.lan", 80, "HTTP/1.1 200 OK", 120);
+      break;
+    case 180000:
+      halLog("[sim] server.lan:22 vuelve a responder\n");
+      simSetTcpTarget("server.lan", 22, true, 3);
+      break;
+    case 195000:
+      check(targetStates[0].consecutive_failures == 0, "server.lan recuperado");
+      halLog("[sim] nas.lan vuelve a responder rapido\n");
+      simSetProbeResponse("nas.lan", 80, "HTTP/1.1 200 OK", 15);
+      break;
+    case 200000:
+      halLog("[sim] boton POWER fisico mantenido 6 s\n");
+      simSetPin(POWER_BUTTON_PIN, false);
+      break;
+    case 202000:
+      check(halDigitalRead(POWER_PIN), "sin pulso mientras el boton sigue apretado");
+      break;
+    case 206000:
+      simSetPin(POWER_BUTTON_PIN, true);
+      break;
+    case 208500:
+      check(lastPulse(POWER_PIN).last_start == 200000 + BUTTON_LONG_PRESS_MS &&
+            lastPulse(POWER_PIN).last_ms == FORCE_OFF_MS,
+            "pulsacion larga: apagado forzado de %d ms (%lu ms desde %lu)", FORCE_OFF_MS,
+            lastPulse(POWER_PIN).last_ms, lastPulse(POWER_PIN).last_start);
+      break;
+    case 240000:
+      halLog("[sim] comando de grupo power escalonado en 20 s y otro para rack2 (se ignora)\n");
+      check(simMqttDeliver(SIM_GROUP_TOPIC, RACK_CMD), "topic del grupo rack1 suscripto");
+      check(simMqttDeliver(MQTT_BROADCAST_TOPIC, OTHER_RACK_CMD), "topic de difusion suscripto");
+      check(!simMqttDeliver("/watchdog/group/rack9/cmd", RACK_CMD), "grupo ajeno sin suscripcion");
+      break;
+    case 240001:
+      check(lastAckIs("sim-2", "accepted"), "solo responde el comando que coincide con el filtro");
+      break;
+    case 250000:
+      halLog("[sim] se cae el broker MQTT\n");
+      simSetMqttConnected(false);
+      simSetTcpTarget("broker.lan", 1883, false, 0);
+      break;
+    case 250001:
+      check(strcmp(simLastPublish(SIM_STATUS_TOPIC), MQTT_OFFLINE_PAYLOAD) == 0, "Last Will offline retenido");
+      break;
+    case 250500:
+      check(lastPulse(POWER_PIN).last_start == staggered, "pulso escalonado en %lu (fue en %lu)",
+            staggered, lastPulse(POWER_PIN).last_start);
+      break;
+    case 255000:
+      halLog("[sim] boton RESET fisico presionado sin MQTT\n");
+      simSetPin(RESET_BUTTON_PIN, false);
+      break;
+    case 255100:
+      simSetPin(RESET_BUTTON_PIN, true);
+      break;
+    case 256000:
+      check(!halMqttConnected() && lastPulse(RESET_PIN).last_start > 255000 &&
+            lastPulse(RESET_PIN).last_start < 255100, "boton RESET funciona sin MQTT");
+      break;
+    case 275000:
+      halLog("[sim] vuelve el broker MQTT\n");
+      simSetTcpTarget("broker.lan", 1883, true, 2);
+      break;
+    case 290000:
+      check(halMqttConnected() && strstr(simLastPublish(SIM_STATUS_TOPIC), "\"online\"") != nullptr,
+            "reconexion al broker con backoff");
+      halLog("[sim] comando MQTT journal (ultimos 3 registros)\n");
+      simMqttDeliver(SIM_CMD_TOPIC, JOURNAL_CMD);
+      break;
+    case 290001:
+      check(lastAckIs("sim-4", "accepted") && strstr(simLastPublish(SIM_JOURNAL_TOPIC), "\"mqtt_connected\""),
+            "diario por MQTT: %s", simLastPublish(SIM_JOURNAL_TOPIC));
+      break;
+  }
+}
+
+void printSectionStats() {
+  printf("\n%-16s %10s %10s %10s %8s\n", "seccion", "iter", "prom_us", "max_us", "stalls");
+  for (int s = 0; s < SEC_COUNT; s++) {
+    const LatencyStats& st = loopStats[s];
+    if (st.count == 0) continue;
+    printf("%-16s %10lu %10.2f %10lu %8lu\n", SECTION_NAMES[s], (unsigned long)st.count,
+           (double)st.sum_us / st.count, (unsigned long)st.max_us, (unsigned long)st.stalls);
+  }
+}
+
+void benchConfigParse() {
+  JsonDocument doc;
+  Config cfg;
+  uint32_t start = halMicros();
+  for (int i = 0; i < CONFIG_PARSE_ITERATIONS; i++) {
+    setDefaultConfig(cfg);
+    deserializeJson(doc, SAMPLE_CONFIG_JSON);
+    configFromJson(doc.as<JsonVariantConst>(), cfg);
+  }
+  uint32_t elapsed = halMicros() - start;
+  printf("configFromJson: %.2f us por parseo (%d iteraciones)\n",
+         (double)elapsed / CONFIG_PARSE_ITERATIONS, CONFIG_PARSE_ITERATIONS);
+}
+
+// Descarta lo renderizado; solo cuenta los bytes
+class NullPrint : public Print {
+public:
+  size_t bytes = 0;
+  size_t write(uint8_t) override {
+    bytes++;
+    return 1;
+  }
+  size_t write(const uint8_t*, size_t size) override {
+    bytes += size;
+    return size;
+  }
+};
+
+// Guarda lo renderizado (truncado) para revisarlo
+class BufferPrint : public Print {
+public:
+  char text[8192] = {};
+  size_t len = 0;
+  size_t write(uint8_t c) override {
+    if (len + 1 < sizeof(text)) text[len++] = (char)c;
+    return 1;
+  }
+};
+
+void benchRender(const char* name, void (*render)(Print&)) {
+  NullPrint out;
+  uint32_t start = halMicros();
+  for (int i = 0; i < RENDER_ITERATIONS; i++) render(out);
+  uint32_t elapsed = halMicros() - start;
+  printf("%-16s %.2f us por respuesta (%lu bytes, %d iteraciones)\n", name,
+         (double)elapsed / RENDER_ITERATIONS, (unsigned long)(out.bytes / RENDER_ITERATIONS), RENDER_ITERATIONS);
+}
+
+void simSetTarget(int index, const char* host, int port, int interval_ms, int timeout_ms, uint8_t action) {
+  WatchdogTarget& t = config.targets[index];
+  strlcpy(t.host, host, sizeof(t.host));
+  t.port = port;
+  t.check_interval_ms = interval_ms;
+  t.timeout_ms = timeout_ms;
+  t.action = action;
+}
+
+int main() {
+  setDefaultConfig(config);
+  config.watchdog_enabled = true;
+  simSetTarget(0, "server.lan", 22, 10000, 30000, ACTION_POWER);
+  simSetTarget(1, "nas.lan", 80, 15000, 60000, ACTION_ALERT);
+  simSetTarget(2, "backup.lan", 22, 10000, 30000, ACTION_ESCALATE);
+  config.recovery[2].cooldown_ms = 120000;   // La segunda escalera empieza durante la simulacion
+  simSetTarget(3, "workstation", 4210, 3000, 15000, ACTION_ALERT);
+  config.probes[3].type = PROBE_HEARTBEAT;
+  // Claves de solo escritura: la primera se fija sola, despues pide la actual
+  char* hbKey = config.heartbeat_key;
+  check(updateSecretKey(hbKey, sizeof(config.heartbeat_key), "sim-secret", false, nullptr) == SECRET_UPDATED &&
+        updateSecretKey(hbKey, sizeof(config.heartbeat_key), "otra", false, "") == SECRET_DENIED &&
+        updateSecretKey(hbKey, sizeof(config.heartbeat_key), "", true, "mal") == SECRET_DENIED &&
+        updateSecretKey(hbKey, sizeof(config.heartbeat_key), "", false, nullptr) == SECRET_UNCHANGED &&
+        strcmp(hbKey, "sim-secret") == 0,
+        "clave de latidos: sin la actual no se cambia ni se borra");
+  strlcpy(config.ota_key, "sim-ota-key", sizeof(config.ota_key));
+  BufferPrint exported;
+  renderConfigJson(exported);
+  check(strstr(exported.text, "sim-secret") == nullptr && strstr(exported.text, "sim-ota-key") == nullptr &&
+        strstr(exported.text, "\"ota_key_set\":true") != nullptr,
+        "/api/config informa las claves sin exportarlas");
+  config.power_save_mode = POWER_SAVE_LIGHT;
+  simBuildOtaImage();
+  simSetHttpFile(simOtaImage, sizeof(simOtaImage), SIM_OTA_RATE);
+  simSetTcpTarget("fw.lan", 8000, true, 4);
+
+  simSetTcpTarget("server.lan", 22, true, 3);
+  simSetTcpTarget("nas.lan", 80, true, 12);
+  simSetTcpTarget("backup.lan", 22, true, 5);
+  simSetProbeResponse("server.lan", 22, "SSH-2.0-OpenSSH_9.6", 8);
+  simSetProbeResponse("nas.lan", 80, "HTTP/1.1 200 OK", 15);
+  config.probes[0].type = PROBE_BANNER;
+  strlcpy(config.probes[0].match, "SSH-2.0", sizeof(config.probes[0].match));
+  config.probes[1].type = PROBE_HTTP;
+  strlcpy(config.probes[1].match, "/health", sizeof(config.probes[1].match));
+  strlcpy(config.mqtt_server, "broker.lan", sizeof(config.mqtt_server));
+  strlcpy(config.mqtt_groups, "rack1", sizeof(config.mqtt_groups));
+  simSetTcpTarget("broker.lan", 1883, true, 2);
+  setupJournal();
+  journalAppend(JOURNAL_BOOT, JOURNAL_NO_TARGET, 0, 0, "Power On");
+  journalFlush();
+  setupOta();
+  scheduleWatchdogTargets();
+  setupPhysicalButtons();
+  setupHeartbeatRecord();
+  setupHeartbeatListener();
+  setupPowerSave();
+
+  while (halMillis() < SIM_DURATION_MS) {
+    simScenario(halMillis());
+    simStep();
+  }
+
+  // Segunda parte: una imagen que no llega al broker vuelve sola a la anterior
+  // Otra imagen (un byte distinto), asi se ve a cual se vuelve
+  simOtaImage[SIM_OTA_IMAGE_SIZE / 2] ^= 0x01;
+  uint8_t previousImage[SHA256_DIGEST_SIZE];
+  simFirmwareDigest(previousImage);
+  halLog("[sim] comando ota valido; despues del reinicio el broker no responde\n");
+  simOtaCommand("sim-ota-4", config.ota_key, SIM_OTA_IMAGE_SIZE);
+  bool brokerDown = false;
+  for (unsigned long end = halMillis() + OTA_HEALTH_DEADLINE_MS + 20000; halMillis() < end;) {
+    if (halMillis() % 1000 == 500) simHeartbeat("workstation", halMillis() / 1000, config.heartbeat_key);
+    if (!brokerDown && otaRecord.state == OTA_IMAGE_TRIAL) {
+      simSetTcpTarget("broker.lan", 1883, false, 0);
+      brokerDown = true;
+    }
+    if (brokerDown && otaRecord.state == OTA_IMAGE_ROLLED_BACK && halMqttConnected() == false) {
+      simSetTcpTarget("broker.lan", 1883, true, 2);
+    }
+    simStep();
+  }
+  uint8_t runningImage[SHA256_DIGEST_SIZE];
+  simFirmwareDigest(runningImage);
+  check(otaRecord.state == OTA_IMAGE_ROLLED_BACK && memcmp(runningImage, previousImage, sizeof(runningImage)) == 0,
+        "sin broker la imagen nueva vuelve a la anterior");
+  check(halMqttConnected(), "la imagen anterior vuelve a conectarse al broker");
+  // Segunda escalera de backup.lan: cuenta desde el fin del cooldown, pero
+  // el tiempo sin respuesta sigue siendo el de toda la caida
+  const TargetState& backup = targetStates[2];
+  check(backup.recovery_attempts == 1 && backup.recovery_step == 1 &&
+        halMillis() - backup.last_success > 500000,
+        "segunda escalera sin perder el inicio de la caida (paso %d, %lu ms sin respuesta)",
+        backup.recovery_step, halMillis() - backup.last_success);
+  // Corte sin guardar nada antes: un latido capturado hace dos minutos sigue
+  // rechazado con el seq que quedo en flash
+  uint64_t captured = halMillis() / 1000 - 2 * HEARTBEAT_SAVE_INTERVAL_MS / 1000;
+  simReboot();
+  simHeartbeat("workstation", captured, config.heartbeat_key);
+  for (int i = 0; i < 300; i++) simStep();
+  check(actionCounters.heartbeats_rejected == 3, "latido repetido rechazado despues de un reinicio");
+  // Filtro con demasiados comodines: se rechaza antes de compararlo
+  halLog("[sim] comando con un filtro de 30 comodines\n");
+  simMqttDeliver(MQTT_BROADCAST_TOPIC,
+                 "{\"cmd\":\"power\",\"id\":\"sim-5\",\"filter\":\"*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a\"}");
+  check(lastAckIs("sim-5", "rejected") && strstr(simLastPublish(SIM_ACK_TOPIC), "invalid_filter"),
+        "filtro con mas de %d comodines rechazado", COMMAND_FILTER_MAX_STARS);
+  check(matchesClientFilter("rack2-*,w*-0*1", "watchdog-001") && matchesClientFilter("*", "") &&
+        !matchesClientFilter("w*-0*2,*x", "watchdog-001") &&
+        !matchesClientFilter("*a*a*a*b", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"),
+        "glob iterativo");
+  check(simHeartbeatRecordWriteCount() <= halMillis() / HEARTBEAT_SAVE_INTERVAL_MS + 3,
+        "ultimo seq guardado a lo sumo una vez por minuto (%lu escrituras en %lu s)",
+        simHeartbeatRecordWriteCount(), halMillis() / 1000);
+  check(actionCounters.power_clicks == 9 && actionCounters.reset_clicks == 4 &&
+        actionCounters.watchdog_timeouts == 6 && actionCounters.heartbeats_rejected == 3,
+        "acciones del escenario completo");
+
+  printf("\nAcciones: power=%lu reset=%lu timeouts=%lu sondas_ok=%lu sondas_fallidas=%lu "
+         "latidos=%lu latidos_rechazados=%lu\n",
+         (unsigned long)actionCounters.power_clicks, (unsigned long)actionCounters.reset_clicks,
+         (unsigned long)actionCounters.watchdog_timeouts, (unsigned long)actionCounters.probes_ok,
+         (unsigned long)actionCounters.probes_failed, (unsigned long)actionCounters.heartbeats_ok,
+         (unsigned long)actionCounters.heartbeats_rejected);
+  printf("Energia: modo %s, CPU activo %.1f%% (ultima ventana), ~%.1f mA estimados, "
+         "%lu ms en espera, %lu esperas (%lu cortadas antes de tiempo)\n",
+         powerSaveModeName(config.power_save_mode), powerSaveDutyPct(), powerSaveEstimatedMa(),
+         (unsigned long)powerSaveStats.idle_ms, (unsigned long)powerSaveStats.idles,
+         (unsigned long)powerSaveStats.wakeups);
+  // Reinicio simulado: el diario sobrevive y el arranque siguiente continua la cuenta
+  journalFlush();
+  printf("\nDiario: %lu registros en %lu escrituras a flash\n", (unsigned long)journalLastSeq(),
+         simJournalWriteCount());
+  setupJournal();
+
+  printSectionStats();
+  benchConfigParse();
+  benchRender("/api/status", renderStatusJson);
+  benchRender("/api/config", renderConfigJson);
+  benchRender("/metrics", renderMetrics);
+
+  printf("\nChequeos: %d, fallidos: %d\n", simChecks, simFailures);
+  return simFailures == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,525 @@
+#include "ota.h"
+#include "events.h"
+#include "journal.h"
+#include "heartbeat.h"
+#include "pulses.h"
+
+static_assert(OTA_PROBE_SLOT >= MAX_WATCHDOG_TARGETS, "el slot del OTA no puede ser de un objetivo");
+
+#define OTA_RECORD_MAGIC 0x3141544FUL    // "OTA1"
+#define OTA_RESTART_DELAY_MS 1000        // Para que salgan los eventos antes del reinicio
+
+const char* const OTA_PHASE_NAMES[] = {
+  "idle", "resolving", "backup", "request", "headers", "download", "rollback", "restarting",
+};
+const char* const OTA_IMAGE_STATE_NAMES[] = { "none", "trial", "confirmed", "rolled_back", "rollback_failed" };
+
+OtaRecord otaRecord = {};
+OtaStatus otaStatus = {};
+uint8_t otaBuffer[OTA_CHUNK_SIZE];     // Bloque pendiente de escribir
+Sha256 otaHash;
+unsigned long otaTrialStart = 0;
+
+// Linea de status/header en curso (lo que no entra se descarta)
+char otaLine[96];
+size_t otaLineLen = 0;
+int otaHttpStatus = 0;
+
+const char* otaPhaseName(OtaPhase phase) {
+  return phase <= OTA_RESTARTING ? OTA_PHASE_NAMES[phase] : "?";
+}
+
+const char* otaImageStateName(uint8_t state) {
+  return state <= OTA_IMAGE_ROLLBACK_FAILED ? OTA_IMAGE_STATE_NAMES[state] : "?";
+}
+
+bool otaBusy() {
+  return otaStatus.phase != OTA_IDLE;
+}
+
+uint32_t otaRecordCrc(const OtaRecord& r) {
+  OtaRecord copy = r;
+  copy.crc = 0;
+  return crc32Update(0, (const uint8_t*)&copy, sizeof(copy));
+}
+
+void saveOtaRecord() {
+  otaRecord.magic = OTA_RECORD_MAGIC;
+  otaRecord.crc = otaRecordCrc(otaRecord);
+  if (!halOtaRecordSave(&otaRecord, sizeof(otaRecord))) halLog("OTA: no se pudo guardar el estado\n");
+}
+
+bool parseOtaUrl(const char* url, char* host, size_t host_size, uint16_t& port, char* path, size_t path_size) {
+  if (strncmp(url, "http://", 7) != 0) return false;
+  for (const char* p = url; *p != '\0'; p++) {
+    if (*p == '"' || *p == '\\' || (uint8_t)*p < 0x21 || (uint8_t)*p > 0x7e) return false;
+  }
+
+  const char* h = url + 7;
+  const char* slash = strchr(h, '/');
+  const char* host_end = slash != nullptr ? slash : h + strlen(h);
+  if (memchr(h, '@', host_end - h) != nullptr) return false;
+
+  const char* colon = (const char*)memchr(h, ':', host_end - h);
+  port = 80;
+  if (colon != nullptr) {
+    char* end;
+    unsigned long value = strtoul(colon + 1, &end, 10);
+    if (end != host_end || value == 0 || value > 65535) return false;
+    port = value;
+  }
+  size_t host_len = (colon != nullptr ? colon : host_end) - h;
+  if (host_len == 0 || host_len >= host_size) return false;
+  memcpy(host, h, host_len);
+  host[host_len] = '\0';
+
+  const char* path_src = slash != nullptr ? slash : "/";
+  if (strlen(path_src) >= path_size) return false;
+  strlcpy(path, path_src, path_size);
+  return true;
+}
+
+// 64 digitos hex (mayusculas o minusculas)
+bool parseHexDigest(const char* hex, uint8_t out[SHA256_DIGEST_SIZE]) {
+  if (strlen(hex) != SHA256_DIGEST_SIZE * 2) return false;
+  for (int i = 0; i < SHA256_DIGEST_SIZE * 2; i++) {
+    char c = hex[i];
+    int v;
+    if (c >= '0' && c <= '9') v = c - '0';
+    else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+    else return false;
+    if (i % 2 == 0) out[i / 2] = v << 4;
+    else out[i / 2] |= v;
+  }
+  return true;
+}
+
+bool verifyOtaSignature(const char* url, const char* sha256_hex, const char* sig_hex, const char* key) {
+  if (key[0] == '\0' || strlen(sig_hex) != SHA256_DIGEST_SIZE * 2) return false;
+  char message[OTA_URL_SIZE + SHA256_DIGEST_SIZE * 2 + 8];
+  int n = snprintf(message, sizeof(message), OTA_SIGNATURE_PREFIX "%s %s", url, sha256_hex);
+  if (n >= (int)sizeof(message)) return false;
+
+  uint8_t mac[SHA256_DIGEST_SIZE];
+  char expected[SHA256_DIGEST_SIZE * 2 + 1];
+  hmacSha256((const uint8_t*)key, strlen(key), message, n, mac);
+  toHex(mac, sizeof(mac), expected);
+  return constantTimeEquals(expected, sig_hex, SHA256_DIGEST_SIZE * 2);
+}
+
+void publishOtaProgress() {
+  publishLiveUpdate("ota", "\"phase\":\"%s\",\"image\":\"%s\",\"received\":%lu,\"size\":%lu,\"error\":\"%s\"",
+                    otaPhaseName(otaStatus.phase), otaImageStateName(otaRecord.state),
+                    (unsigned long)otaStatus.received, (unsigned long)otaStatus.total, otaStatus.error);
+}
+
+void otaFail(const char* reason) {
+  OtaPhase phase = otaStatus.phase;
+  halLog("OTA: fallo en %s (%s)\n", otaPhaseName(phase), reason);
+  halProbeAbort(OTA_PROBE_SLOT);
+  halFetchClose();
+  halBackupClose();
+  if (otaStatus.updating) halUpdateEnd(false);
+  otaStatus.updating = false;
+  strlcpy(otaStatus.error, reason, sizeof(otaStatus.error));
+  otaStatus.phase = OTA_IDLE;
+
+  if (phase == OTA_ROLLBACK) {
+    // La copia no sirve: no queda otra que seguir con la imagen nueva
+    otaRecord.state = OTA_IMAGE_ROLLBACK_FAILED;
+    saveOtaRecord();
+    publishQueuedEvent("ota_rollback", "\"status\":\"failed\",\"reason\":\"%s\"", reason);
+    journalAppend(JOURNAL_OTA_ROLLBACK, JOURNAL_NO_TARGET, 2, otaStatus.received, reason);
+  } else {
+    publishQueuedEvent("ota_failed", "\"phase\":\"%s\",\"reason\":\"%s\",\"received\":%lu",
+                       otaPhaseName(phase), reason, (unsigned long)otaStatus.received);
+    journalAppend(JOURNAL_OTA_FAILED, JOURNAL_NO_TARGET, phase, otaStatus.received, reason);
+  }
+  publishOtaProgress();
+}
+
+bool otaStart(const char* url, const char* sha256_hex, const char* sig_hex, const char*& reason) {
+  uint8_t expected[SHA256_DIGEST_SIZE];
+  reason = nullptr;
+  if (config.ota_key[0] == '\0') {
+    reason = "disabled";
+  } else if (otaBusy()) {
+    reason = "busy";
+  } else if (otaRecord.state == OTA_IMAGE_TRIAL) {
+    // Primero se confirma (o se descarta) la imagen que esta a prueba
+    reason = "trial_pending";
+  } else if (strlen(url) >= OTA_URL_SIZE ||
+             !parseOtaUrl(url, otaStatus.host, sizeof(otaStatus.host), otaStatus.port,
+                          otaStatus.path, sizeof(otaStatus.path))) {
+    reason = "invalid_url";
+  } else if (!parseHexDigest(sha256_hex, expected)) {
+    reason = "invalid_sha256";
+  } else if (!verifyOtaSignature(url, sha256_hex, sig_hex, config.ota_key)) {
+    reason = "bad_signature";
+  }
+  if (reason != nullptr) {
+    halLog("OTA rechazado: %s\n", reason);
+    return false;
+  }
+
+  memcpy(otaStatus.expected, expected, sizeof(expected));
+  otaStatus.error[0] = '\0';
+  otaStatus.total = 0;
+  otaStatus.received = 0;
+  otaStatus.fill = 0;
+  otaStatus.updating = false;
+  otaStatus.last_progress = 0;
+
+  halProbeFlushDns(OTA_PROBE_SLOT);
+  ProbeRequest request = { PROBE_TCP, otaStatus.host, otaStatus.port, "", 0, OTA_PROBE_TIMEOUT_MS };
+  halProbeStart(OTA_PROBE_SLOT, request);
+  otaStatus.phase = OTA_RESOLVING;
+
+  halLog("OTA: actualizando desde %s\n", url);
+  publishQueuedEvent("ota_started", "\"url\":\"%s\"", url);
+  journalAppend(JOURNAL_OTA_STARTED, JOURNAL_NO_TARGET, otaStatus.port, 0, otaStatus.host);
+  publishOtaProgress();
+  return true;
+}
+
+void otaStartRollback(const char* reason) {
+  halLog("OTA: la imagen nueva no paso el chequeo de salud (%s), volviendo a la anterior\n", reason);
+  publishQueuedEvent("ota_rollback", "\"status\":\"started\",\"reason\":\"%s\",\"boots\":%u",
+                     reason, otaRecord.boots);
+  journalAppend(JOURNAL_OTA_ROLLBACK, JOURNAL_NO_TARGET, 0, otaRecord.boots, reason);
+
+  otaStatus.phase = OTA_ROLLBACK;
+  otaStatus.error[0] = '\0';
+  otaStatus.total = otaRecord.backup_size;
+  otaStatus.received = 0;
+  otaStatus.fill = 0;
+  otaStatus.last_progress = 0;
+  memcpy(otaStatus.expected, otaRecord.backup_sha256, sizeof(otaStatus.expected));
+  if (otaRecord.backup_size == 0 || !halUpdateBegin(otaRecord.backup_size)) {
+    otaFail("no_backup");
+    return;
+  }
+  otaStatus.updating = true;
+  sha256Init(otaHash);
+}
+
+// Imagen completa y verificada: queda lista para el bootloader
+void otaInstalled() {
+  otaStatus.updating = false;
+  halFetchClose();
+  halBackupClose();
+
+  if (otaStatus.phase == OTA_DOWNLOAD) {
+    otaRecord.state = OTA_IMAGE_TRIAL;
+    otaRecord.boots = 0;
+    otaRecord.reported = 0;
+    memcpy(otaRecord.image_sha256, otaStatus.expected, sizeof(otaRecord.image_sha256));
+    saveOtaRecord();
+    char digest[SHA256_DIGEST_SIZE * 2 + 1];
+    toHex(otaStatus.expected, sizeof(otaStatus.expected), digest);
+    halLog("OTA: imagen verificada (%lu bytes, sha256 %.16s...), reiniciando\n",
+           (unsigned long)otaStatus.total, digest);
+    publishQueuedEvent("ota_installed", "\"size\":%lu,\"sha256\":\"%s\"", (unsigned long)otaStatus.total, digest);
+    digest[32] = '\0';
+    journalAppend(JOURNAL_OTA_INSTALLED, JOURNAL_NO_TARGET, 0, otaStatus.total, digest);
+  } else {
+    otaRecord.state = OTA_IMAGE_ROLLED_BACK;
+    otaRecord.reported = 0;
+    saveOtaRecord();
+    halLog("OTA: imagen anterior reinstalada (%lu bytes), reiniciando\n", (unsigned long)otaStatus.total);
+    journalAppend(JOURNAL_OTA_ROLLBACK, JOURNAL_NO_TARGET, 1, otaStatus.total, nullptr);
+  }
+  otaStatus.phase = OTA_RESTARTING;
+  otaStatus.last_data = halMillis();
+  publishOtaProgress();
+}
+
+// Agrega n bytes recien copiados en otaBuffer + fill. Los bloques completos
+// se escriben; el ultimo solo despues de verificar el hash de toda la imagen.
+void otaAccept(size_t n) {
+  sha256Update(otaHash, otaBuffer + otaStatus.fill, n);
+  otaStatus.fill += n;
+  otaStatus.received += n;
+  otaStatus.last_data = halMillis();
+
+  uint8_t pct = (uint64_t)otaStatus.received * 100 / otaStatus.total;
+  if (pct >= otaStatus.last_progress + OTA_PROGRESS_STEP) {
+    otaStatus.last_progress = pct - pct % OTA_PROGRESS_STEP;
+    halLog("OTA: %s %u%% (%lu/%lu bytes)\n", otaPhaseName(otaStatus.phase), otaStatus.last_progress,
+           (unsigned long)otaStatus.received, (unsigned long)otaStatus.total);
+    publishOtaProgress();
+  }
+
+  if (otaStatus.received == otaStatus.total) {
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    sha256Final(otaHash, digest);
+    if (!constantTimeEquals(digest, otaStatus.expected, sizeof(digest))) {
+      otaFail("hash_mismatch");
+      return;
+    }
+    if (!halUpdateWrite(otaBuffer, otaStatus.fill) || !halUpdateEnd(true)) {
+      otaFail("flash_write");
+      return;
+    }
+    otaInstalled();
+    return;
+  }
+
+  if (otaStatus.fill == OTA_CHUNK_SIZE) {
+    if (!halUpdateWrite(otaBuffer, otaStatus.fill)) {
+      otaFail("flash_write");
+      return;
+    }
+    otaStatus.fill = 0;
+  }
+}
+
+void otaHeaderLine(const char* line) {
+  if (otaHttpStatus == 0) {
+    // "HTTP/1.1 200 OK"
+    if (strncmp(line, "HTTP/1.", 7) != 0 || strlen(line) < 12) {
+      otaHttpStatus = -1;
+    } else {
+      otaHttpStatus = atoi(line + 9);
+    }
+  } else if (strncasecmp(line, "Content-Length:", 15) == 0) {
+    otaStatus.total = strtoul(line + 15, nullptr, 10);
+  }
+}
+
+bool otaBeginBody() {
+  if (otaHttpStatus != 200) {
+    char reason[16];
+    snprintf(reason, sizeof(reason), "http_%d", otaHttpStatus);
+    otaFail(reason);
+    return false;
+  }
+  if (otaStatus.total == 0) {
+    otaFail("no_length");
+    return false;
+  }
+  if (!halUpdateBegin(otaStatus.total)) {
+    otaFail("too_large");
+    return false;
+  }
+  otaStatus.updating = true;
+  sha256Init(otaHash);
+  otaStatus.received = 0;
+  otaStatus.fill = 0;
+  otaStatus.phase = OTA_DOWNLOAD;
+  halLog("OTA: descargando %lu bytes\n", (unsigned long)otaStatus.total);
+  return true;
+}
+
+void otaReadHeaders(unsigned long now) {
+  uint8_t rx[128];
+  int n = halFetchRead(rx, sizeof(rx));
+  if (n < 0) {
+    otaFail("closed");
+    return;
+  }
+  if (n == 0) {
+    if (now - otaStatus.last_data > OTA_STALL_TIMEOUT_MS) otaFail("timeout");
+    return;
+  }
+  otaStatus.last_data = now;
+
+  for (int i = 0; i < n; i++) {
+    char c = rx[i];
+    if (c != '\n') {
+      if (c != '\r' && otaLineLen < sizeof(otaLine) - 1) otaLine[otaLineLen++] = c;
+      continue;
+    }
+    otaLine[otaLineLen] = '\0';
+    if (otaLineLen == 0) {
+      // Linea vacia: lo que sigue ya es la imagen
+      if (!otaBeginBody()) return;
+      size_t rest = n - i - 1;
+      if (rest > otaStatus.total) rest = otaStatus.total;
+      if (rest > 0) {
+        memcpy(otaBuffer, rx + i + 1, rest);
+        otaAccept(rest);
+      }
+      return;
+    }
+    otaHeaderLine(otaLine);
+    otaLineLen = 0;
+  }
+}
+
+void otaReadBody(unsigned long now) {
+  size_t want = OTA_CHUNK_SIZE - otaStatus.fill;
+  if (want > otaStatus.total - otaStatus.received) want = otaStatus.total - otaStatus.received;
+  int n = halFetchRead(otaBuffer + otaStatus.fill, want);
+  if (n < 0) {
+    otaFail("closed");
+    return;
+  }
+  if (n == 0) {
+    if (now - otaStatus.last_data > OTA_STALL_TIMEOUT_MS) otaFail("timeout");
+    return;
+  }
+  otaAccept(n);
+}
+
+void otaRollbackStep() {
+  size_t want = OTA_CHUNK_SIZE - otaStatus.fill;
+  if (want > otaStatus.total - otaStatus.received) want = otaStatus.total - otaStatus.received;
+  if (!halBackupRead(otaStatus.received, otaBuffer + otaStatus.fill, want)) {
+    otaFail("backup_read");
+    return;
+  }
+  otaAccept(want);
+}
+
+// Lanza el connect de la descarga; el GET sale cuando el servidor acepta
+void otaSendRequest(unsigned long now) {
+  static char request[sizeof(otaStatus.path) + sizeof(otaStatus.host) + 80];
+  snprintf(request, sizeof(request),
+           "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: atx-watchdog\r\nConnection: close\r\n\r\n",
+           otaStatus.path, otaStatus.host);
+  otaStatus.phase = OTA_REQUEST;
+  if (!halFetchOpen(halProbeAddress(OTA_PROBE_SLOT), otaStatus.port, request)) {
+    otaFail("connect");
+    return;
+  }
+  otaLineLen = 0;
+  otaHttpStatus = 0;
+  otaStatus.last_data = now;
+}
+
+void otaPollConnect(unsigned long now) {
+  ProbeResult result = halFetchPoll();
+  if (result == PROBE_PENDING) {
+    if (now - otaStatus.last_data > OTA_CONNECT_TIMEOUT_MS) otaFail("connect");
+    return;
+  }
+  if (result != PROBE_OK) {
+    otaFail("connect");
+    return;
+  }
+  otaStatus.last_data = now;
+  otaStatus.phase = OTA_HEADERS;
+}
+
+void otaBackupStep() {
+  size_t n = otaStatus.total - otaStatus.received;
+  if (n > OTA_CHUNK_SIZE) n = OTA_CHUNK_SIZE;
+  if (!halFirmwareRead(otaStatus.received, otaBuffer, n) || !halBackupWrite(otaBuffer, n)) {
+    otaFail("backup_write");
+    return;
+  }
+  sha256Update(otaHash, otaBuffer, n);
+  otaStatus.received += n;
+  if (otaStatus.received < otaStatus.total) return;
+
+  halBackupClose();
+  otaRecord.backup_size = otaStatus.total;
+  sha256Final(otaHash, otaRecord.backup_sha256);
+  halLog("OTA: copia de la imagen actual lista (%lu bytes)\n", (unsigned long)otaStatus.total);
+  otaStatus.total = 0;
+  otaStatus.received = 0;
+  otaSendRequest(halMillis());
+}
+
+// Chequeo de salud de la imagen a prueba: llegar al broker MQTT a tiempo
+void checkOtaTrial(unsigned long now) {
+  if (otaRecord.state != OTA_IMAGE_TRIAL || otaStatus.phase != OTA_IDLE) return;
+  // Sin broker configurado no hay contra que verificar: alcanza con llegar a loop()
+  if (halMqttConnected() || config.mqtt_server[0] == '\0') {
+    otaRecord.state = OTA_IMAGE_CONFIRMED;
+    saveOtaRecord();
+    halLog("OTA: imagen nueva confirmada (arranque %u, a los %lu ms)\n", otaRecord.boots, now - otaTrialStart);
+    publishQueuedEvent("ota_confirmed", "\"boots\":%u,\"after_ms\":%lu", otaRecord.boots, now - otaTrialStart);
+    journalAppend(JOURNAL_OTA_CONFIRMED, JOURNAL_NO_TARGET, otaRecord.boots, now - otaTrialStart, nullptr);
+  } else if (now - otaTrialStart >= OTA_HEALTH_DEADLINE_MS) {
+    otaStartRollback("mqtt_deadline");
+  }
+}
+
+void otaLoop() {
+  unsigned long now = halMillis();
+  checkOtaTrial(now);
+  if (otaStatus.phase == OTA_IDLE) return;
+
+  // La flash no se toca durante un pulso: una escritura de sector frena
+  // loop() decenas de ms y el pulso terminaria tarde
+  bool pulsing = isPulseActive(POWER_PIN) || isPulseActive(RESET_PIN);
+
+  switch (otaStatus.phase) {
+    case OTA_RESOLVING: {
+      ProbeResult result = halProbePoll(OTA_PROBE_SLOT);
+      if (result == PROBE_PENDING) return;
+      if (result != PROBE_OK) {
+        otaFail("unreachable");
+        return;
+      }
+      size_t size = halFirmwareSize();
+      if (size == 0 || !halBackupBegin(size)) {
+        otaFail("no_space");
+        return;
+      }
+      sha256Init(otaHash);
+      otaStatus.total = size;
+      otaStatus.received = 0;
+      otaStatus.phase = OTA_BACKUP;
+      halLog("OTA: servidor %s:%u alcanzable, copiando la imagen actual\n", otaStatus.host, otaStatus.port);
+      return;
+    }
+    case OTA_BACKUP:
+      if (!pulsing) otaBackupStep();
+      return;
+    case OTA_REQUEST:
+      otaPollConnect(now);
+      return;
+    case OTA_HEADERS:
+      otaReadHeaders(now);
+      return;
+    case OTA_DOWNLOAD:
+      if (pulsing) {
+        otaStatus.last_data = now;
+        return;
+      }
+      otaReadBody(now);
+      return;
+    case OTA_ROLLBACK:
+      if (!pulsing) otaRollbackStep();
+      return;
+    case OTA_RESTARTING:
+      if (now - otaStatus.last_data >= OTA_RESTART_DELAY_MS) {
+        journalFlush();
+        saveHeartbeatRecord();
+        halRestart();
+      }
+      return;
+    default:
+      return;
+  }
+}
+
+void setupOta() {
+  otaStatus.phase = OTA_IDLE;
+  if (!halOtaRecordLoad(&otaRecord, sizeof(otaRecord)) || otaRecord.magic != OTA_RECORD_MAGIC ||
+      otaRecord.crc != otaRecordCrc(otaRecord)) {
+    memset(&otaRecord, 0, sizeof(otaRecord));
+    return;
+  }
+
+  if (otaRecord.state == OTA_IMAGE_TRIAL) {
+    otaRecord.boots++;
+    saveOtaRecord();
+    if (otaRecord.boots > OTA_MAX_TRIAL_BOOTS) {
+      otaStartRollback("boot_loop");
+      return;
+    }
+    otaTrialStart = halMillis();
+    halLog("OTA: imagen nueva a prueba (arranque %u de %d), tiene %lu s para conectarse a MQTT\n",
+           otaRecord.boots, OTA_MAX_TRIAL_BOOTS, OTA_HEALTH_DEADLINE_MS / 1000);
+  } else if (otaRecord.state == OTA_IMAGE_ROLLED_BACK && !otaRecord.reported) {
+    otaRecord.reported = 1;
+    saveOtaRecord();
+    halLog("OTA: arrancando con la imagen anterior (rollback)\n");
+    publishQueuedEvent("ota_rollback", "\"status\":\"done\",\"size\":%lu", (unsigned long)otaRecord.backup_size);
+  }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+// Actualizacion de firmware OTA. El equipo baja la imagen el mismo (GET
+// HTTP) cuando se lo pide POST /api/ota o el comando MQTT "ota":
+//
+//   {"cmd":"ota","url":"http://10.0.0.5:8000/firmware.bin","sha256":"<hex>","sig":"<hex>"}
+//
+// sig es HMAC-SHA256 en hex, con la clave config.ota_key, de
+// "ota1 <url> <sha256>": sin clave no se aceptan pedidos, y la imagen solo se
+// instala si su SHA-256 coincide con el firmado (el servidor HTTP no
+// necesita ser confiable).
+//
+// Todo avanza de a un bloque por iteracion de loop(), sin guardar la imagen
+// en RAM, asi las sondas y los pulsos siguen corriendo durante la descarga:
+//   1. sonda TCP asincrona al servidor (DNS sin bloquear, slot OTA_PROBE_SLOT)
+//   2. copia de la imagen en ejecucion a LittleFS, para poder volver atras
+//   3. connect asincrono de la descarga (halFetchOpen/halFetchPoll) y GET
+//   4. descarga al area de actualizacion en bloques de OTA_CHUNK_SIZE con el
+//      SHA-256 calculado al vuelo. El ultimo bloque se retiene hasta verificar
+//      el hash: una imagen alterada o incompleta nunca queda confirmada
+//   5. reinicio: el bootloader copia la imagen nueva
+// Mientras hay un pulso en curso no se escribe la flash (lwIP sigue
+// recibiendo y la ventana TCP frena al servidor).
+//
+// La imagen nueva arranca "a prueba": si no se conecta al broker MQTT dentro
+// de OTA_HEALTH_DEADLINE_MS, o se reinicia mas de OTA_MAX_TRIAL_BOOTS veces
+// antes de lograrlo, se reinstala la copia anterior de la misma forma.
+
+#include "hal.h"
+#include "config.h"
+#include "sha256.h"
+
+#define OTA_PROBE_SLOT (HAL_PROBE_SLOTS - 2)
+#define OTA_URL_SIZE 128
+#define OTA_CHUNK_SIZE 1024               // Bloque por iteracion de loop()
+#define OTA_PROBE_TIMEOUT_MS 3000UL
+#define OTA_CONNECT_TIMEOUT_MS 3000UL     // Connect de la descarga (sin bloquear)
+#define OTA_STALL_TIMEOUT_MS 15000UL      // Sin datos del servidor: se aborta
+#define OTA_HEALTH_DEADLINE_MS 300000UL   // Para que la imagen nueva llegue a MQTT
+#define OTA_MAX_TRIAL_BOOTS 3
+#define OTA_PROGRESS_STEP 10              // % entre actualizaciones en vivo
+#define OTA_SIGNATURE_PREFIX "ota1 "
+
+enum OtaPhase {
+  OTA_IDLE = 0,
+  OTA_RESOLVING,   // Sonda TCP al servidor
+  OTA_BACKUP,      // Copiando la imagen actual a LittleFS
+  OTA_REQUEST,     // Conectando y enviando el GET
+  OTA_HEADERS,     // Leyendo status y Content-Length
+  OTA_DOWNLOAD,
+  OTA_ROLLBACK,    // Reinstalando la copia anterior
+  OTA_RESTARTING,
+};
+
+// Estado de la imagen instalada, persistido en flash
+enum OtaImageState {
+  OTA_IMAGE_NONE = 0,        // Sin OTA o imagen instalada por USB
+  OTA_IMAGE_TRIAL,           // Recien instalada, esperando el chequeo de salud
+  OTA_IMAGE_CONFIRMED,
+  OTA_IMAGE_ROLLED_BACK,     // Se volvio a la copia anterior
+  OTA_IMAGE_ROLLBACK_FAILED, // La copia no verifico: se sigue con la imagen nueva
+};
+
+struct OtaRecord {
+  uint32_t magic;
+  uint8_t state;             // OtaImageState
+  uint8_t boots;             // Arranques de la imagen a prueba
+  uint8_t reported;          // Resultado del rollback ya informado
+  uint8_t reserved;
+  uint32_t backup_size;
+  uint8_t backup_sha256[SHA256_DIGEST_SIZE];
+  uint8_t image_sha256[SHA256_DIGEST_SIZE];
+  uint32_t crc;              // CRC32 del registro con crc = 0
+};
+
+// Descarga o rollback en curso
+struct OtaStatus {
+  OtaPhase phase;
+  char host[64];
+  uint16_t port;
+  char path[OTA_URL_SIZE];
+  uint8_t expected[SHA256_DIGEST_SIZE];
+  size_t total;              // Bytes de la imagen (Content-Length o copia)
+  size_t received;
+  size_t fill;               // Bytes en el bloque pendiente de escribir
+  bool updating;             // halUpdateBegin() hecho
+  unsigned long last_data;
+  uint8_t last_progress;
+  char error[24];            // Motivo del ultimo fallo ("" = ninguno)
+};
+
+extern OtaRecord otaRecord;
+extern OtaStatus otaStatus;
+
+// Lee el estado de la imagen al arrancar y arma el chequeo de salud (o
+// empieza el rollback si la imagen a prueba ya se reinicio demasiadas veces)
+void setupOta();
+// Valida y arranca una actualizacion. Si la rechaza devuelve false y deja
+// el motivo en reason.
+bool otaStart(const char* url, const char* sha256_hex, const char* sig_hex, const char*& reason);
+void otaLoop();
+bool otaBusy();
+const char* otaPhaseName(OtaPhase phase);
+const char* otaImageStateName(uint8_t state);
+// "http://host[:puerto]/path". Rechaza https, credenciales y caracteres que
+// no pueden ir tal cual en un request HTTP o en un evento JSON.
+bool parseOtaUrl(const char* url, char* host, size_t host_size, uint16_t& port, char* path, size_t path_size);
+bool verifyOtaSignature(const char* url, const char* sha256_hex, const char* sig_hex, const char* key);
@@ -0,0 +1,88 @@
+#include "powersave.h"
+#include "buttons.h"
+#include "commands.h"
+#include "mqtt_link.h"
+#include "ota.h"
+#include "pulses.h"
+#include "watchdog.h"
+
+const char* const POWER_SAVE_MODE_NAMES[] = { "off", "modem", "light" };
+
+PowerSaveStats powerSaveStats = {};
+
+// Espera en curso (la cuenta se hace al volver a loop())
+bool idleArmed = false;
+unsigned long idleStart = 0;
+unsigned long idleRequested = 0;
+
+const char* powerSaveModeName(uint8_t mode) {
+  return mode <= POWER_SAVE_LIGHT ? POWER_SAVE_MODE_NAMES[mode] : "?";
+}
+
+void limitIdle(unsigned long& budget, unsigned long now, unsigned long due) {
+  long left = (long)(due - now);
+  if (left <= 0) {
+    budget = 0;
+  } else if ((unsigned long)left < budget) {
+    budget = left;
+  }
+}
+
+void setupPowerSave() {
+  halSetLightSleep(config.power_save_mode == POWER_SAVE_LIGHT);
+  powerSaveStats.window_start = halMillis();
+  powerSaveStats.window_idle_ms = 0;
+  powerSaveStats.window_done = false;
+  halLog("Ahorro de energia: modo %s\n", powerSaveModeName(config.power_save_mode));
+}
+
+void powerSaveWake() {
+  unsigned long now = halMillis();
+  if (idleArmed) {
+    idleArmed = false;
+    unsigned long idle = now - idleStart;
+    powerSaveStats.idle_ms += idle;
+    powerSaveStats.window_idle_ms += idle;
+    if (idle < idleRequested) powerSaveStats.wakeups++;
+  }
+
+  unsigned long elapsed = now - powerSaveStats.window_start;
+  if (elapsed >= POWER_SAVE_WINDOW_MS) {
+    powerSaveStats.duty_pct = 100.0f - 100.0f * powerSaveStats.window_idle_ms / elapsed;
+    powerSaveStats.window_done = true;
+    powerSaveStats.window_start = now;
+    powerSaveStats.window_idle_ms = 0;
+  }
+}
+
+float powerSaveDutyPct() {
+  if (powerSaveStats.window_done) return powerSaveStats.duty_pct;
+  unsigned long elapsed = halMillis() - powerSaveStats.window_start;
+  if (elapsed == 0) return 100.0f;
+  return 100.0f - 100.0f * powerSaveStats.window_idle_ms / elapsed;
+}
+
+float powerSaveEstimatedMa() {
+  float idle_ma = config.power_save_mode == POWER_SAVE_LIGHT ? POWER_LIGHT_IDLE_MA : POWER_MODEM_IDLE_MA;
+  float duty = powerSaveDutyPct() / 100.0f;
+  return duty * POWER_ACTIVE_MA + (1.0f - duty) * idle_ma;
+}
+
+void powerSaveIdle() {
+  if (config.power_save_mode == POWER_SAVE_OFF || otaBusy()) return;
+
+  unsigned long now = halMillis();
+  unsigned long budget = POWER_SAVE_MAX_IDLE_MS;
+  pulsesIdleBudget(now, budget);
+  scheduledCommandIdleBudget(now, budget);
+  buttonsIdleBudget(now, budget);
+  watchdogIdleBudget(now, budget);
+  if (!halMqttConnected()) mqttLinkIdleBudget(now, budget);
+  if (budget < POWER_SAVE_MIN_IDLE_MS) return;
+
+  idleArmed = true;
+  idleStart = now;
+  idleRequested = budget;
+  powerSaveStats.idles++;
+  halIdle(budget, config.power_save_mode == POWER_SAVE_LIGHT);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// Ahorro de energia entre sondas (config.power_save_mode). Con
+// POWER_SAVE_OFF loop() gira sin pausa como siempre. En los otros modos, al
+// final de cada iteracion se calcula el proximo vencimiento (pulsos, comando
+// escalonado, debounce de botones, sondas del watchdog, reintento MQTT) y se
+// espera hasta entonces, con tope POWER_SAVE_MAX_IDLE_MS para que la web, el
+// keepalive MQTT y los mensajes entrantes no esperen mas que eso:
+//   - modem: la radio se apaga entre beacons del AP y el CPU espera en vez
+//     de girar
+//   - light: ademas el SDK suspende el CPU durante la espera; los botones
+//     lo despiertan por nivel de GPIO
+// Las interrupciones de los botones cortan la espera: una pulsacion se
+// atiende al instante en cualquier modo. Tambien la corta el fin de una sonda
+// (callback de lwIP), asi los resultados no llegan tarde. Durante una
+// actualizacion OTA no se espera.
+//
+// El ciclo activo (tiempo fuera de la espera) se mide por ventanas de
+// POWER_SAVE_WINDOW_MS y con el se estima la corriente media a partir de
+// consumos nominales: sirve para comparar modos, no reemplaza una medicion.
+
+#include "config.h"
+
+#define POWER_SAVE_MAX_IDLE_MS 250UL      // Tope de cada espera
+#define POWER_SAVE_MIN_IDLE_MS 2UL        // Menos que esto no vale la pena
+#define POWER_SAVE_WINDOW_MS 60000UL
+
+// Consumo nominal del modulo (mA) para la estimacion
+#define POWER_ACTIVE_MA 70.0f             // CPU trabajando, radio despierta
+#define POWER_MODEM_IDLE_MA 18.0f         // CPU esperando, radio entre beacons
+#define POWER_LIGHT_IDLE_MA 2.0f          // CPU suspendido, radio entre beacons
+
+struct PowerSaveStats {
+  uint32_t idles;                // Esperas hechas
+  uint32_t wakeups;              // Esperas cortadas antes de tiempo (boton o sonda)
+  uint64_t idle_ms;              // Total esperando desde el arranque
+  unsigned long window_start;
+  unsigned long window_idle_ms;
+  bool window_done;              // Ya hay una ventana completa
+  float duty_pct;                // Ciclo activo de la ultima ventana completa
+};
+
+extern PowerSaveStats powerSaveStats;
+
+// Aplica config.power_save_mode (tambien en vivo al cambiar la config)
+void setupPowerSave();
+// Al principio de loop(): descuenta la espera anterior
+void powerSaveWake();
+// Al final de loop(): espera hasta el proximo vencimiento si el modo lo permite
+void powerSaveIdle();
+// Acota budget al tiempo que falta hasta due (0 si ya vencio)
+void limitIdle(unsigned long& budget, unsigned long now, unsigned long due);
+// Ciclo activo (%) y corriente media estimada (mA): de la ultima ventana
+// completa, o de la actual mientras no haya ninguna
+float powerSaveDutyPct();
+float powerSaveEstimatedMa();
+const char* powerSaveModeName(uint8_t mode);
@@ -0,0 +1,127 @@
+#include "probes.h"
+
+const char* const PROBE_TYPE_NAMES[] = { "tcp", "banner", "http", "udp_echo", "heartbeat" };
+
+const char* probeTypeName(uint8_t type) {
+  return type <= PROBE_HEARTBEAT ? PROBE_TYPE_NAMES[type] : "tcp";
+}
+
+uint8_t probeTypeFromName(const char* name) {
+  for (uint8_t i = 0; i <= PROBE_HEARTBEAT; i++) {
+    if (strcmp(PROBE_TYPE_NAMES[i], name) == 0) return i;
+  }
+  return PROBE_TCP;
+}
+
+const char* udpEchoPayload(const char* match) {
+  return match[0] != '\0' ? match : UDP_ECHO_DEFAULT_PAYLOAD;
+}
+
+// "HTTP/1.1 200 OK": hace falta la linea de status hasta el codigo
+ProbeResult checkHttpStatus(const ProbeRequest& request, const char* data, size_t len) {
+  if (len < 12) {
+    return memchr(data, '\n', len) != nullptr ? PROBE_MISMATCH : PROBE_PENDING;
+  }
+  if (memcmp(data, "HTTP/", 5) != 0) return PROBE_MISMATCH;
+
+  const char* space = (const char*)memchr(data, ' ', len);
+  if (space == nullptr || space + 4 > data + len) return PROBE_MISMATCH;
+  int status = 0;
+  for (int i = 1; i <= 3; i++) {
+    if (space[i] < '0' || space[i] > '9') return PROBE_MISMATCH;
+    status = status * 10 + (space[i] - '0');
+  }
+
+  if (request.http_status == 0) return status < 400 ? PROBE_OK : PROBE_MISMATCH;
+  return status == request.http_status ? PROBE_OK : PROBE_MISMATCH;
+}
+
+ProbeResult checkProbeResponse(const ProbeRequest& request, const char* data, size_t len) {
+  switch (request.type) {
+    case PROBE_BANNER: {
+      // Banner vacio en la config: alcanza con que el servicio hable primero
+      size_t need = strlen(request.match);
+      if (len == 0) return PROBE_PENDING;
+      if (len >= need) return memcmp(data, request.match, need) == 0 ? PROBE_OK : PROBE_MISMATCH;
+      // Linea completa mas corta que el prefijo esperado
+      return memchr(data, '\n', len) != nullptr ? PROBE_MISMATCH : PROBE_PENDING;
+    }
+    case PROBE_HTTP:
+      return checkHttpStatus(request, data, len);
+    case PROBE_UDP_ECHO: {
+      const char* payload = udpEchoPayload(request.match);
+      return len == strlen(payload) && memcmp(data, payload, len) == 0 ? PROBE_OK : PROBE_MISMATCH;
+    }
+    default:
+      return PROBE_OK;
+  }
+}
+
+void resetRttTracker(RttTracker& r) {
+  memset(&r, 0, sizeof(r));
+}
+
+bool recordRtt(RttTracker& r, unsigned long rtt_ms, uint16_t degraded_pct) {
+  if (rtt_ms > 0xFFFF) rtt_ms = 0xFFFF;
+  r.samples[r.next] = rtt_ms;
+  r.next = (r.next + 1) % RTT_SAMPLES;
+  if (r.count < RTT_SAMPLES) r.count++;
+
+  int32_t sample = (int32_t)rtt_ms << RTT_FIXED_SHIFT;
+  if (r.total++ == 0) {
+    r.ewma = sample;
+    r.baseline = sample;
+    return false;
+  }
+  r.ewma += (sample - (int32_t)r.ewma) >> RTT_EWMA_SHIFT;
+  // La linea de base se congela mientras el objetivo esta degradado, asi
+  // una degradacion sostenida no pasa a ser la nueva normalidad
+  if (!r.degraded) r.baseline += (sample - (int32_t)r.baseline) >> RTT_BASELINE_SHIFT;
+
+  if (degraded_pct == 0) {
+    bool changed = r.degraded;
+    r.degraded = false;
+    return changed;
+  }
+
+  uint32_t threshold = (uint64_t)r.baseline * degraded_pct / 100;
+  uint32_t min_delta = (uint32_t)RTT_DEGRADED_MIN_DELTA_MS << RTT_FIXED_SHIFT;
+  if (!r.degraded) {
+    if (r.total >= RTT_BASELINE_MIN_SAMPLES && r.ewma > threshold && r.ewma > r.baseline + min_delta) {
+      r.degraded = true;
+      return true;
+    }
+  } else if (r.ewma <= (r.baseline + threshold) / 2 || r.ewma <= r.baseline + min_delta / 2) {
+    // Histeresis: se sale a mitad de camino entre la base y el umbral
+    r.degraded = false;
+    return true;
+  }
+  return false;
+}
+
+unsigned long rttEwmaMs(const RttTracker& r) {
+  return (r.ewma + (1 << (RTT_FIXED_SHIFT - 1))) >> RTT_FIXED_SHIFT;
+}
+
+unsigned long rttBaselineMs(const RttTracker& r) {
+  return (r.baseline + (1 << (RTT_FIXED_SHIFT - 1))) >> RTT_FIXED_SHIFT;
+}
+
+// Percentil por rango mas cercano sobre la ventana (ordena una copia de 32)
+unsigned long rttPercentile(const RttTracker& r, int pct) {
+  if (r.count == 0) return 0;
+  uint16_t sorted[RTT_SAMPLES];
+  memcpy(sorted, r.samples, r.count * sizeof(sorted[0]));
+  for (int i = 1; i < r.count; i++) {
+    uint16_t v = sorted[i];
+    int j = i - 1;
+    while (j >= 0 && sorted[j] > v) {
+      sorted[j + 1] = sorted[j];
+      j--;
+    }
+    sorted[j + 1] = v;
+  }
+  int rank = (r.count * pct + 99) / 100;
+  if (rank < 1) rank = 1;
+  return sorted[rank - 1];
+}
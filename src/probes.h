@@ -0,0 +1,42 @@
+#pragma once
+
+// Validacion de respuestas de las sondas de aplicacion (comun a las dos HAL)
+// y seguimiento de latencia por objetivo: EWMA corta contra una linea de base
+// lenta para marcar un objetivo "degradado" antes de que deje de responder.
+
+#include "hal.h"
+
+#define PROBE_RESPONSE_SIZE 64         // Bytes de respuesta que se inspeccionan
+#define UDP_ECHO_DEFAULT_PAYLOAD "atx-watchdog"
+
+#define RTT_SAMPLES 32                 // Ventana para percentiles
+#define RTT_EWMA_SHIFT 2               // EWMA corta: alfa = 1/4
+#define RTT_BASELINE_SHIFT 5           // Linea de base: alfa = 1/32
+#define RTT_BASELINE_MIN_SAMPLES 8     // Muestras antes de poder marcar degradado
+#define RTT_DEGRADED_MIN_DELTA_MS 20   // En LAN 1 -> 3 ms no es degradacion
+#define RTT_FIXED_SHIFT 4              // EWMA en ms * 16
+
+// Evalua lo recibido hasta ahora. Devuelve PROBE_PENDING si hacen falta mas
+// datos, PROBE_OK o PROBE_MISMATCH.
+ProbeResult checkProbeResponse(const ProbeRequest& request, const char* data, size_t len);
+const char* probeTypeName(uint8_t type);
+uint8_t probeTypeFromName(const char* name);  // PROBE_TCP si no se reconoce
+// Payload del eco UDP (match o el default)
+const char* udpEchoPayload(const char* match);
+
+struct RttTracker {
+  uint16_t samples[RTT_SAMPLES];  // Ultimos RTT de respuesta (ms), circular
+  uint8_t count;
+  uint8_t next;
+  uint32_t ewma;                  // Punto fijo, ms << RTT_FIXED_SHIFT
+  uint32_t baseline;
+  uint32_t total;                 // Muestras desde el ultimo reset
+  bool degraded;
+};
+
+void resetRttTracker(RttTracker& r);
+// Agrega una muestra. Devuelve true si cambio el estado degradado.
+bool recordRtt(RttTracker& r, unsigned long rtt_ms, uint16_t degraded_pct);
+unsigned long rttEwmaMs(const RttTracker& r);
+unsigned long rttBaselineMs(const RttTracker& r);
+unsigned long rttPercentile(const RttTracker& r, int pct);
@@ -0,0 +1,120 @@
+#include "pulses.h"
+#include "metrics.h"
+#include "journal.h"
+#include "powersave.h"
+
+PulseChannel pulseChannels[] = {
+  { POWER_PIN, false, 0, 0, {}, 0 },
+  { RESET_PIN, false, 0, 0, {}, 0 },
+};
+const int PULSE_CHANNEL_COUNT = sizeof(pulseChannels) / sizeof(pulseChannels[0]);
+
+bool clickButton(int pin, int duration_ms) {
+  if (duration_ms <= 0) {
+    halLog("Click rechazado en pin %d: duracion invalida (%d ms)\n", pin, duration_ms);
+    return false;
+  }
+  halLog("Ejecutando click en pin %d por %d ms\n", pin, duration_ms);
+  if (!schedulePulse(pin, duration_ms, 0)) return false;
+
+  if (pin == POWER_PIN) actionCounters.power_clicks++;
+  else if (pin == RESET_PIN) actionCounters.reset_clicks++;
+  journalAppend(JOURNAL_CLICK, JOURNAL_NO_TARGET, pin, duration_ms, pin == POWER_PIN ? "power" : "reset");
+  return true;
+}
+
+PulseChannel* findPulseChannel(int pin) {
+  for (int i = 0; i < PULSE_CHANNEL_COUNT; i++) {
+    if (pulseChannels[i].pin == pin) return &pulseChannels[i];
+  }
+  return nullptr;
+}
+
+// true si las ventanas [a, a+da) y [b, b+db) se solapan (incluyendo la
+// separacion minima). Usa diferencias con signo para tolerar el desborde
+// de halMillis().
+bool pulseWindowsOverlap(unsigned long a, unsigned long da, unsigned long b, unsigned long db) {
+  long rel = (long)(b - a);
+  return rel < (long)(da + PULSE_MIN_GAP_MS) && -rel < (long)(db + PULSE_MIN_GAP_MS);
+}
+
+bool schedulePulse(int pin, unsigned long duration_ms, unsigned long delay_ms) {
+  PulseChannel* ch = findPulseChannel(pin);
+  if (ch == nullptr) return false;
+
+  if (duration_ms == 0 || duration_ms > PULSE_MAX_MS) {
+    halLog("Pulso rechazado en pin %d: duracion %lu ms fuera de rango (max %d)\n",
+           pin, duration_ms, PULSE_MAX_MS);
+    return false;
+  }
+
+  if (ch->count >= PULSE_QUEUE_SIZE) {
+    halLog("Pulso rechazado en pin %d: cola llena\n", pin);
+    return false;
+  }
+
+  unsigned long now = halMillis();
+  unsigned long start = now + delay_ms;
+
+  // No permitir pulsos solapados en el mismo pin
+  if (ch->active && pulseWindowsOverlap(start, duration_ms, ch->active_start, ch->active_duration)) {
+    halLog("Pulso rechazado en pin %d: pulso en curso\n", pin);
+    return false;
+  }
+  for (int i = 0; i < ch->count; i++) {
+    if (pulseWindowsOverlap(start, duration_ms, ch->queue[i].start_ms, ch->queue[i].duration_ms)) {
+      halLog("Pulso rechazado en pin %d: solapa con pulso pendiente\n", pin);
+      return false;
+    }
+  }
+
+  // Insertar ordenado por tiempo de inicio
+  int pos = ch->count;
+  while (pos > 0 && (long)(ch->queue[pos - 1].start_ms - now) > (long)delay_ms) {
+    ch->queue[pos] = ch->queue[pos - 1];
+    pos--;
+  }
+  ch->queue[pos].start_ms = start;
+  ch->queue[pos].duration_ms = duration_ms;
+  ch->count++;
+
+  // Arrancar de inmediato si corresponde
+  processPulses();
+  return true;
+}
+
+bool isPulseActive(int pin) {
+  PulseChannel* ch = findPulseChannel(pin);
+  return ch != nullptr && (ch->active || ch->count > 0);
+}
+
+void processPulses() {
+  unsigned long now = halMillis();
+
+  for (int i = 0; i < PULSE_CHANNEL_COUNT; i++) {
+    PulseChannel& ch = pulseChannels[i];
+
+    if (ch.active && now - ch.active_start >= ch.active_duration) {
+      halDigitalWrite(ch.pin, true);
+      ch.active = false;
+      halLog("Pulso en pin %d finalizado (%lu ms)\n", ch.pin, now - ch.active_start);
+    }
+
+    if (!ch.active && ch.count > 0 && (long)(now - ch.queue[0].start_ms) >= 0) {
+      ch.active = true;
+      ch.active_start = now;
+      ch.active_duration = ch.queue[0].duration_ms;
+      for (int j = 1; j < ch.count; j++) ch.queue[j - 1] = ch.queue[j];
+      ch.count--;
+      halDigitalWrite(ch.pin, false);
+    }
+  }
+}
+
+void pulsesIdleBudget(unsigned long now, unsigned long& budget) {
+  for (int i = 0; i < PULSE_CHANNEL_COUNT; i++) {
+    const PulseChannel& ch = pulseChannels[i];
+    if (ch.active) limitIdle(budget, now, ch.active_start + ch.active_duration);
+    else if (ch.count > 0) limitIdle(budget, now, ch.queue[0].start_ms);
+  }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Planificador de pulsos sobre los pines POWER/RESET de la motherboard. Los
+// pulsos se completan desde loop() comparando halMillis(), nunca con delay().
+
+#include "hal.h"
+
+// Pines GPIO - Salidas (conectar a motherboard)
+#define POWER_PIN D1  // GPIO5 - Output para boton POWER
+#define RESET_PIN D2  // GPIO4 - Output para boton RESET
+
+// Planificador de pulsos (no bloqueante)
+#define PULSE_QUEUE_SIZE 4      // Pulsos pendientes por pin de salida
+#define PULSE_MAX_MS 10000      // Duracion maxima aceptada para un pulso
+#define PULSE_MIN_GAP_MS 50     // Separacion minima entre pulsos del mismo pin
+#define FORCE_OFF_MS 5000       // Pulsacion larga para apagado forzado
+
+struct PulseJob {
+  unsigned long start_ms;
+  unsigned long duration_ms;
+};
+
+struct PulseChannel {
+  uint8_t pin;
+  bool active;                 // Pin actualmente en LOW
+  unsigned long active_start;
+  unsigned long active_duration;
+  PulseJob queue[PULSE_QUEUE_SIZE]; // Ordenada por inicio
+  uint8_t count;
+};
+
+bool clickButton(int pin, int duration_ms);
+bool schedulePulse(int pin, unsigned long duration_ms, unsigned long delay_ms);
+bool isPulseActive(int pin);
+void processPulses();
+// Acota la espera de powersave.h al proximo inicio o fin de pulso
+void pulsesIdleBudget(unsigned long now, unsigned long& budget);
@@ -0,0 +1,429 @@
+#include "render.h"
+#include "metrics.h"
+#include "pulses.h"
+#include "watchdog.h"
+#include "probes.h"
+#include "events.h"
+#include "mqtt_link.h"
+#include "journal.h"
+#include "ota.h"
+#include "powersave.h"
+
+uint32_t lastWebHeapUse = 0;
+uint32_t maxWebHeapUse = 0;
+
+void printJsonString(Print& out, const char* str) {
+  out.write('"');
+  for (const char* c = str; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      out.write('\\');
+      out.write(*c);
+    } else if ((uint8_t)*c < 0x20) {
+      out.printf("\\u%04x", *c);
+    } else {
+      out.write(*c);
+    }
+  }
+  out.write('"');
+}
+
+void printJsonKey(Print& out, const char* key, bool first) {
+  if (!first) out.write(',');
+  printJsonString(out, key);
+  out.write(':');
+}
+
+void renderStatusJson(Print& out) {
+  unsigned long now = halMillis();
+
+  out.write('{');
+  printJsonKey(out, "ip", true);
+  uint32_t ip = halLocalIp();
+  out.printf("\"%u.%u.%u.%u\"", (unsigned)(ip & 0xff), (unsigned)((ip >> 8) & 0xff),
+             (unsigned)((ip >> 16) & 0xff), (unsigned)(ip >> 24));
+  printJsonKey(out, "hostname");
+  printJsonString(out, config.hostname);
+  printJsonKey(out, "client_id");
+  printJsonString(out, config.client_id);
+  printJsonKey(out, "mqtt_groups");
+  printJsonString(out, config.mqtt_groups);
+  printJsonKey(out, "mqtt");
+  out.print(halMqttConnected() ? "true" : "false");
+  printJsonKey(out, "mqtt_failures");
+  out.print(mqttLink.failures);
+  printJsonKey(out, "event_queue");
+  out.print(eventQueueLength());
+  printJsonKey(out, "journal_seq");
+  out.print(journalLastSeq());
+  printJsonKey(out, "ota");
+  out.write('{');
+  printJsonKey(out, "phase", true);
+  printJsonString(out, otaPhaseName(otaStatus.phase));
+  printJsonKey(out, "image");
+  printJsonString(out, otaImageStateName(otaRecord.state));
+  printJsonKey(out, "received");
+  out.print((unsigned long)otaStatus.received);
+  printJsonKey(out, "size");
+  out.print((unsigned long)otaStatus.total);
+  printJsonKey(out, "error");
+  printJsonString(out, otaStatus.error);
+  out.write('}');
+  printJsonKey(out, "live_port");
+  out.print(LIVE_PORT);
+  printJsonKey(out, "live_clients");
+  out.print(halSseClientCount());
+  printJsonKey(out, "power_save");
+  out.write('{');
+  printJsonKey(out, "mode", true);
+  printJsonString(out, powerSaveModeName(config.power_save_mode));
+  printJsonKey(out, "duty_pct");
+  out.print(powerSaveDutyPct(), 1);
+  printJsonKey(out, "est_ma");
+  out.print(powerSaveEstimatedMa(), 1);
+  printJsonKey(out, "idles");
+  out.print(powerSaveStats.idles);
+  printJsonKey(out, "wakeups");
+  out.print(powerSaveStats.wakeups);
+  out.write('}');
+  printJsonKey(out, "uptime");
+  out.print(now / 1000);
+  printJsonKey(out, "heap_free");
+  out.print(halFreeHeap());
+  printJsonKey(out, "web_heap_last");
+  out.print(lastWebHeapUse);
+  printJsonKey(out, "web_heap_max");
+  out.print(maxWebHeapUse);
+  printJsonKey(out, "watchdog_enabled");
+  out.print(config.watchdog_enabled ? "true" : "false");
+  printJsonKey(out, "power");
+  int power = readPowerState();
+  if (power < 0) {
+    out.print("null");
+  } else {
+    printJsonString(out, power ? "on" : "off");
+  }
+
+  printJsonKey(out, "boot");
+  out.write('{');
+  printJsonKey(out, "path", true);
+  printJsonString(out, bootTimeline.fast_path ? "fast" : "wifimanager");
+  printJsonKey(out, "wifi_associated_ms");
+  out.print(bootTimeline.wifi_associated);
+  printJsonKey(out, "wifi_ip_ms");
+  out.print(bootTimeline.wifi_ip);
+  printJsonKey(out, "mqtt_connected_ms");
+  out.print(bootTimeline.mqtt_connected);
+  printJsonKey(out, "first_probe_ms");
+  out.print(bootTimeline.first_probe);
+  out.write('}');
+
+  printJsonKey(out, "targets");
+  out.write('[');
+  bool first = true;
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    const WatchdogTarget& t = config.targets[i];
+    const TargetState& st = targetStates[i];
+    if (t.host[0] == '\0') continue;
+
+    if (!first) out.write(',');
+    first = false;
+    out.write('{');
+    printJsonKey(out, "index", true);
+    out.print(i);
+    printJsonKey(out, "host");
+    printJsonString(out, t.host);
+    printJsonKey(out, "port");
+    out.print(t.port);
+    printJsonKey(out, "last_check_s");
+    out.print((now - st.last_check) / 1000);
+    printJsonKey(out, "last_ok_s");
+    out.print((now - st.last_success) / 1000);
+    printJsonKey(out, "interval_ms");
+    out.print(st.interval_ms);
+    printJsonKey(out, "rtt_ms");
+    out.print(halProbeRtt(i));
+    printJsonKey(out, "probe");
+    printJsonString(out, probeTypeName(config.probes[i].type));
+    printJsonKey(out, "response_ms");
+    out.print(halProbeResponseRtt(i));
+    printJsonKey(out, "response_avg_ms");
+    out.print(rttEwmaMs(st.rtt));
+    printJsonKey(out, "response_baseline_ms");
+    out.print(rttBaselineMs(st.rtt));
+    printJsonKey(out, "response_p50_ms");
+    out.print(rttPercentile(st.rtt, 50));
+    printJsonKey(out, "response_p95_ms");
+    out.print(rttPercentile(st.rtt, 95));
+    printJsonKey(out, "degraded");
+    out.print(st.rtt.degraded ? "true" : "false");
+    if (config.probes[i].type == PROBE_HEARTBEAT) {
+      printJsonKey(out, "heartbeat_seq");
+      out.print((unsigned long long)st.heartbeat_seq);
+      printJsonKey(out, "heartbeat_ts");
+      out.print(st.heartbeat_ts);
+    }
+    printJsonKey(out, "failures");
+    out.print(st.consecutive_failures);
+    printJsonKey(out, "action");
+    printJsonString(out, watchdogActionName(t.action));
+    if (t.action == ACTION_ESCALATE) {
+      printJsonKey(out, "recovery");
+      printJsonString(out, recoveryStateName(i));
+      printJsonKey(out, "recovery_step");
+      out.print(st.recovery_step);
+      printJsonKey(out, "recovery_attempts");
+      out.print(st.recovery_attempts);
+    }
+    out.write('}');
+  }
+  out.write(']');
+  out.write('}');
+}
+
+// "recovery":{"steps":[{"action":"reset","after_ms":120000},...],...}
+void printRecoveryJson(Print& out, const RecoveryPolicy& p) {
+  printJsonKey(out, "recovery");
+  out.write('{');
+  printJsonKey(out, "steps", true);
+  out.write('[');
+  for (int s = 0; s < RECOVERY_MAX_STEPS && p.steps[s].action != STEP_NONE; s++) {
+    if (s > 0) out.write(',');
+    out.write('{');
+    printJsonKey(out, "action", true);
+    printJsonString(out, recoveryStepName(p.steps[s].action));
+    printJsonKey(out, "after_ms");
+    out.print(p.steps[s].after_ms);
+    out.write('}');
+  }
+  out.write(']');
+  printJsonKey(out, "cooldown_ms");
+  out.print(p.cooldown_ms);
+  printJsonKey(out, "max_attempts");
+  out.print(p.max_attempts);
+  out.write('}');
+}
+
+void renderConfigJson(Print& out) {
+
+  out.write('{');
+  printJsonKey(out, "hostname", true);
+  printJsonString(out, config.hostname);
+  printJsonKey(out, "client_id");
+  printJsonString(out, config.client_id);
+  printJsonKey(out, "mqtt_groups");
+  printJsonString(out, config.mqtt_groups);
+  printJsonKey(out, "mqtt_server");
+  printJsonString(out, config.mqtt_server);
+  printJsonKey(out, "mqtt_port");
+  out.print(config.mqtt_port);
+  printJsonKey(out, "mqtt_user");
+  printJsonString(out, config.mqtt_user);
+  printJsonKey(out, "mqtt_pass");
+  printJsonString(out, config.mqtt_pass);
+  printJsonKey(out, "power_click_ms");
+  out.print(config.power_click_ms);
+  printJsonKey(out, "reset_click_ms");
+  out.print(config.reset_click_ms);
+  printJsonKey(out, "watchdog_enabled");
+  out.print(config.watchdog_enabled ? "true" : "false");
+  printJsonKey(out, "static_ip");
+  printJsonString(out, config.static_ip);
+  printJsonKey(out, "static_gateway");
+  printJsonString(out, config.static_gateway);
+  printJsonKey(out, "static_mask");
+  printJsonString(out, config.static_mask);
+  printJsonKey(out, "static_dns");
+  printJsonString(out, config.static_dns);
+  printJsonKey(out, "power_led_mode");
+  out.print(config.power_led_mode);
+  printJsonKey(out, "heartbeat_port");
+  out.print(config.heartbeat_port);
+  printJsonKey(out, "heartbeat_key_set");
+  out.print(config.heartbeat_key[0] != '\0' ? "true" : "false");
+  printJsonKey(out, "ota_key_set");
+  out.print(config.ota_key[0] != '\0' ? "true" : "false");
+  printJsonKey(out, "power_save_mode");
+  out.print(config.power_save_mode);
+
+  printJsonKey(out, "targets");
+  out.write('[');
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    const WatchdogTarget& t = config.targets[i];
+    if (i > 0) out.write(',');
+    out.write('{');
+    printJsonKey(out, "host", true);
+    printJsonString(out, t.host);
+    printJsonKey(out, "port");
+    out.print(t.port);
+    printJsonKey(out, "interval_ms");
+    out.print(t.check_interval_ms);
+    printJsonKey(out, "min_interval_ms");
+    out.print(config.schedules[i].min_interval_ms);
+    printJsonKey(out, "max_interval_ms");
+    out.print(config.schedules[i].max_interval_ms);
+    printJsonKey(out, "timeout_ms");
+    out.print(t.timeout_ms);
+    printJsonKey(out, "action");
+    out.print(t.action);
+    printRecoveryJson(out, config.recovery[i]);
+    const ProbeSettings& ps = config.probes[i];
+    printJsonKey(out, "probe");
+    out.write('{');
+    printJsonKey(out, "type", true);
+    printJsonString(out, probeTypeName(ps.type));
+    printJsonKey(out, "match");
+    printJsonString(out, ps.match);
+    printJsonKey(out, "http_status");
+    out.print(ps.http_status);
+    printJsonKey(out, "degraded_pct");
+    out.print(ps.degraded_pct);
+    out.write('}');
+    out.write('}');
+  }
+  out.write(']');
+  out.write('}');
+}
+
+void printMetricHeader(Print& out, const char* name, const char* type, const char* help) {
+  out.print("# HELP ");
+  out.print(name);
+  out.write(' ');
+  out.print(help);
+  out.print("\n# TYPE ");
+  out.print(name);
+  out.write(' ');
+  out.print(type);
+  out.write('\n');
+}
+
+// Una linea name{target="host",port="22"} value (objetivos activos)
+void printTargetMetric(Print& out, const char* name, int index, unsigned long value) {
+  const WatchdogTarget& t = config.targets[index];
+  if (t.host[0] == '\0') return;
+  out.print(name);
+  out.print("{target=");
+  printJsonString(out, t.host);
+  out.print(",port=\"");
+  out.print(t.port);
+  out.print("\"} ");
+  out.print(value);
+  out.write('\n');
+}
+
+void printMetric(Print& out, const char* name, const char* type, const char* help, long long value) {
+  printMetricHeader(out, name, type, help);
+  out.print(name);
+  out.write(' ');
+  out.print(value);
+  out.write('\n');
+}
+
+void printMetricFloat(Print& out, const char* name, const char* type, const char* help, float value) {
+  printMetricHeader(out, name, type, help);
+  out.print(name);
+  out.write(' ');
+  out.print(value, 2);
+  out.write('\n');
+}
+
+void renderMetrics(Print& out) {
+
+  printMetricHeader(out, "atx_loop_section_duration_us", "histogram", "Duracion de cada seccion de loop() en microsegundos");
+  for (int s = 0; s < SEC_COUNT; s++) {
+    const LatencyStats& st = loopStats[s];
+    uint32_t cumulative = 0;
+    for (int b = 0; b < LATENCY_BUCKET_COUNT; b++) {
+      cumulative += st.buckets[b];
+      out.print("atx_loop_section_duration_us_bucket{section=\"");
+      out.print(SECTION_NAMES[s]);
+      out.print("\",le=\"");
+      if (b < LATENCY_BUCKET_COUNT - 1) out.print(LATENCY_BUCKETS_US[b]);
+      else out.print("+Inf");
+      out.print("\"} ");
+      out.print(cumulative);
+      out.write('\n');
+    }
+    out.print("atx_loop_section_duration_us_sum{section=\"");
+    out.print(SECTION_NAMES[s]);
+    out.print("\"} ");
+    out.print((unsigned long long)st.sum_us);
+    out.print("\natx_loop_section_duration_us_count{section=\"");
+    out.print(SECTION_NAMES[s]);
+    out.print("\"} ");
+    out.print(st.count);
+    out.write('\n');
+  }
+
+  printMetricHeader(out, "atx_loop_section_max_us", "gauge", "Duracion maxima observada por seccion");
+  for (int s = 0; s < SEC_COUNT; s++) {
+    out.print("atx_loop_section_max_us{section=\"");
+    out.print(SECTION_NAMES[s]);
+    out.print("\"} ");
+    out.print(loopStats[s].max_us);
+    out.write('\n');
+  }
+
+  printMetricHeader(out, "atx_loop_section_stalls_total", "counter", "Ejecuciones de la seccion que superaron el umbral de stall");
+  for (int s = 0; s < SEC_COUNT; s++) {
+    out.print("atx_loop_section_stalls_total{section=\"");
+    out.print(SECTION_NAMES[s]);
+    out.print("\"} ");
+    out.print(loopStats[s].stalls);
+    out.write('\n');
+  }
+
+  printMetric(out, "atx_heap_free_bytes", "gauge", "Heap libre", halFreeHeap());
+  printMetric(out, "atx_heap_max_block_bytes", "gauge", "Mayor bloque libre del heap", halMaxFreeBlock());
+  printMetric(out, "atx_heap_fragmentation_percent", "gauge", "Fragmentacion del heap", halHeapFragmentation());
+  printMetric(out, "atx_uptime_seconds", "counter", "Segundos desde el arranque", halMillis() / 1000);
+  printMetric(out, "atx_mqtt_connected", "gauge", "1 si hay sesion MQTT", halMqttConnected() ? 1 : 0);
+  printMetric(out, "atx_wifi_rssi_dbm", "gauge", "RSSI del WiFi", halWifiRssi());
+  printMetric(out, "atx_power_clicks_total", "counter", "Pulsos ejecutados en POWER", actionCounters.power_clicks);
+  printMetric(out, "atx_reset_clicks_total", "counter", "Pulsos ejecutados en RESET", actionCounters.reset_clicks);
+  printMetric(out, "atx_watchdog_timeouts_total", "counter", "Timeouts del watchdog", actionCounters.watchdog_timeouts);
+  printMetric(out, "atx_probes_ok_total", "counter", "Sondas exitosas", actionCounters.probes_ok);
+  printMetric(out, "atx_probes_failed_total", "counter", "Sondas fallidas", actionCounters.probes_failed);
+  printMetric(out, "atx_mqtt_connects_total", "counter", "Conexiones MQTT establecidas", actionCounters.mqtt_connects);
+  printMetric(out, "atx_mqtt_connect_failures_total", "counter", "Intentos de conexion MQTT fallidos", actionCounters.mqtt_connect_failures);
+  printMetric(out, "atx_mqtt_backoff_ms", "gauge", "Espera actual entre reintentos MQTT", mqttLink.backoff_ms);
+  printMetric(out, "atx_event_queue_length", "gauge", "Eventos esperando sesion MQTT", eventQueueLength());
+  printMetric(out, "atx_events_dropped_total", "counter", "Eventos descartados con la cola offline llena", actionCounters.events_dropped);
+  printMetric(out, "atx_live_clients", "gauge", "Navegadores conectados al stream SSE", halSseClientCount());
+  printMetric(out, "atx_power_save_mode", "gauge", "Modo de ahorro de energia (0 off, 1 modem, 2 light)", config.power_save_mode);
+  printMetricFloat(out, "atx_duty_cycle_percent", "gauge", "Ciclo activo del CPU en la ultima ventana", powerSaveDutyPct());
+  printMetricFloat(out, "atx_estimated_current_ma", "gauge", "Corriente media estimada por el ciclo activo", powerSaveEstimatedMa());
+  printMetric(out, "atx_idle_ms_total", "counter", "Tiempo en espera de ahorro de energia", powerSaveStats.idle_ms);
+  printMetric(out, "atx_idle_wakeups_total", "counter", "Esperas cortadas por un boton o una sonda", powerSaveStats.wakeups);
+  printMetric(out, "atx_heartbeats_total", "counter", "Latidos UDP aceptados", actionCounters.heartbeats_ok);
+  printMetric(out, "atx_heartbeats_rejected_total", "counter", "Latidos UDP rechazados", actionCounters.heartbeats_rejected);
+
+  printMetricHeader(out, "atx_probe_rtt_ms", "gauge", "RTT del ultimo connect exitoso por objetivo");
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    printTargetMetric(out, "atx_probe_rtt_ms", i, halProbeRtt(i));
+  }
+
+  printMetricHeader(out, "atx_probe_response_ms", "gauge", "RTT hasta la respuesta de aplicacion por objetivo");
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    printTargetMetric(out, "atx_probe_response_ms", i, halProbeResponseRtt(i));
+  }
+
+  printMetricHeader(out, "atx_probe_response_avg_ms", "gauge", "Promedio movil (EWMA) del RTT de respuesta");
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    printTargetMetric(out, "atx_probe_response_avg_ms", i, rttEwmaMs(targetStates[i].rtt));
+  }
+
+  printMetricHeader(out, "atx_probe_response_p95_ms", "gauge", "Percentil 95 del RTT de respuesta (ultimas 32 sondas)");
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    printTargetMetric(out, "atx_probe_response_p95_ms", i, rttPercentile(targetStates[i].rtt, 95));
+  }
+
+  printMetricHeader(out, "atx_probe_degraded", "gauge", "1 si la latencia del objetivo supera su linea de base");
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    printTargetMetric(out, "atx_probe_degraded", i, targetStates[i].rtt.degraded ? 1 : 0);
+  }
+
+  printMetricHeader(out, "atx_probe_consecutive_failures", "gauge", "Fallos consecutivos por objetivo");
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    printTargetMetric(out, "atx_probe_consecutive_failures", i, targetStates[i].consecutive_failures);
+  }
+}
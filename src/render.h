@@ -0,0 +1,25 @@
+#pragma once
+
+// Respuestas de la API web (/api/status, /api/config y /metrics). Se
+// escriben directo sobre un Print (la respuesta chunked en el ESP8266), sin
+// armar el documento en RAM, y no dependen del servidor web: el simulador
+// nativo las usa para medir cuanto cuesta renderizarlas.
+
+#include "hal.h"
+#include "config.h"
+
+// Panel en vivo: stream SSE (GET /events) en un puerto aparte del servidor web
+#define LIVE_PORT 81
+
+// Uso de heap medido durante las respuestas de la API
+extern uint32_t lastWebHeapUse;
+extern uint32_t maxWebHeapUse;
+
+// Escribe un string JSON escapado (sin copias intermedias)
+void printJsonString(Print& out, const char* str);
+void printJsonKey(Print& out, const char* key, bool first = false);
+
+void renderStatusJson(Print& out);
+void renderConfigJson(Print& out);
+// Metricas en formato de texto de Prometheus
+void renderMetrics(Print& out);
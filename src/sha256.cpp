@@ -0,0 +1,128 @@
+#include "sha256.h"
+
+const uint32_t SHA256_K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline uint32_t rotr(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+void sha256Block(Sha256& ctx, const uint8_t* p) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++) {
+    w[i] = (uint32_t)p[i * 4] << 24 | (uint32_t)p[i * 4 + 1] << 16 | (uint32_t)p[i * 4 + 2] << 8 | p[i * 4 + 3];
+  }
+  for (int i = 16; i < 64; i++) {
+    uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = ctx.state[0], b = ctx.state[1], c = ctx.state[2], d = ctx.state[3];
+  uint32_t e = ctx.state[4], f = ctx.state[5], g = ctx.state[6], h = ctx.state[7];
+  for (int i = 0; i < 64; i++) {
+    uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+    uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  ctx.state[0] += a; ctx.state[1] += b; ctx.state[2] += c; ctx.state[3] += d;
+  ctx.state[4] += e; ctx.state[5] += f; ctx.state[6] += g; ctx.state[7] += h;
+}
+
+void sha256Init(Sha256& ctx) {
+  static const uint32_t INIT[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+  };
+  memcpy(ctx.state, INIT, sizeof(INIT));
+  ctx.length = 0;
+  ctx.block_len = 0;
+}
+
+void sha256Update(Sha256& ctx, const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  ctx.length += len;
+  while (len > 0) {
+    size_t n = SHA256_BLOCK_SIZE - ctx.block_len;
+    if (n > len) n = len;
+    memcpy(ctx.block + ctx.block_len, p, n);
+    ctx.block_len += n;
+    p += n;
+    len -= n;
+    if (ctx.block_len == SHA256_BLOCK_SIZE) {
+      sha256Block(ctx, ctx.block);
+      ctx.block_len = 0;
+    }
+  }
+}
+
+void sha256Final(Sha256& ctx, uint8_t digest[SHA256_DIGEST_SIZE]) {
+  uint64_t bits = ctx.length * 8;
+  uint8_t pad = 0x80;
+  sha256Update(ctx, &pad, 1);
+  pad = 0;
+  while (ctx.block_len != SHA256_BLOCK_SIZE - 8) sha256Update(ctx, &pad, 1);
+
+  uint8_t len_be[8];
+  for (int i = 0; i < 8; i++) len_be[i] = bits >> (56 - i * 8);
+  sha256Update(ctx, len_be, sizeof(len_be));
+
+  for (int i = 0; i < 8; i++) {
+    digest[i * 4] = ctx.state[i] >> 24;
+    digest[i * 4 + 1] = ctx.state[i] >> 16;
+    digest[i * 4 + 2] = ctx.state[i] >> 8;
+    digest[i * 4 + 3] = ctx.state[i];
+  }
+}
+
+void hmacSha256(const uint8_t* key, size_t key_len, const void* data, size_t len,
+                uint8_t mac[SHA256_DIGEST_SIZE]) {
+  uint8_t k[SHA256_BLOCK_SIZE] = {};
+  Sha256 ctx;
+  if (key_len > SHA256_BLOCK_SIZE) {
+    sha256Init(ctx);
+    sha256Update(ctx, key, key_len);
+    sha256Final(ctx, k);
+  } else {
+    memcpy(k, key, key_len);
+  }
+
+  uint8_t pad[SHA256_BLOCK_SIZE];
+  for (int i = 0; i < SHA256_BLOCK_SIZE; i++) pad[i] = k[i] ^ 0x36;
+  sha256Init(ctx);
+  sha256Update(ctx, pad, sizeof(pad));
+  sha256Update(ctx, data, len);
+  uint8_t inner[SHA256_DIGEST_SIZE];
+  sha256Final(ctx, inner);
+
+  for (int i = 0; i < SHA256_BLOCK_SIZE; i++) pad[i] = k[i] ^ 0x5c;
+  sha256Init(ctx);
+  sha256Update(ctx, pad, sizeof(pad));
+  sha256Update(ctx, inner, sizeof(inner));
+  sha256Final(ctx, mac);
+}
+
+void toHex(const uint8_t* data, size_t len, char* out) {
+  static const char DIGITS[] = "0123456789abcdef";
+  for (size_t i = 0; i < len; i++) {
+    out[i * 2] = DIGITS[data[i] >> 4];
+    out[i * 2 + 1] = DIGITS[data[i] & 0x0f];
+  }
+  out[len * 2] = '\0';
+}
+
+bool constantTimeEquals(const void* a, const void* b, size_t len) {
+  const uint8_t* x = (const uint8_t*)a;
+  const uint8_t* y = (const uint8_t*)b;
+  uint8_t diff = 0;
+  for (size_t i = 0; i < len; i++) diff |= x[i] ^ y[i];
+  return diff == 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// SHA-256 y HMAC-SHA256 portables (sin heap), usados para autenticar los
+// latidos UDP. Compilan igual en el ESP8266 y en el build nativo.
+
+#include "hal.h"
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_BLOCK_SIZE 64
+
+struct Sha256 {
+  uint32_t state[8];
+  uint64_t length;               // Bytes procesados
+  uint8_t block[SHA256_BLOCK_SIZE];
+  size_t block_len;
+};
+
+void sha256Init(Sha256& ctx);
+void sha256Update(Sha256& ctx, const void* data, size_t len);
+void sha256Final(Sha256& ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+void hmacSha256(const uint8_t* key, size_t key_len, const void* data, size_t len,
+                uint8_t mac[SHA256_DIGEST_SIZE]);
+
+// Escribe 2 * len digitos hex en minuscula mas el '\0'
+void toHex(const uint8_t* data, size_t len, char* out);
+// Comparacion en tiempo constante (para MACs)
+bool constantTimeEquals(const void* a, const void* b, size_t len);
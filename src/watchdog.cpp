@@ -0,0 +1,411 @@
+#include "watchdog.h"
+#include "events.h"
+#include "metrics.h"
+#include "pulses.h"
+#include "buttons.h"
+#include "journal.h"
+#include "powersave.h"
+
+static_assert(HAL_PROBE_SLOTS >= MAX_WATCHDOG_TARGETS, "un slot de sonda por objetivo");
+
+TargetState targetStates[MAX_WATCHDOG_TARGETS] = {};
+
+// Desfase aleatorio para que las sondas no se alineen en el mismo tick
+long watchdogJitter(int interval_ms) {
+  long span = (long)interval_ms * WATCHDOG_JITTER_PCT / 100;
+  if (span <= 0) return 0;
+  return halRandom(span + 1) - span / 2;
+}
+
+void clearRecoveryState(TargetState& st) {
+  st.recovery_step = 0;
+  st.recovery_attempts = 0;
+  st.recovery_cooldown = false;
+  st.recovery_exhausted = false;
+  st.cooldown_until = 0;
+  st.ladder_start = 0;
+}
+
+// Reparte la primera sonda de cada objetivo activo a lo largo de su intervalo
+void scheduleWatchdogTargets() {
+  unsigned long now = halMillis();
+  int active = 0;
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    if (config.targets[i].host[0] != '\0') active++;
+  }
+
+  int slot = 0;
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    const WatchdogTarget& t = config.targets[i];
+    TargetState& st = targetStates[i];
+    halProbeAbort(i);
+    st.consecutive_failures = 0;
+    st.consecutive_successes = 0;
+    st.interval_ms = t.check_interval_ms;
+    st.last_success = now;
+    st.last_check = now;
+    clearRecoveryState(st);
+    resetRttTracker(st.rtt);
+    if (t.host[0] == '\0') continue;
+
+    long offset = (long)t.check_interval_ms * slot / active + watchdogJitter(t.check_interval_ms);
+    st.next_check = now + (offset > 0 ? offset : 0);
+    // Con latidos el primer vencimiento es un intervalo completo sin recibir nada
+    if (config.probes[i].type == PROBE_HEARTBEAT) st.next_check = now + t.check_interval_ms;
+    slot++;
+  }
+}
+
+// Reinicia el estado de un objetivo (tras cambiar su configuracion)
+void resetWatchdogTarget(int index) {
+  const WatchdogTarget& t = config.targets[index];
+  TargetState& st = targetStates[index];
+  unsigned long now = halMillis();
+
+  halProbeAbort(index);
+  st.consecutive_failures = 0;
+  st.consecutive_successes = 0;
+  st.interval_ms = t.check_interval_ms;
+  st.last_success = now;
+  st.last_check = now;
+  clearRecoveryState(st);
+  resetRttTracker(st.rtt);
+  if (t.host[0] != '\0') {
+    long offset = watchdogJitter(t.check_interval_ms);
+    st.next_check = now + (offset > 0 ? offset : 0);
+    if (config.probes[index].type == PROBE_HEARTBEAT) st.next_check = now + t.check_interval_ms;
+  }
+}
+
+// Ajusta el intervalo efectivo segun el resultado de la ultima sonda
+void adaptProbeInterval(int index, bool ok) {
+  const WatchdogTarget& t = config.targets[index];
+  const ProbeSchedule& s = config.schedules[index];
+  TargetState& st = targetStates[index];
+  unsigned long base = t.check_interval_ms;
+  unsigned long interval = st.interval_ms;
+
+  if (!ok) {
+    interval = s.min_interval_ms;
+  } else if (config.probes[index].type == PROBE_HEARTBEAT) {
+    // El intervalo es la ventana de vencimiento del latido: no se relaja
+    interval = base;
+  } else if (interval < base) {
+    // Histeresis: un exito aislado no alcanza para volver a relajar
+    if (st.consecutive_successes >= WATCHDOG_RECOVER_STREAK) interval = base;
+  } else if (st.consecutive_successes % WATCHDOG_BACKOFF_STREAK == 0) {
+    interval = interval * 2 < s.max_interval_ms ? interval * 2 : s.max_interval_ms;
+  }
+
+  if (interval != st.interval_ms) {
+    halLog("Watchdog: intervalo de %s:%d %lu -> %lu ms\n", t.host, t.port, st.interval_ms, interval);
+    st.interval_ms = interval;
+  }
+}
+
+// Ejecuta la accion de un objetivo vencido. Devuelve false si el click fue
+// rechazado (pin ocupado por un comando manual o el boton fisico): el timeout
+// queda armado y se reintenta en la proxima sonda, como STEP_BUSY.
+bool onWatchdogTimeout(int index, unsigned long timeSinceSuccess) {
+  const WatchdogTarget& t = config.targets[index];
+
+  halLog("========================================\n");
+  halLog("WATCHDOG TIMEOUT!\n");
+  halLog("Host %s:%d sin responder por %lu ms\n", t.host, t.port, timeSinceSuccess);
+
+  bool executed = true;
+  switch (t.action) {
+    case ACTION_POWER:
+      halLog("Ejecutando POWER CLICK para reiniciar...\n");
+      executed = clickButton(POWER_PIN, config.power_click_ms);
+      break;
+    case ACTION_RESET:
+      halLog("Ejecutando RESET CLICK para reiniciar...\n");
+      executed = clickButton(RESET_PIN, config.reset_click_ms);
+      break;
+    default:
+      halLog("Solo alerta, sin accion sobre el equipo\n");
+      break;
+  }
+  if (!executed) halLog("Pin ocupado, accion pospuesta a la proxima sonda\n");
+  halLog("========================================\n");
+  if (!executed) return false;
+
+  actionCounters.watchdog_timeouts++;
+  publishQueuedEvent("watchdog_timeout", "\"target\":%d,\"host\":\"%s\",\"port\":%d,\"action\":\"%s\",\"down_ms\":%lu",
+                    index, t.host, t.port, watchdogActionName(t.action), timeSinceSuccess);
+  journalAppend(JOURNAL_WATCHDOG_TIMEOUT, index, t.action, timeSinceSuccess, t.host);
+  return true;
+}
+
+int readPowerState() {
+  switch (config.power_led_mode) {
+    case POWER_LED_ACTIVE_LOW: return halDigitalRead(POWER_LED_PIN) ? 0 : 1;
+    case POWER_LED_ACTIVE_HIGH: return halDigitalRead(POWER_LED_PIN) ? 1 : 0;
+    default: return -1;
+  }
+}
+
+const char* recoveryStateName(int index) {
+  const TargetState& st = targetStates[index];
+  if (config.targets[index].action != ACTION_ESCALATE) return "-";
+  if (st.recovery_exhausted) return "agotada";
+  if (st.recovery_cooldown) return "cooldown";
+  if (st.recovery_step > 0) return "en_curso";
+  return "inactiva";
+}
+
+enum StepOutcome { STEP_EXECUTED, STEP_SKIPPED, STEP_BUSY };
+
+// Ejecuta un paso de la escalera. Con el LED de power conectado, el apagado
+// forzado y el encendido se saltean si el equipo ya esta en ese estado.
+StepOutcome runRecoveryStep(uint8_t action, int power) {
+  uint8_t pin = POWER_PIN;
+  int duration = config.power_click_ms;
+  switch (action) {
+    case STEP_RESET:
+      pin = RESET_PIN;
+      duration = config.reset_click_ms;
+      break;
+    case STEP_FORCE_OFF:
+      if (power == 0) return STEP_SKIPPED;
+      duration = FORCE_OFF_MS;
+      break;
+    case STEP_POWER_ON:
+      if (power == 1) return STEP_SKIPPED;
+      break;
+  }
+  return clickButton(pin, duration) ? STEP_EXECUTED : STEP_BUSY;
+}
+
+// Avanza la escalera de un objetivo caido: como mucho un paso por sonda
+// fallida, cuando el tiempo desde el inicio de la escalera supera el after_ms
+// del paso. La primera escalera empieza con la ultima respuesta; las
+// siguientes, al terminar el cooldown. Eventos y diario informan siempre el
+// tiempo real sin respuesta.
+void runRecoveryLadder(int index, unsigned long timeSinceSuccess, unsigned long now) {
+  const WatchdogTarget& t = config.targets[index];
+  const RecoveryPolicy& p = config.recovery[index];
+  TargetState& st = targetStates[index];
+
+  if (st.recovery_exhausted) return;
+
+  if (st.recovery_cooldown) {
+    if ((long)(now - st.cooldown_until) < 0) return;
+    // Nueva escalera: los plazos vuelven a contar desde el fin del cooldown
+    halLog("Recuperacion: fin del cooldown de %s:%d, intento %d/%d\n",
+           t.host, t.port, st.recovery_attempts + 1, p.max_attempts);
+    st.recovery_cooldown = false;
+    st.recovery_step = 0;
+    st.ladder_start = now;
+    return;
+  }
+
+  if (st.recovery_step >= RECOVERY_MAX_STEPS) return;
+  const RecoveryStep& step = p.steps[st.recovery_step];
+  unsigned long ladderElapsed = st.recovery_attempts > 0 ? now - st.ladder_start : timeSinceSuccess;
+  if (step.action == STEP_NONE || ladderElapsed < step.after_ms) return;
+
+  int power = readPowerState();
+  StepOutcome outcome = runRecoveryStep(step.action, power);
+  if (outcome == STEP_BUSY) {
+    // Pin ocupado (comando manual o boton fisico): se reintenta en la proxima sonda
+    halLog("Recuperacion %s:%d: pin ocupado, paso %d pospuesto\n", t.host, t.port, st.recovery_step + 1);
+    return;
+  }
+  bool executed = outcome == STEP_EXECUTED;
+  if (st.recovery_step == 0) actionCounters.watchdog_timeouts++;
+  halLog("Recuperacion %s:%d paso %d (%s) tras %lu ms sin respuesta%s\n",
+         t.host, t.port, st.recovery_step + 1, recoveryStepName(step.action),
+         timeSinceSuccess, executed ? "" : " [salteado]");
+  publishQueuedEvent("recovery_step",
+                    "\"target\":%d,\"host\":\"%s\",\"step\":%d,\"action\":\"%s\",\"down_ms\":%lu,\"power\":%d,\"skipped\":%s",
+                    index, t.host, st.recovery_step + 1, recoveryStepName(step.action), timeSinceSuccess,
+                    power, executed ? "false" : "true");
+  // code: accion del paso, +100 si se salteo
+  journalAppend(JOURNAL_RECOVERY_STEP, index, step.action + (executed ? 0 : 100), timeSinceSuccess, t.host);
+
+  st.recovery_step++;
+  bool last = st.recovery_step >= RECOVERY_MAX_STEPS || p.steps[st.recovery_step].action == STEP_NONE;
+  if (!last) return;
+
+  st.recovery_attempts++;
+  if (st.recovery_attempts >= p.max_attempts) {
+    st.recovery_exhausted = true;
+    halLog("Recuperacion de %s:%d agotada tras %d intentos, sin mas acciones\n",
+           t.host, t.port, st.recovery_attempts);
+    publishQueuedEvent("recovery_exhausted", "\"target\":%d,\"host\":\"%s\",\"attempts\":%d",
+                      index, t.host, st.recovery_attempts);
+    journalAppend(JOURNAL_RECOVERY_EXHAUSTED, index, st.recovery_attempts, timeSinceSuccess, t.host);
+    return;
+  }
+  st.recovery_cooldown = true;
+  st.cooldown_until = now + p.cooldown_ms;
+  halLog("Recuperacion de %s:%d en cooldown por %lu ms\n", t.host, t.port, (unsigned long)p.cooldown_ms);
+}
+
+// Estado del objetivo para el panel en vivo (mismos campos que /api/status)
+void publishProbeUpdate(int index, unsigned long now) {
+  TargetState& st = targetStates[index];
+  st.live_update = now;
+  publishLiveUpdate("probe",
+                    "\"index\":%d,\"failures\":%d,\"last_check_s\":%lu,\"last_ok_s\":%lu,\"interval_ms\":%lu,"
+                    "\"rtt_ms\":%lu,\"response_ms\":%lu,\"response_avg_ms\":%lu,\"response_p95_ms\":%lu,"
+                    "\"degraded\":%s,\"recovery\":\"%s\",\"recovery_step\":%d,\"recovery_attempts\":%d",
+                    index, st.consecutive_failures, (now - st.last_check) / 1000, (now - st.last_success) / 1000,
+                    (unsigned long)st.interval_ms, halProbeRtt(index), halProbeResponseRtt(index),
+                    rttEwmaMs(st.rtt), rttPercentile(st.rtt, 95), st.rtt.degraded ? "true" : "false",
+                    recoveryStateName(index), st.recovery_step, st.recovery_attempts);
+}
+
+void handleProbeResult(int index, ProbeResult result, unsigned long now) {
+  const WatchdogTarget& t = config.targets[index];
+  TargetState& st = targetStates[index];
+
+  if (bootTimeline.first_probe == 0) bootTimeline.first_probe = halMillis();
+
+  if (result == PROBE_OK) {
+    actionCounters.probes_ok++;
+    unsigned long down_ms = now - st.last_success;
+    st.last_success = now;
+    unsigned long rtt = halProbeResponseRtt(index);
+    bool pushed = config.probes[index].type == PROBE_HEARTBEAT;
+    halLog("Watchdog: %s:%d respondiendo correctamente (%s, RTT %lu ms)\n",
+           t.host, t.port, probeTypeName(config.probes[index].type), pushed ? 0 : rtt);
+    if (!pushed && recordRtt(st.rtt, rtt, config.probes[index].degraded_pct)) {
+      // Latencia fuera (o de vuelta dentro) de lo normal para este objetivo
+      halLog("Watchdog: %s:%d %s (RTT promedio %lu ms, base %lu ms)\n", t.host, t.port,
+             st.rtt.degraded ? "degradado" : "vuelve a la normalidad",
+             rttEwmaMs(st.rtt), rttBaselineMs(st.rtt));
+      publishEvent(st.rtt.degraded ? "probe_degraded" : "probe_normal",
+                   "\"target\":%d,\"host\":\"%s\",\"port\":%d,\"rtt_avg_ms\":%lu,\"baseline_ms\":%lu,\"p95_ms\":%lu",
+                   index, t.host, t.port, rttEwmaMs(st.rtt), rttBaselineMs(st.rtt), rttPercentile(st.rtt, 95));
+      journalAppend(st.rtt.degraded ? JOURNAL_PROBE_DEGRADED : JOURNAL_PROBE_NORMAL, index,
+                    rttBaselineMs(st.rtt), rttEwmaMs(st.rtt), t.host);
+    }
+    // Solo se publica el cambio de estado, no cada sonda exitosa
+    if (st.consecutive_failures > 0) {
+      publishEvent("probe_recovered", "\"target\":%d,\"host\":\"%s\",\"port\":%d,\"rtt_ms\":%lu",
+                   index, t.host, t.port, halProbeRtt(index));
+    }
+    // En el diario solo la vuelta de una caida confirmada (target_down)
+    if (st.consecutive_failures >= WATCHDOG_CONFIRM_FAILURES) {
+      journalAppend(JOURNAL_TARGET_UP, index, st.consecutive_failures, down_ms, t.host);
+    }
+    st.consecutive_failures = 0;
+    if (st.recovery_step > 0 || st.recovery_attempts > 0) {
+      publishQueuedEvent("recovery_succeeded", "\"target\":%d,\"host\":\"%s\",\"steps\":%d,\"attempts\":%d",
+                        index, t.host, st.recovery_step, st.recovery_attempts);
+      journalAppend(JOURNAL_RECOVERY_SUCCEEDED, index, st.recovery_attempts, st.recovery_step, t.host);
+    }
+    clearRecoveryState(st);
+    st.consecutive_successes++;
+    adaptProbeInterval(index, true);
+    publishProbeUpdate(index, now);
+    return;
+  }
+
+  actionCounters.probes_failed++;
+  st.consecutive_failures++;
+  st.consecutive_successes = 0;
+  adaptProbeInterval(index, false);
+  // MISMATCH: el puerto acepta conexiones pero el servicio no contesta bien
+  const char* reason = result == PROBE_MISMATCH ? "response" : "connect";
+  const char* what = result == PROBE_MISMATCH ? "respuesta inesperada de" : "conectando a";
+  if (config.probes[index].type == PROBE_HEARTBEAT) {
+    reason = "heartbeat";
+    what = "sin latidos de";
+  }
+  halLog("Watchdog: Fallo #%d %s %s:%d\n", st.consecutive_failures, what, t.host, t.port);
+  publishEvent("probe_failed", "\"target\":%d,\"host\":\"%s\",\"port\":%d,\"failures\":%d,\"reason\":\"%s\"",
+               index, t.host, t.port, st.consecutive_failures, reason);
+  if (st.consecutive_failures == WATCHDOG_CONFIRM_FAILURES) {
+    // Caida confirmada por sondas rapidas; la accion sigue esperando el timeout
+    publishQueuedEvent("target_down", "\"target\":%d,\"host\":\"%s\",\"port\":%d,\"down_ms\":%lu",
+                      index, t.host, t.port, now - st.last_success);
+    journalAppend(JOURNAL_TARGET_DOWN, index, t.port, now - st.last_success, t.host);
+  }
+
+  // Calcular tiempo sin respuesta
+  unsigned long timeSinceSuccess = now - st.last_success;
+  if (t.action == ACTION_ESCALATE) {
+    runRecoveryLadder(index, timeSinceSuccess, now);
+  } else if (timeSinceSuccess >= (unsigned long)t.timeout_ms &&
+             onWatchdogTimeout(index, timeSinceSuccess)) {
+    // Resetear contadores (solo si la accion se ejecuto)
+    st.last_success = now;
+    st.consecutive_failures = 0;
+  }
+  publishProbeUpdate(index, now);
+}
+
+void onHeartbeat(int index) {
+  TargetState& st = targetStates[index];
+  unsigned long now = halMillis();
+  st.last_check = now;
+
+  if (st.consecutive_failures > 0) {
+    // Primer latido tras una caida: mismo camino que una sonda exitosa
+    handleProbeResult(index, PROBE_OK, now);
+  } else {
+    // Latido de rutina: sin log ni evento, solo corre el vencimiento
+    st.last_success = now;
+    if (now - st.live_update >= LIVE_HEARTBEAT_INTERVAL_MS) publishProbeUpdate(index, now);
+  }
+  st.next_check = now + st.interval_ms;
+}
+
+void checkTcpWatchdog() {
+  if (!config.watchdog_enabled) return;
+
+  unsigned long now = halMillis();
+  bool started = false;
+
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    const WatchdogTarget& t = config.targets[i];
+    TargetState& st = targetStates[i];
+    if (t.host[0] == '\0') continue;
+
+    if (config.probes[i].type == PROBE_HEARTBEAT) {
+      // Push: no se sondea, el objetivo vence si no llega un latido a tiempo
+      if (config.heartbeat_key[0] != '\0' && (long)(now - st.next_check) >= 0) {
+        st.last_check = now;
+        handleProbeResult(i, PROBE_FAILED, now);
+        st.next_check = now + st.interval_ms;
+      }
+      continue;
+    }
+
+    // Lanzar como mucho una sonda nueva por iteracion del loop
+    if (!started && halProbeIdle(i) && (long)(now - st.next_check) >= 0) {
+      st.last_check = now;
+      const ProbeSettings& ps = config.probes[i];
+      halLog("Probando %s en %s:%d...\n", probeTypeName(ps.type), t.host, t.port);
+      ProbeRequest request = { ps.type, t.host, (uint16_t)t.port, ps.match, ps.http_status, PROBE_TIMEOUT_MS };
+      halProbeStart(i, request);
+      started = true;
+    }
+
+    // Consumir el resultado de la sonda en curso (sin bloquear)
+    ProbeResult result = halProbePoll(i);
+    if (result != PROBE_PENDING) {
+      handleProbeResult(i, result, now);
+      // El proximo chequeo depende del resultado (intervalo adaptativo)
+      st.next_check = st.last_check + st.interval_ms + watchdogJitter(st.interval_ms);
+    }
+  }
+}
+
+void watchdogIdleBudget(unsigned long now, unsigned long& budget) {
+  if (!config.watchdog_enabled) return;
+  for (int i = 0; i < MAX_WATCHDOG_TARGETS; i++) {
+    if (config.targets[i].host[0] == '\0') continue;
+    if (config.probes[i].type == PROBE_HEARTBEAT) {
+      if (config.heartbeat_key[0] != '\0') limitIdle(budget, now, targetStates[i].next_check);
+    } else if (halProbeIdle(i)) {
+      limitIdle(budget, now, targetStates[i].next_check);
+    } else {
+      limitIdle(budget, now, targetStates[i].last_check + PROBE_TIMEOUT_MS);
+    }
+  }
+}
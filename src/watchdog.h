@@ -0,0 +1,59 @@
+#pragma once
+
+// Planificador de sondas del watchdog: reparte las sondas de cada objetivo,
+// consume sus resultados y ejecuta la accion configurada al vencer el timeout.
+// Los objetivos con ACTION_ESCALATE recorren su escalera de recuperacion
+// (reset, apagado forzado, encendido...) con cooldown y limite de intentos.
+//
+// El intervalo de cada objetivo es adaptativo: ante el primer fallo pasa al
+// minimo para confirmar la caida en segundos, y con el objetivo sano se
+// relaja (x2 cada WATCHDOG_BACKOFF_STREAK exitos) hasta el maximo. Vuelve al
+// intervalo base recien tras WATCHDOG_RECOVER_STREAK exitos seguidos.
+
+#include "config.h"
+#include "probes.h"
+
+#define PROBE_TIMEOUT_MS 5000          // Plazo maximo por sonda (DNS + connect)
+#define WATCHDOG_JITTER_PCT 10         // Jitter total (+-5%) sobre el intervalo
+#define WATCHDOG_CONFIRM_FAILURES 3    // Fallos seguidos para dar el objetivo por caido
+#define WATCHDOG_RECOVER_STREAK 3      // Exitos seguidos para volver al intervalo base
+#define WATCHDOG_BACKOFF_STREAK 5      // Exitos seguidos para duplicar el intervalo
+#define LIVE_HEARTBEAT_INTERVAL_MS 10000  // Latidos de rutina enviados al panel en vivo
+
+// Estado en tiempo de ejecucion de cada objetivo del watchdog. La sonda en
+// curso vive en la HAL, en el slot con el mismo indice que el objetivo.
+struct TargetState {
+  unsigned long next_check;
+  unsigned long last_check;
+  unsigned long last_success;
+  int consecutive_failures;
+  int consecutive_successes;
+  unsigned long interval_ms;     // Intervalo efectivo actual
+  // Escalera de recuperacion (solo ACTION_ESCALATE)
+  uint8_t recovery_step;         // Proximo paso a ejecutar
+  uint8_t recovery_attempts;     // Escaleras completas sin recuperar el objetivo
+  bool recovery_cooldown;
+  bool recovery_exhausted;       // Se alcanzo max_attempts: no se actua mas
+  unsigned long cooldown_until;
+  unsigned long ladder_start;    // Fin del ultimo cooldown (los after_ms cuentan desde ahi)
+  RttTracker rtt;                // RTT de respuesta y estado degradado
+  // Sonda heartbeat: ultimo latido aceptado
+  uint64_t heartbeat_seq;
+  uint32_t heartbeat_ts;         // Reloj del emisor
+  unsigned long live_update;     // Ultimo estado enviado al panel en vivo
+};
+
+extern TargetState targetStates[MAX_WATCHDOG_TARGETS];
+
+void scheduleWatchdogTargets();
+void resetWatchdogTarget(int index);
+void checkTcpWatchdog();
+// Acota la espera de powersave.h a la proxima sonda, al vencimiento de un
+// latido o al plazo de una sonda en curso (si termina antes, la HAL corta la
+// espera).
+void watchdogIdleBudget(unsigned long now, unsigned long& budget);
+// Latido valido de un objetivo con sonda heartbeat
+void onHeartbeat(int index);
+// Estado segun el LED de power: 1 encendido, 0 apagado, -1 sin sensor
+int readPowerState();
+const char* recoveryStateName(int index);